@@ -0,0 +1,156 @@
+/*******************************************************************************
+* Authors:
+*    Uros Popovic & Uros Cvjetinovic
+* @file
+* \brief Control laws of the regulator, see controllaw.h. Only set-up lives
+*   here, the decisions are inline in the header.
+*******************************************************************************/
+
+/******* include headers ******************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include "controllaw.h"
+#include "timebase.h"
+
+/******* local macros *********************************************************/
+#define PID_KP                  5.0f
+#define PID_KI                  0.5f
+#define PID_KD                  0.0f
+#define PID_PERIOD              1.0f
+#define BANGBANG_DWELL          5.0f
+#define DELIMITERS              " ,;\t"
+
+/******* local data objects ***************************************************/
+static const char *const lawNames[CONTROLLAW_COUNT] =
+{
+  "hysteresis", "pid", "bangbang"
+};
+
+/******* definition of global functions ***************************************/
+void controlLawDefaults(ControlLawParameters *parameters, uint32_t law)
+{
+  parameters->law = law;
+  parameters->band = HYSTERESIS_BAND;
+  parameters->kp = PID_KP;
+  parameters->ki = PID_KI;
+  parameters->kd = PID_KD;
+  parameters->periodS = PID_PERIOD;
+  parameters->outputMin = HYSTERESIS_OFF;
+  parameters->outputMax = HYSTERESIS_ON;
+  parameters->dwellS = BANGBANG_DWELL;
+}
+
+/* Parses "<law> key=value ...", e.g. "pid kp=4 ki=0.2 ts=1" or
+   "bangbang dwell=10"; keys not given keep their defaults */
+int controlLawParse(const char *text, ControlLawParameters *parameters)
+{
+  size_t length = strcspn(text, DELIMITERS);
+  const char *key;
+  char *end;
+  size_t keyLength;
+  uint32_t law;
+  float value;
+
+  for (law = 0u; law < CONTROLLAW_COUNT; law++)
+  {
+    if ((strlen(lawNames[law]) == length) &&
+        (strncmp(text, lawNames[law], length) == 0))
+    {
+      break;
+    }
+  }
+  if (law == CONTROLLAW_COUNT)
+  {
+    return -1;
+  }
+  controlLawDefaults(parameters, law);
+
+  key = text + length;
+  while (*(key += strspn(key, DELIMITERS)) != '\0')
+  {
+    keyLength = strcspn(key, "=");
+    if (key[keyLength] != '=')
+    {
+      return -1;
+    }
+    value = strtof(&key[keyLength + 1u], &end);
+    if ((end == &key[keyLength + 1u]) ||
+        ((*end != '\0') && (strchr(DELIMITERS, *end) == NULL)))
+    {
+      return -1;
+    }
+
+    if ((keyLength == 4u) && (strncmp(key, "band", 4u) == 0))
+    {
+      parameters->band = value;
+    }
+    else if ((keyLength == 2u) && (strncmp(key, "kp", 2u) == 0))
+    {
+      parameters->kp = value;
+    }
+    else if ((keyLength == 2u) && (strncmp(key, "ki", 2u) == 0))
+    {
+      parameters->ki = value;
+    }
+    else if ((keyLength == 2u) && (strncmp(key, "kd", 2u) == 0))
+    {
+      parameters->kd = value;
+    }
+    else if ((keyLength == 2u) && (strncmp(key, "ts", 2u) == 0))
+    {
+      parameters->periodS = value;
+    }
+    else if ((keyLength == 3u) && (strncmp(key, "min", 3u) == 0))
+    {
+      parameters->outputMin = value;
+    }
+    else if ((keyLength == 3u) && (strncmp(key, "max", 3u) == 0))
+    {
+      parameters->outputMax = value;
+    }
+    else if ((keyLength == 5u) && (strncmp(key, "dwell", 5u) == 0))
+    {
+      parameters->dwellS = value;
+    }
+    else
+    {
+      return -1;
+    }
+    key = end;
+  }
+
+  if ((parameters->periodS <= 0.0f) || (parameters->dwellS < 0.0f) ||
+      (parameters->outputMin > parameters->outputMax))
+  {
+    return -1;
+  }
+
+  return 0;
+}
+
+const char *controlLawName(uint32_t law)
+{
+  return (law < CONTROLLAW_COUNT) ? lawNames[law] : "unknown";
+}
+
+/* Takes over the parameters and restarts the law, the set pressure is kept */
+void controlLoopConfigure(ControlLoop *loop,
+                          const ControlLawParameters *parameters)
+{
+  float setpoint = loop->setpoint;
+
+  memset(loop, 0, sizeof(*loop));
+  loop->setpoint = setpoint;
+  loop->law = parameters->law;
+  loop->band = parameters->band;
+  loop->kp = parameters->kp;
+  loop->kiPeriod = parameters->ki * parameters->periodS;
+  loop->kdPerPeriod = parameters->kd / parameters->periodS;
+  loop->outputMin = parameters->outputMin;
+  loop->outputMax = parameters->outputMax;
+  loop->dwellNs = (uint64_t)((double)parameters->dwellS *
+                             (double)TIMEBASE_NS_PER_S);
+  loop->switchedNs = CONTROLLAW_NOSWITCH;
+  loop->output = (parameters->law == CONTROLLAW_HYSTERESIS) ?
+                 HYSTERESIS_OFF : parameters->outputMin;
+}
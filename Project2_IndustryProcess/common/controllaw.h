@@ -0,0 +1,151 @@
+/*******************************************************************************
+* Authors:
+*    Uros Popovic & Uros Cvjetinovic
+* @file
+* \brief Control laws of the regulator, selectable per loop at run time:
+*   - hysteresis: the two-position law of hysteresis.h, output 0 or 100
+*   - pid: positional PID on the sampling period with the derivative taken on
+*     the pressure, so a set pressure step gives no kick, and conditional
+*     integration as anti-windup: while the output is saturated the integral
+*     only moves back towards the range
+*   - bangbang: fully on below and fully off above the set pressure, but an
+*     output is held for at least the minimum dwell time
+*   Each law is an inline function and controlLoopUpdate switches on the law
+*   of the loop, so the compiler inlines every law into the decision path
+*   and a decision costs a few nanoseconds without any indirect call.
+*   All state of a loop fits into one cache line; an array of loops
+*   allocated on a 64 byte boundary keeps every loop in a line of its own.
+*******************************************************************************/
+#ifndef CONTROLLAW_H
+#define CONTROLLAW_H
+
+/******* include headers ******************************************************/
+#include <stdint.h>
+#include "hysteresis.h"
+
+/******* global macros ********************************************************/
+#define CONTROLLAW_HYSTERESIS   ((uint32_t) 0u)
+#define CONTROLLAW_PID          ((uint32_t) 1u)
+#define CONTROLLAW_BANGBANG     ((uint32_t) 2u)
+#define CONTROLLAW_COUNT        ((uint32_t) 3u)
+/* switchedNs of a loop that never switched, 0 is a valid virtual time */
+#define CONTROLLAW_NOSWITCH     UINT64_MAX
+
+/******* type definitions *****************************************************/
+typedef struct
+{
+  uint32_t law;
+  float band;                   /* hysteresis */
+  float kp;                     /* pid */
+  float ki;                     /* pid, per s */
+  float kd;                     /* pid, in s */
+  float periodS;                /* pid, sampling period of the process */
+  float outputMin;              /* pid and bangbang */
+  float outputMax;
+  float dwellS;                 /* bangbang */
+} ControlLawParameters;
+
+typedef struct
+{
+  float setpoint;
+  float output;
+  uint32_t law;
+  float band;
+  float kp;
+  float kiPeriod;               /* ki * period */
+  float kdPerPeriod;            /* kd / period */
+  float outputMin;
+  float outputMax;
+  float integral;
+  float previousPressure;
+  uint32_t started;             /* previousPressure holds a sample */
+  uint64_t dwellNs;
+  uint64_t switchedNs;          /* last switch, CONTROLLAW_NOSWITCH none */
+} ControlLoop;
+
+_Static_assert(sizeof(ControlLoop) == 64u, "a loop is one cache line");
+
+/******* definition of inline functions ***************************************/
+static inline int controlHysteresis(ControlLoop *loop, float pressure)
+{
+  return hysteresisDecide(loop->setpoint, loop->band, pressure,
+                          &loop->output);
+}
+
+static inline int controlPid(ControlLoop *loop, float pressure)
+{
+  float error = loop->setpoint - pressure;
+  float integral = loop->integral + (loop->kiPeriod * error);
+  float derivative = loop->started ?
+                     ((loop->previousPressure - pressure) * loop->kdPerPeriod) :
+                     0.0f;
+  float output = (loop->kp * error) + integral + derivative;
+
+  if (output > loop->outputMax)
+  {
+    output = loop->outputMax;
+    integral = (error > 0.0f) ? loop->integral : integral;
+  }
+  else if (output < loop->outputMin)
+  {
+    output = loop->outputMin;
+    integral = (error < 0.0f) ? loop->integral : integral;
+  }
+
+  loop->integral = integral;
+  loop->previousPressure = pressure;
+  loop->started = 1u;
+  loop->output = output;
+
+  return 1;
+}
+
+static inline int controlBangBang(ControlLoop *loop, float pressure,
+                                  uint64_t nowNs)
+{
+  float output = (pressure < loop->setpoint) ? loop->outputMax :
+                                               loop->outputMin;
+
+  if (output == loop->output)
+  {
+    return 1;
+  }
+  if ((loop->switchedNs != CONTROLLAW_NOSWITCH) &&
+      ((nowNs - loop->switchedNs) < loop->dwellNs))
+  {
+    return 0;
+  }
+  loop->output = output;
+  loop->switchedNs = nowNs;
+
+  return 1;
+}
+
+/* Returns 1 when the law commanded an output for this pressure, 0 when it
+   kept the previous one (inside the hysteresis band, within the dwell
+   time) */
+static inline int controlLoopUpdate(ControlLoop *loop, float pressure,
+                                    uint64_t nowNs)
+{
+  switch (loop->law)
+  {
+    case CONTROLLAW_PID:
+      return controlPid(loop, pressure);
+    case CONTROLLAW_BANGBANG:
+      return controlBangBang(loop, pressure, nowNs);
+    default:
+      return controlHysteresis(loop, pressure);
+  }
+}
+
+/******* declaration of global functions **************************************/
+void controlLawDefaults(ControlLawParameters *parameters, uint32_t law);
+
+int controlLawParse(const char *text, ControlLawParameters *parameters);
+
+const char *controlLawName(uint32_t law);
+
+void controlLoopConfigure(ControlLoop *loop,
+                          const ControlLawParameters *parameters);
+
+#endif /* CONTROLLAW_H */
@@ -0,0 +1,258 @@
+/*******************************************************************************
+* Authors:
+*    Uros Cvjetinovic & Uros Popovic
+* @file
+* \brief Blocking event loop, see eventloop.h. On Linux the waiting thread
+*   sleeps in poll on an eventfd, whose write is async-signal-safe, and on a
+*   timerfd armed at the next timer deadline in absolute time. Other
+*   platforms wait on a semaphore with a timeout on the wall clock.
+*******************************************************************************/
+
+/******* include headers ******************************************************/
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "eventloop.h"
+#include "timebase.h"
+
+#if defined(__linux__)
+#include <poll.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#endif
+
+/******* declaration of local functions ***************************************/
+static uint64_t runTimers(EventLoop *loop, uint64_t now);
+
+static void blockUntil(EventLoop *loop, uint64_t deadlineNs);
+
+/******* definition of local functions ****************************************/
+/* Runs every due timer and returns the deadline of the next one */
+static uint64_t runTimers(EventLoop *loop, uint64_t now)
+{
+  EventLoopTimer *timer;
+  uint64_t nextNs = UINT64_MAX;
+  uint32_t index;
+
+  for (index = 0u; index < loop->timerCount; index++)
+  {
+    timer = &loop->timers[index];
+    if (now >= timer->nextNs)
+    {
+      histogramRecord(&loop->timerLatency, now - timer->nextNs);
+      timer->callback(timer->context, now);
+      /* Periods that passed while the loop was busy are skipped, the
+         deadlines stay on the original grid */
+      timer->nextNs += timer->periodNs *
+                       (1u + ((now - timer->nextNs) / timer->periodNs));
+    }
+    if (timer->nextNs < nextNs)
+    {
+      nextNs = timer->nextNs;
+    }
+  }
+
+  return nextNs;
+}
+
+#if defined(__linux__)
+static void blockUntil(EventLoop *loop, uint64_t deadlineNs)
+{
+  struct pollfd pollFds[2];
+  struct itimerspec timerSpec;
+  uint64_t count;
+  uint32_t index;
+
+  /* The poll timeout only has millisecond resolution, the timerfd wakes the
+     loop within microseconds of the deadline */
+  memset(&timerSpec, 0, sizeof(timerSpec));
+  if ((deadlineNs != UINT64_MAX) && (deadlineNs != loop->armedNs))
+  {
+    timerSpec.it_value.tv_sec = (time_t)(deadlineNs / TIMEBASE_NS_PER_S);
+    timerSpec.it_value.tv_nsec = (long)(deadlineNs % TIMEBASE_NS_PER_S);
+    timerfd_settime(loop->timerFd, TFD_TIMER_ABSTIME, &timerSpec, NULL);
+    loop->armedNs = deadlineNs;
+  }
+
+  pollFds[0].fd = loop->eventFd;
+  pollFds[1].fd = loop->timerFd;
+  for (index = 0u; index < 2u; index++)
+  {
+    pollFds[index].events = POLLIN;
+    pollFds[index].revents = 0;
+  }
+
+  if (poll(pollFds, 2, -1) > 0)
+  {
+    /* Drain the counters, the raised bits themselves live in pending */
+    for (index = 0u; index < 2u; index++)
+    {
+      if (((pollFds[index].revents & POLLIN) != 0) &&
+          (read(pollFds[index].fd, &count, sizeof(count)) < 0))
+      {
+      }
+    }
+  }
+}
+#else
+static void blockUntil(EventLoop *loop, uint64_t deadlineNs)
+{
+  struct timespec deadline;
+  uint64_t now = timebaseNowNs();
+  uint64_t wallNs;
+
+  if (deadlineNs == UINT64_MAX)
+  {
+    while ((sem_wait(&loop->wakeUp) != 0) && (errno == EINTR))
+    {
+    }
+    return;
+  }
+
+  /* sem_timedwait takes a wall clock deadline */
+  clock_gettime(CLOCK_REALTIME, &deadline);
+  wallNs = ((uint64_t)deadline.tv_sec * TIMEBASE_NS_PER_S) +
+           (uint64_t)deadline.tv_nsec;
+  if (deadlineNs > now)
+  {
+    wallNs += deadlineNs - now;
+  }
+  deadline.tv_sec = (time_t)(wallNs / TIMEBASE_NS_PER_S);
+  deadline.tv_nsec = (long)(wallNs % TIMEBASE_NS_PER_S);
+
+  while ((sem_timedwait(&loop->wakeUp, &deadline) != 0) && (errno == EINTR))
+  {
+  }
+}
+#endif
+
+/******* definition of global functions ***************************************/
+int eventLoopInit(EventLoop *loop)
+{
+  memset(loop, 0, sizeof(*loop));
+  atomic_init(&loop->pending, 0u);
+  atomic_init(&loop->signalNs, 0u);
+  histogramReset(&loop->signalLatency);
+  histogramReset(&loop->timerLatency);
+
+#if defined(__linux__)
+  loop->eventFd = eventfd(0u, EFD_CLOEXEC | EFD_NONBLOCK);
+  loop->timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+  if ((loop->eventFd < 0) || (loop->timerFd < 0))
+  {
+    eventLoopClose(loop);
+    return -1;
+  }
+#else
+  if (sem_init(&loop->wakeUp, 0, 0) != 0)
+  {
+    return -1;
+  }
+#endif
+
+  return 0;
+}
+
+int eventLoopAddTimer(EventLoop *loop, uint64_t periodNs,
+                      EventLoopTimerCallback callback, void *context)
+{
+  EventLoopTimer *timer;
+
+  if ((periodNs == 0u) || (callback == NULL) ||
+      (loop->timerCount >= EVENTLOOP_MAXTIMERS))
+  {
+    return -1;
+  }
+
+  timer = &loop->timers[loop->timerCount++];
+  timer->periodNs = periodNs;
+  timer->nextNs = timebaseNowNs() + periodNs;
+  timer->callback = callback;
+  timer->context = context;
+
+  return 0;
+}
+
+void eventLoopSignal(EventLoop *loop, uint32_t events)
+{
+  unsigned long long expected = 0u;
+#if defined(__linux__)
+  uint64_t one = 1u;
+#endif
+
+  /* Only the first of several signals before a wake-up is timed */
+  atomic_compare_exchange_strong(&loop->signalNs, &expected,
+                                 (unsigned long long)timebaseNowNs());
+  atomic_fetch_or(&loop->pending, events);
+
+#if defined(__linux__)
+  if (write(loop->eventFd, &one, sizeof(one)) < 0)
+  {
+  }
+#else
+  sem_post(&loop->wakeUp);
+#endif
+}
+
+uint32_t eventLoopWait(EventLoop *loop)
+{
+  uint64_t now;
+  uint64_t nextNs;
+  uint64_t signalNs;
+  uint32_t events;
+
+  while (1)
+  {
+    now = timebaseNowNs();
+    nextNs = runTimers(loop, now);
+
+    /* A signal raised after this exchange also makes the eventfd readable
+       or the semaphore positive, so the wait below returns at once */
+    events = atomic_exchange(&loop->pending, 0u);
+    if (events != 0u)
+    {
+      signalNs = atomic_exchange(&loop->signalNs, 0u);
+      if ((signalNs != 0u) && (now >= signalNs))
+      {
+        histogramRecord(&loop->signalLatency, now - signalNs);
+      }
+      return events;
+    }
+
+    blockUntil(loop, nextNs);
+    loop->wakeUps++;
+  }
+}
+
+int eventLoopFormatStats(const EventLoop *loop, char *buffer, size_t size)
+{
+  char signalLine[160];
+  char timerLine[160];
+
+  histogramFormat(&loop->signalLatency, "signal", signalLine,
+                  sizeof(signalLine));
+  histogramFormat(&loop->timerLatency, "timer", timerLine, sizeof(timerLine));
+
+  return snprintf(buffer, size, "eventloop: wakeups=%llu %s %s",
+                  (unsigned long long)loop->wakeUps, signalLine, timerLine);
+}
+
+void eventLoopClose(EventLoop *loop)
+{
+#if defined(__linux__)
+  if (loop->eventFd >= 0)
+  {
+    close(loop->eventFd);
+    loop->eventFd = -1;
+  }
+  if (loop->timerFd >= 0)
+  {
+    close(loop->timerFd);
+    loop->timerFd = -1;
+  }
+#else
+  sem_destroy(&loop->wakeUp);
+#endif
+}
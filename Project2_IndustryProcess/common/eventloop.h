@@ -0,0 +1,75 @@
+/*******************************************************************************
+* Authors:
+*    Uros Cvjetinovic & Uros Popovic
+* @file
+* \brief Blocking event loop for a main thread that only reacts to rare
+*   events (connection lost, stop request) and runs periodic housekeeping.
+*   Other threads, and signal handlers, raise event bits with
+*   eventLoopSignal; the waiting thread sleeps in the kernel until an event
+*   is raised or the next timer is due, so an idle loop costs no CPU.
+*   The time from a signal to the return of eventLoopWait and the lateness of
+*   every timer are recorded in histograms.
+*******************************************************************************/
+#ifndef EVENTLOOP_H
+#define EVENTLOOP_H
+
+/******* include headers ******************************************************/
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "histogram.h"
+
+#if !defined(__linux__)
+#include <semaphore.h>
+#endif
+
+/******* global macros ********************************************************/
+#define EVENTLOOP_MAXTIMERS     ((uint32_t) 8u)
+
+/******* type definitions *****************************************************/
+typedef void (*EventLoopTimerCallback)(void *context, uint64_t nowNs);
+
+typedef struct
+{
+  uint64_t periodNs;
+  uint64_t nextNs;
+  EventLoopTimerCallback callback;
+  void *context;
+} EventLoopTimer;
+
+typedef struct
+{
+  atomic_uint pending;          /* event bits raised and not yet returned */
+  atomic_ullong signalNs;       /* time of the oldest unreturned signal */
+#if defined(__linux__)
+  int eventFd;
+  int timerFd;
+  uint64_t armedNs;             /* deadline the timerFd is armed at */
+#else
+  sem_t wakeUp;
+#endif
+  EventLoopTimer timers[EVENTLOOP_MAXTIMERS];
+  uint32_t timerCount;
+  uint64_t wakeUps;             /* returns from the blocking wait */
+  Histogram signalLatency;
+  Histogram timerLatency;
+} EventLoop;
+
+/******* declaration of global functions **************************************/
+int eventLoopInit(EventLoop *loop);
+
+int eventLoopAddTimer(EventLoop *loop, uint64_t periodNs,
+                      EventLoopTimerCallback callback, void *context);
+
+/* Safe to call from any thread and from a signal handler */
+void eventLoopSignal(EventLoop *loop, uint32_t events);
+
+/* Runs due timers and blocks until at least one event bit is raised, then
+   returns and clears all raised bits */
+uint32_t eventLoopWait(EventLoop *loop);
+
+int eventLoopFormatStats(const EventLoop *loop, char *buffer, size_t size);
+
+void eventLoopClose(EventLoop *loop);
+
+#endif /* EVENTLOOP_H */
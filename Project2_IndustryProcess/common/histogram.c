@@ -0,0 +1,153 @@
+/*******************************************************************************
+* Authors:
+*    Uros Cvjetinovic & Uros Popovic
+* @file
+* \brief Fixed-size latency histogram with power-of-two microsecond buckets.
+*******************************************************************************/
+
+/******* include headers ******************************************************/
+#include <stdio.h>
+#include <string.h>
+#include "histogram.h"
+#include "timebase.h"
+
+/******* declaration of local functions ***************************************/
+static uint32_t bucketIndex(uint64_t valueNs);
+
+static uint64_t bucketUpperBoundNs(uint32_t index);
+
+/******* definition of local functions ****************************************/
+static uint32_t bucketIndex(uint64_t valueNs)
+{
+  uint64_t valueUs = valueNs / TIMEBASE_NS_PER_US;
+  uint32_t index = 0u;
+
+  while ((valueUs != 0u) && (index < (HISTOGRAM_BUCKETS - 1u)))
+  {
+    valueUs >>= 1u;
+    index++;
+  }
+
+  return index;
+}
+
+static uint64_t bucketUpperBoundNs(uint32_t index)
+{
+  return ((uint64_t)1u << index) * TIMEBASE_NS_PER_US;
+}
+
+/******* definition of global functions ***************************************/
+void histogramReset(Histogram *histogram)
+{
+  memset(histogram, 0, sizeof(*histogram));
+  histogram->minNs = UINT64_MAX;
+}
+
+void histogramRecord(Histogram *histogram, uint64_t valueNs)
+{
+  histogram->buckets[bucketIndex(valueNs)]++;
+  histogram->count++;
+  histogram->sumNs += valueNs;
+  if (valueNs < histogram->minNs)
+  {
+    histogram->minNs = valueNs;
+  }
+  if (valueNs > histogram->maxNs)
+  {
+    histogram->maxNs = valueNs;
+  }
+}
+
+void histogramMerge(Histogram *target, const Histogram *source)
+{
+  uint32_t index;
+
+  for (index = 0u; index < HISTOGRAM_BUCKETS; index++)
+  {
+    target->buckets[index] += source->buckets[index];
+  }
+  target->count += source->count;
+  target->sumNs += source->sumNs;
+  if (source->minNs < target->minNs)
+  {
+    target->minNs = source->minNs;
+  }
+  if (source->maxNs > target->maxNs)
+  {
+    target->maxNs = source->maxNs;
+  }
+}
+
+uint64_t histogramPercentileNs(const Histogram *histogram, double percentile)
+{
+  uint64_t rank;
+  uint64_t seen = 0u;
+  uint32_t index;
+
+  if (histogram->count == 0u)
+  {
+    return 0u;
+  }
+
+  rank = (uint64_t)((percentile / 100.0) * (double)histogram->count);
+  if (rank >= histogram->count)
+  {
+    rank = histogram->count - 1u;
+  }
+
+  /* Report the upper bound of the bucket holding the rank, clamped to the
+     observed maximum so a single sample does not look twice as slow */
+  for (index = 0u; index < HISTOGRAM_BUCKETS; index++)
+  {
+    seen += histogram->buckets[index];
+    if (seen > rank)
+    {
+      uint64_t upperBound = bucketUpperBoundNs(index);
+      return (upperBound < histogram->maxNs) ? upperBound : histogram->maxNs;
+    }
+  }
+
+  return histogram->maxNs;
+}
+
+int histogramFormat(const Histogram *histogram, const char *name,
+                    char *buffer, size_t size)
+{
+  if (histogram->count == 0u)
+  {
+    return snprintf(buffer, size, "%s: n=0", name);
+  }
+
+  return snprintf(buffer, size,
+                  "%s: n=%llu min=%.1fus mean=%.1fus p50=%.1fus p99=%.1fus "
+                  "max=%.1fus",
+                  name, (unsigned long long)histogram->count,
+                  (double)histogram->minNs / TIMEBASE_NS_PER_US,
+                  ((double)histogram->sumNs / histogram->count) /
+                  TIMEBASE_NS_PER_US,
+                  (double)histogramPercentileNs(histogram, 50.0) /
+                  TIMEBASE_NS_PER_US,
+                  (double)histogramPercentileNs(histogram, 99.0) /
+                  TIMEBASE_NS_PER_US,
+                  (double)histogram->maxNs / TIMEBASE_NS_PER_US);
+}
+
+void histogramPrint(const Histogram *histogram, const char *name)
+{
+  char summary[256];
+  uint32_t index;
+
+  histogramFormat(histogram, name, summary, sizeof(summary));
+  printf("%s\n", summary);
+
+  for (index = 0u; index < HISTOGRAM_BUCKETS; index++)
+  {
+    if (histogram->buckets[index] != 0u)
+    {
+      printf("  < %10llu us: %llu\n",
+             (unsigned long long)(bucketUpperBoundNs(index) /
+                                  TIMEBASE_NS_PER_US),
+             (unsigned long long)histogram->buckets[index]);
+    }
+  }
+}
@@ -0,0 +1,44 @@
+/*******************************************************************************
+* Authors:
+*    Uros Cvjetinovic & Uros Popovic
+* @file
+* \brief Fixed-size latency histogram with power-of-two microsecond buckets.
+*   Bucket 0 holds values below 1 us, bucket i holds [2^(i-1), 2^i) us.
+*   Recording is O(1) and never allocates, so it can be used on the tick and
+*   message paths.
+*******************************************************************************/
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+/******* include headers ******************************************************/
+#include <stddef.h>
+#include <stdint.h>
+
+/******* global macros ********************************************************/
+#define HISTOGRAM_BUCKETS       ((uint32_t) 32u)
+
+/******* type definitions *****************************************************/
+typedef struct
+{
+  uint64_t count;
+  uint64_t sumNs;
+  uint64_t minNs;
+  uint64_t maxNs;
+  uint64_t buckets[HISTOGRAM_BUCKETS];
+} Histogram;
+
+/******* declaration of global functions **************************************/
+void histogramReset(Histogram *histogram);
+
+void histogramRecord(Histogram *histogram, uint64_t valueNs);
+
+void histogramMerge(Histogram *target, const Histogram *source);
+
+uint64_t histogramPercentileNs(const Histogram *histogram, double percentile);
+
+int histogramFormat(const Histogram *histogram, const char *name,
+                    char *buffer, size_t size);
+
+void histogramPrint(const Histogram *histogram, const char *name);
+
+#endif /* HISTOGRAM_H */
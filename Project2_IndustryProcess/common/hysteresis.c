@@ -0,0 +1,25 @@
+/*******************************************************************************
+* Authors:
+*    Uros Popovic & Uros Cvjetinovic
+* @file
+* \brief Hysteresis control law of the regulator, see hysteresis.h.
+*******************************************************************************/
+
+/******* include headers ******************************************************/
+#include "hysteresis.h"
+
+/******* definition of global functions ***************************************/
+void hysteresisInit(Hysteresis *hysteresis, float setpoint, float band)
+{
+  hysteresis->setpoint = setpoint;
+  hysteresis->band = band;
+  hysteresis->output = HYSTERESIS_OFF;
+}
+
+/* Returns 1 when the pressure is outside the band and the correction was
+   set, 0 when it is inside and the correction was kept */
+int hysteresisUpdate(Hysteresis *hysteresis, float pressure)
+{
+  return hysteresisDecide(hysteresis->setpoint, hysteresis->band, pressure,
+                          &hysteresis->output);
+}
@@ -0,0 +1,54 @@
+/*******************************************************************************
+* Authors:
+*    Uros Popovic & Uros Cvjetinovic
+* @file
+* \brief Hysteresis (two-position) control law of the regulator. Below the
+*   band around the set pressure the correction is switched fully on, above it
+*   fully off, inside the band the previous correction is kept. Shared by the
+*   regulator and by the offline replay of the process, so both take exactly
+*   the same decisions.
+*******************************************************************************/
+#ifndef HYSTERESIS_H
+#define HYSTERESIS_H
+
+/******* include headers ******************************************************/
+#include <stdint.h>
+
+/******* global macros ********************************************************/
+#define HYSTERESIS_ON           100.0f
+#define HYSTERESIS_OFF          0.0f
+#define HYSTERESIS_BAND         1.0f
+
+/******* type definitions *****************************************************/
+typedef struct
+{
+  float setpoint;
+  float band;
+  float output;
+} Hysteresis;
+
+/******* definition of inline functions ***************************************/
+/* The switching rule, also used by the hysteresis law of controllaw.h */
+static inline int hysteresisDecide(float setpoint, float band, float pressure,
+                                   float *output)
+{
+  if ((setpoint > pressure) && ((setpoint - pressure) > band))
+  {
+    *output = HYSTERESIS_ON;
+    return 1;
+  }
+  if ((setpoint < pressure) && ((pressure - setpoint) > band))
+  {
+    *output = HYSTERESIS_OFF;
+    return 1;
+  }
+
+  return 0;
+}
+
+/******* declaration of global functions **************************************/
+void hysteresisInit(Hysteresis *hysteresis, float setpoint, float band);
+
+int hysteresisUpdate(Hysteresis *hysteresis, float pressure);
+
+#endif /* HYSTERESIS_H */
@@ -0,0 +1,275 @@
+/*******************************************************************************
+* Authors:
+*    Uros Cvjetinovic & Uros Popovic
+* @file
+* \brief File mapped into memory, see mappedfile.h.
+*******************************************************************************/
+
+/******* include headers ******************************************************/
+#include <string.h>
+#include "mappedfile.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/******* definition of global functions ***************************************/
+#if defined(_WIN32)
+int mappedFileOpen(MappedFile *file, const char *path, size_t size)
+{
+  LARGE_INTEGER fileSize;
+  HANDLE fileHandle;
+  HANDLE mappingHandle;
+
+  memset(file, 0, sizeof(*file));
+
+  /* Readers of a file held open by this writer have to share writing */
+  fileHandle = CreateFileA(path, GENERIC_READ | GENERIC_WRITE,
+                           FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+                           (size == 0u) ? OPEN_EXISTING : OPEN_ALWAYS,
+                           FILE_ATTRIBUTE_NORMAL, NULL);
+  if (fileHandle == INVALID_HANDLE_VALUE)
+  {
+    return -1;
+  }
+  if (GetFileSizeEx(fileHandle, &fileSize))
+  {
+    file->previousSize = (uint64_t)fileSize.QuadPart;
+  }
+  if (size == 0u)
+  {
+    size = (size_t)file->previousSize;
+  }
+  if (size == 0u)
+  {
+    CloseHandle(fileHandle);
+    return -1;
+  }
+
+  /* The mapping grows or shrinks the file to the requested size */
+  fileSize.QuadPart = (LONGLONG)size;
+  if (!SetFilePointerEx(fileHandle, fileSize, NULL, FILE_BEGIN) ||
+      !SetEndOfFile(fileHandle))
+  {
+    CloseHandle(fileHandle);
+    return -1;
+  }
+
+  mappingHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READWRITE,
+                                     (DWORD)((uint64_t)size >> 32),
+                                     (DWORD)(size & 0xFFFFFFFFu), NULL);
+  if (mappingHandle == NULL)
+  {
+    CloseHandle(fileHandle);
+    return -1;
+  }
+
+  file->data = MapViewOfFile(mappingHandle, FILE_MAP_ALL_ACCESS, 0, 0, size);
+  if (file->data == NULL)
+  {
+    CloseHandle(mappingHandle);
+    CloseHandle(fileHandle);
+    return -1;
+  }
+
+  file->size = size;
+  file->fileHandle = fileHandle;
+  file->mappingHandle = mappingHandle;
+
+  return 0;
+}
+
+/* Maps an existing file as it is, its size is never changed */
+int mappedFileOpenReadOnly(MappedFile *file, const char *path)
+{
+  LARGE_INTEGER fileSize;
+  HANDLE fileHandle;
+  HANDLE mappingHandle;
+
+  memset(file, 0, sizeof(*file));
+
+  fileHandle = CreateFileA(path, GENERIC_READ,
+                           FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+                           OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (fileHandle == INVALID_HANDLE_VALUE)
+  {
+    return -1;
+  }
+  if (!GetFileSizeEx(fileHandle, &fileSize) || (fileSize.QuadPart == 0))
+  {
+    CloseHandle(fileHandle);
+    return -1;
+  }
+  file->previousSize = (uint64_t)fileSize.QuadPart;
+
+  mappingHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READONLY, 0, 0,
+                                     NULL);
+  if (mappingHandle == NULL)
+  {
+    CloseHandle(fileHandle);
+    return -1;
+  }
+
+  file->data = MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0,
+                             (SIZE_T)file->previousSize);
+  if (file->data == NULL)
+  {
+    CloseHandle(mappingHandle);
+    CloseHandle(fileHandle);
+    return -1;
+  }
+
+  file->size = (size_t)file->previousSize;
+  file->readOnly = 1u;
+  file->fileHandle = fileHandle;
+  file->mappingHandle = mappingHandle;
+
+  return 0;
+}
+
+int mappedFileFlush(MappedFile *file, int wait)
+{
+  if (file->readOnly)
+  {
+    return 0;
+  }
+  if (!FlushViewOfFile(file->data, file->size))
+  {
+    return -1;
+  }
+  if (wait && !FlushFileBuffers((HANDLE)file->fileHandle))
+  {
+    return -1;
+  }
+
+  return 0;
+}
+
+void mappedFileClose(MappedFile *file)
+{
+  if (file->data != NULL)
+  {
+    UnmapViewOfFile(file->data);
+    CloseHandle((HANDLE)file->mappingHandle);
+    CloseHandle((HANDLE)file->fileHandle);
+  }
+  file->data = NULL;
+  file->size = 0u;
+  file->readOnly = 0u;
+}
+#else
+int mappedFileOpen(MappedFile *file, const char *path, size_t size)
+{
+  struct stat status;
+  void *data;
+
+  memset(file, 0, sizeof(*file));
+
+  file->fd = open(path, (size == 0u) ? O_RDWR : (O_RDWR | O_CREAT), 0644);
+  if (file->fd < 0)
+  {
+    return -1;
+  }
+  if (fstat(file->fd, &status) == 0)
+  {
+    file->previousSize = (uint64_t)status.st_size;
+  }
+  if (size == 0u)
+  {
+    size = (size_t)file->previousSize;
+  }
+  if (size == 0u)
+  {
+    close(file->fd);
+    file->fd = -1;
+    return -1;
+  }
+
+  if (ftruncate(file->fd, (off_t)size) != 0)
+  {
+    close(file->fd);
+    file->fd = -1;
+    return -1;
+  }
+
+  data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, file->fd, 0);
+  if (data == MAP_FAILED)
+  {
+    close(file->fd);
+    file->fd = -1;
+    return -1;
+  }
+
+  file->data = data;
+  file->size = size;
+
+  return 0;
+}
+
+/* Maps an existing file as it is, its size is never changed */
+int mappedFileOpenReadOnly(MappedFile *file, const char *path)
+{
+  struct stat status;
+  void *data;
+
+  memset(file, 0, sizeof(*file));
+
+  file->fd = open(path, O_RDONLY);
+  if (file->fd < 0)
+  {
+    return -1;
+  }
+  if ((fstat(file->fd, &status) != 0) || (status.st_size == 0))
+  {
+    close(file->fd);
+    file->fd = -1;
+    return -1;
+  }
+  file->previousSize = (uint64_t)status.st_size;
+
+  data = mmap(NULL, (size_t)file->previousSize, PROT_READ, MAP_SHARED,
+              file->fd, 0);
+  if (data == MAP_FAILED)
+  {
+    close(file->fd);
+    file->fd = -1;
+    return -1;
+  }
+
+  file->data = data;
+  file->size = (size_t)file->previousSize;
+  file->readOnly = 1u;
+
+  return 0;
+}
+
+int mappedFileFlush(MappedFile *file, int wait)
+{
+  if (file->readOnly)
+  {
+    return 0;
+  }
+  return msync(file->data, file->size, wait ? MS_SYNC : MS_ASYNC);
+}
+
+void mappedFileClose(MappedFile *file)
+{
+  if (file->data != NULL)
+  {
+    munmap(file->data, file->size);
+  }
+  if (file->fd >= 0)
+  {
+    close(file->fd);
+  }
+  file->data = NULL;
+  file->size = 0u;
+  file->readOnly = 0u;
+  file->fd = -1;
+}
+#endif
@@ -0,0 +1,46 @@
+/*******************************************************************************
+* Authors:
+*    Uros Cvjetinovic & Uros Popovic
+* @file
+* \brief File mapped into memory, shared by the process and the tools that
+*   keep state on disk. On Windows it is built on CreateFileMapping, elsewhere
+*   on mmap. A store into the mapping reaches the file without any write call,
+*   it survives a crash of the program as soon as it is done and survives a
+*   crash of the machine once the mapping was flushed.
+*   Opening with size 0 maps an existing file as it is. A file opened read
+*   only may at the same time be mapped for writing by another program, e.g.
+*   a query next to a running historian; the reader sees the stores of the
+*   writer but never changes the file.
+*******************************************************************************/
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+/******* include headers ******************************************************/
+#include <stddef.h>
+#include <stdint.h>
+
+/******* type definitions *****************************************************/
+typedef struct
+{
+  void *data;
+  size_t size;
+  uint64_t previousSize;  /* size of the file before it was opened, 0 if new */
+  uint32_t readOnly;
+#if defined(_WIN32)
+  void *fileHandle;
+  void *mappingHandle;
+#else
+  int fd;
+#endif
+} MappedFile;
+
+/******* declaration of global functions **************************************/
+int mappedFileOpen(MappedFile *file, const char *path, size_t size);
+
+int mappedFileOpenReadOnly(MappedFile *file, const char *path);
+
+int mappedFileFlush(MappedFile *file, int wait);
+
+void mappedFileClose(MappedFile *file);
+
+#endif /* MAPPEDFILE_H */
@@ -0,0 +1,394 @@
+/*******************************************************************************
+* Authors:
+*    Uros Cvjetinovic & Uros Popovic
+* @file
+* \brief Payload format of the pressure and actuator topics, see payload.h.
+*******************************************************************************/
+
+/******* include headers ******************************************************/
+#include <stdio.h>
+#include <string.h>
+#include "payload.h"
+#include "textparse.h"
+
+/******* local macros *********************************************************/
+#define OFFSET_MAGIC            0u
+#define OFFSET_VERSION          1u
+#define OFFSET_TYPE             2u
+#define OFFSET_FLAGS            3u
+#define OFFSET_SEQUENCE         4u
+#define OFFSET_TIMESTAMP        8u
+#define OFFSET_VALUE            16u
+#define OFFSET_CORRELATION      20u
+#define OFFSET_SENT             24u
+#define OFFSET_BATCHCOUNT       4u
+#define OFFSET_BATCHRESERVED    6u
+#define OFFSET_BATCHSEQUENCE    8u
+#define OFFSET_BATCHTIMESTAMP   12u
+#define OFFSET_ENTRYINSTANCE    0u
+#define OFFSET_ENTRYDELTA       2u
+#define OFFSET_ENTRYVALUE       6u
+#define MAXBATCHCOUNT           ((uint32_t) 0xFFFFu)
+#define SAMPLEFIELDS            (PAYLOAD_TIMESTAMP | PAYLOAD_SEQUENCE | \
+                                 PAYLOAD_TRACE)
+#define BATCHFIELDS             (PAYLOAD_TIMESTAMP | PAYLOAD_SEQUENCE)
+
+/******* declaration of local functions ***************************************/
+static void writeUint16(uint8_t *buffer, uint32_t value);
+
+static void writeUint32(uint8_t *buffer, uint32_t value);
+
+static void writeUint64(uint8_t *buffer, uint64_t value);
+
+static uint32_t readUint16(const uint8_t *buffer);
+
+static uint32_t readUint32(const uint8_t *buffer);
+
+static uint64_t readUint64(const uint8_t *buffer);
+
+/******* definition of local functions ****************************************/
+static void writeUint16(uint8_t *buffer, uint32_t value)
+{
+  buffer[0] = (uint8_t)value;
+  buffer[1] = (uint8_t)(value >> 8u);
+}
+
+static void writeUint32(uint8_t *buffer, uint32_t value)
+{
+  buffer[0] = (uint8_t)value;
+  buffer[1] = (uint8_t)(value >> 8u);
+  buffer[2] = (uint8_t)(value >> 16u);
+  buffer[3] = (uint8_t)(value >> 24u);
+}
+
+static void writeUint64(uint8_t *buffer, uint64_t value)
+{
+  writeUint32(buffer, (uint32_t)value);
+  writeUint32(buffer + 4u, (uint32_t)(value >> 32u));
+}
+
+static uint32_t readUint16(const uint8_t *buffer)
+{
+  return (uint32_t)buffer[0] | ((uint32_t)buffer[1] << 8u);
+}
+
+static uint32_t readUint32(const uint8_t *buffer)
+{
+  return (uint32_t)buffer[0] | ((uint32_t)buffer[1] << 8u) |
+         ((uint32_t)buffer[2] << 16u) | ((uint32_t)buffer[3] << 24u);
+}
+
+static uint64_t readUint64(const uint8_t *buffer)
+{
+  return (uint64_t)readUint32(buffer) |
+         ((uint64_t)readUint32(buffer + 4u) << 32u);
+}
+
+/******* definition of global functions ***************************************/
+int payloadFormatText(const PayloadSample *sample, char *buffer, size_t size)
+{
+  int length;
+  int total;
+
+  total = snprintf(buffer, size, "%.2f", sample->value);
+  if ((total >= 0) && ((sample->flags & PAYLOAD_TIMESTAMP) != 0u) &&
+      ((size_t)total < size))
+  {
+    length = snprintf(buffer + total, size - total, ";t=%llu",
+                      (unsigned long long)sample->timestampUs);
+    total = (length < 0) ? length : (total + length);
+  }
+  if ((total >= 0) && ((sample->flags & PAYLOAD_SEQUENCE) != 0u) &&
+      ((size_t)total < size))
+  {
+    length = snprintf(buffer + total, size - total, ";s=%lu",
+                      (unsigned long)sample->sequence);
+    total = (length < 0) ? length : (total + length);
+  }
+  if ((total >= 0) && ((sample->flags & PAYLOAD_TRACE) != 0u) &&
+      ((size_t)total < size))
+  {
+    length = snprintf(buffer + total, size - total, ";c=%lu;o=%llu",
+                      (unsigned long)sample->correlation,
+                      (unsigned long long)sample->sentUs);
+    total = (length < 0) ? length : (total + length);
+  }
+
+  return ((total < 0) || ((size_t)total >= size)) ? -1 : total;
+}
+
+/* Reads in place, the payload is neither copied nor null terminated */
+int payloadParseText(const void *payload, int payloadLength,
+                     PayloadSample *sample)
+{
+  const char *text = (const char *)payload;
+  size_t length;
+  size_t index;
+  uint64_t number;
+
+  if ((payloadLength <= 0) || (payloadLength >= (int)PAYLOAD_TEXTSIZE))
+  {
+    return -1;
+  }
+  length = (size_t)payloadLength;
+
+  index = textParseFloat(text, length, &sample->value);
+  if (index == 0u)
+  {
+    return -1;
+  }
+  sample->flags = 0u;
+  sample->sequence = 0u;
+  sample->correlation = 0u;
+  sample->timestampUs = 0u;
+  sample->sentUs = 0u;
+
+  /* Unknown fields are skipped so older readers accept newer payloads */
+  while (index < length)
+  {
+    if (text[index++] != ';')
+    {
+      continue;
+    }
+    if (((index + 2u) > length) || (text[index + 1u] != '='))
+    {
+      continue;
+    }
+    if (text[index] == 't')
+    {
+      index += 2u;
+      index += textParseUint64(&text[index], length - index, &number);
+      sample->timestampUs = number;
+      sample->flags |= PAYLOAD_TIMESTAMP;
+    }
+    else if (text[index] == 's')
+    {
+      index += 2u;
+      index += textParseUint64(&text[index], length - index, &number);
+      sample->sequence = (uint32_t)number;
+      sample->flags |= PAYLOAD_SEQUENCE;
+    }
+    else if (text[index] == 'c')
+    {
+      index += 2u;
+      index += textParseUint64(&text[index], length - index, &number);
+      sample->correlation = (uint32_t)number;
+      sample->flags |= PAYLOAD_TRACE;
+    }
+    else if (text[index] == 'o')
+    {
+      index += 2u;
+      index += textParseUint64(&text[index], length - index, &number);
+      sample->sentUs = number;
+    }
+  }
+
+  return 0;
+}
+
+int payloadEncodeBinary(const PayloadSample *sample, void *buffer,
+                        size_t size)
+{
+  uint8_t *frame = (uint8_t *)buffer;
+  uint32_t valueBits;
+  uint32_t frameSize = ((sample->flags & PAYLOAD_TRACE) != 0u) ?
+                       PAYLOAD_TRACEDSIZE : PAYLOAD_BINARYSIZE;
+
+  if (size < frameSize)
+  {
+    return -1;
+  }
+
+  memcpy(&valueBits, &sample->value, sizeof(valueBits));
+  frame[OFFSET_MAGIC] = PAYLOAD_MAGIC;
+  frame[OFFSET_VERSION] = PAYLOAD_VERSION;
+  frame[OFFSET_TYPE] = PAYLOAD_TYPE_SAMPLE;
+  frame[OFFSET_FLAGS] = (uint8_t)(sample->flags & SAMPLEFIELDS);
+  writeUint32(&frame[OFFSET_SEQUENCE], sample->sequence);
+  writeUint64(&frame[OFFSET_TIMESTAMP], sample->timestampUs);
+  writeUint32(&frame[OFFSET_VALUE], valueBits);
+  if (frameSize == PAYLOAD_TRACEDSIZE)
+  {
+    writeUint32(&frame[OFFSET_CORRELATION], sample->correlation);
+    writeUint64(&frame[OFFSET_SENT], sample->sentUs);
+  }
+
+  return (int)frameSize;
+}
+
+int payloadDecodeBinary(const void *payload, int payloadLength,
+                        PayloadSample *sample)
+{
+  const uint8_t *frame = (const uint8_t *)payload;
+  uint32_t valueBits;
+
+  /* Newer versions may only append fields, so a longer frame is accepted */
+  if ((payloadLength < (int)PAYLOAD_BINARYSIZE) ||
+      (frame[OFFSET_MAGIC] != PAYLOAD_MAGIC) ||
+      (frame[OFFSET_VERSION] < PAYLOAD_VERSION) ||
+      (frame[OFFSET_TYPE] != PAYLOAD_TYPE_SAMPLE))
+  {
+    return -1;
+  }
+
+  valueBits = readUint32(&frame[OFFSET_VALUE]);
+  memcpy(&sample->value, &valueBits, sizeof(valueBits));
+  sample->flags = (frame[OFFSET_FLAGS] & SAMPLEFIELDS) | PAYLOAD_BINARY;
+  sample->sequence = readUint32(&frame[OFFSET_SEQUENCE]);
+  sample->timestampUs = readUint64(&frame[OFFSET_TIMESTAMP]);
+  sample->correlation = 0u;
+  sample->sentUs = 0u;
+  if ((sample->flags & PAYLOAD_TRACE) != 0u)
+  {
+    if (payloadLength < (int)PAYLOAD_TRACEDSIZE)
+    {
+      return -1;
+    }
+    sample->correlation = readUint32(&frame[OFFSET_CORRELATION]);
+    sample->sentUs = readUint64(&frame[OFFSET_SENT]);
+  }
+
+  return 0;
+}
+
+int payloadEncode(const PayloadSample *sample, void *buffer, size_t size)
+{
+  if ((sample->flags & PAYLOAD_BINARY) != 0u)
+  {
+    return payloadEncodeBinary(sample, buffer, size);
+  }
+
+  return payloadFormatText(sample, (char *)buffer, size);
+}
+
+int payloadDecode(const void *payload, int payloadLength,
+                  PayloadSample *sample)
+{
+  if ((payloadLength > 0) &&
+      (((const uint8_t *)payload)[OFFSET_MAGIC] == PAYLOAD_MAGIC))
+  {
+    return payloadDecodeBinary(payload, payloadLength, sample);
+  }
+
+  return payloadParseText(payload, payloadLength, sample);
+}
+
+int payloadBatchBegin(PayloadBatchWriter *writer, void *buffer,
+                      size_t capacity, uint32_t flags, uint32_t sequence,
+                      uint64_t baseUs)
+{
+  if (capacity < PAYLOAD_BATCHHEADERSIZE)
+  {
+    return -1;
+  }
+
+  writer->frame = (uint8_t *)buffer;
+  writer->capacity = capacity;
+  writer->count = 0u;
+  writer->previousUs = baseUs;
+
+  writer->frame[OFFSET_MAGIC] = PAYLOAD_MAGIC;
+  writer->frame[OFFSET_VERSION] = PAYLOAD_VERSION;
+  writer->frame[OFFSET_TYPE] = PAYLOAD_TYPE_BATCH;
+  writer->frame[OFFSET_FLAGS] = (uint8_t)(flags & BATCHFIELDS);
+  writeUint16(&writer->frame[OFFSET_BATCHCOUNT], 0u);
+  writeUint16(&writer->frame[OFFSET_BATCHRESERVED], 0u);
+  writeUint32(&writer->frame[OFFSET_BATCHSEQUENCE], sequence);
+  writeUint64(&writer->frame[OFFSET_BATCHTIMESTAMP], baseUs);
+
+  return 0;
+}
+
+int payloadBatchAdd(PayloadBatchWriter *writer, uint32_t instance,
+                    float value, uint64_t timestampUs)
+{
+  uint8_t *entry;
+  uint32_t valueBits;
+  size_t offset = PAYLOAD_BATCHHEADERSIZE +
+                  ((size_t)writer->count * PAYLOAD_BATCHENTRYSIZE);
+
+  if (((offset + PAYLOAD_BATCHENTRYSIZE) > writer->capacity) ||
+      (writer->count >= MAXBATCHCOUNT) || (instance > 0xFFFFu) ||
+      (timestampUs < writer->previousUs) ||
+      ((timestampUs - writer->previousUs) > UINT32_MAX))
+  {
+    return -1;
+  }
+
+  entry = &writer->frame[offset];
+  memcpy(&valueBits, &value, sizeof(valueBits));
+  writeUint16(&entry[OFFSET_ENTRYINSTANCE], instance);
+  writeUint32(&entry[OFFSET_ENTRYDELTA],
+              (uint32_t)(timestampUs - writer->previousUs));
+  writeUint32(&entry[OFFSET_ENTRYVALUE], valueBits);
+
+  writer->previousUs = timestampUs;
+  writer->count++;
+
+  return 0;
+}
+
+int payloadBatchEnd(PayloadBatchWriter *writer)
+{
+  writeUint16(&writer->frame[OFFSET_BATCHCOUNT], writer->count);
+
+  return (int)(PAYLOAD_BATCHHEADERSIZE +
+               (writer->count * PAYLOAD_BATCHENTRYSIZE));
+}
+
+int payloadBatchOpen(PayloadBatchReader *reader, const void *payload,
+                     int payloadLength)
+{
+  const uint8_t *frame = (const uint8_t *)payload;
+  uint32_t count;
+
+  if ((payloadLength < (int)PAYLOAD_BATCHHEADERSIZE) ||
+      (frame[OFFSET_MAGIC] != PAYLOAD_MAGIC) ||
+      (frame[OFFSET_VERSION] < PAYLOAD_VERSION) ||
+      (frame[OFFSET_TYPE] != PAYLOAD_TYPE_BATCH))
+  {
+    return -1;
+  }
+
+  count = readUint16(&frame[OFFSET_BATCHCOUNT]);
+  if ((PAYLOAD_BATCHHEADERSIZE + (count * PAYLOAD_BATCHENTRYSIZE)) >
+      (uint32_t)payloadLength)
+  {
+    return -1;
+  }
+
+  reader->next = &frame[PAYLOAD_BATCHHEADERSIZE];
+  reader->remaining = count;
+  reader->flags = (frame[OFFSET_FLAGS] & BATCHFIELDS) | PAYLOAD_BINARY;
+  reader->sequence = readUint32(&frame[OFFSET_BATCHSEQUENCE]);
+  reader->timestampUs = readUint64(&frame[OFFSET_BATCHTIMESTAMP]);
+
+  return 0;
+}
+
+int payloadBatchNext(PayloadBatchReader *reader, uint32_t *instance,
+                     PayloadSample *sample)
+{
+  uint32_t valueBits;
+
+  if (reader->remaining == 0u)
+  {
+    return 0;
+  }
+
+  reader->timestampUs += readUint32(&reader->next[OFFSET_ENTRYDELTA]);
+  valueBits = readUint32(&reader->next[OFFSET_ENTRYVALUE]);
+
+  *instance = readUint16(&reader->next[OFFSET_ENTRYINSTANCE]);
+  memcpy(&sample->value, &valueBits, sizeof(valueBits));
+  sample->flags = reader->flags;
+  sample->sequence = reader->sequence;
+  sample->correlation = 0u;
+  sample->timestampUs = reader->timestampUs;
+  sample->sentUs = 0u;
+
+  reader->next += PAYLOAD_BATCHENTRYSIZE;
+  reader->remaining--;
+
+  return 1;
+}
@@ -0,0 +1,129 @@
+/*******************************************************************************
+* Authors:
+*    Uros Cvjetinovic & Uros Popovic
+* @file
+* \brief Payload format of the pressure and actuator topics.
+*   Text: the value is always written first as "%.2f", so plain subscribers
+*   such as the IoT MQTT Panel app keep working. Optional fields follow as
+*   ";key=value" pairs:
+*    - t: simulated time of the sample in microseconds, set by the process in
+*         virtual time mode and echoed back by the regulator
+*    - s: sequence number of the sample
+*    - c: correlation id and o: send time in microseconds on the clock of the
+*         sender, set together by a process tracing its loop latency and
+*         echoed back by the regulator
+*   Binary: a fixed 20 byte little-endian frame, encoded and decoded directly
+*   in the message buffer without formatting or parsing text:
+*     0  uint8   magic, PAYLOAD_MAGIC (no text payload starts with it)
+*     1  uint8   version, PAYLOAD_VERSION
+*     2  uint8   type, PAYLOAD_TYPE_SAMPLE
+*     3  uint8   flags, PAYLOAD_TIMESTAMP and PAYLOAD_SEQUENCE
+*     4  uint32  sequence
+*     8  uint64  timestamp in microseconds
+*     16 float32 value
+*     20 uint32  correlation id, only with PAYLOAD_TRACE
+*     24 uint64  send time in microseconds, only with PAYLOAD_TRACE
+*   payloadDecode tells the two apart from the first byte, so readers accept
+*   both.
+*   Batches carry no trace fields.
+*   Batch: many samples, of one or of many instances, in one binary frame
+*     0  uint8   magic, PAYLOAD_MAGIC
+*     1  uint8   version, PAYLOAD_VERSION
+*     2  uint8   type, PAYLOAD_TYPE_BATCH
+*     3  uint8   flags, applying to all samples
+*     4  uint16  number of samples
+*     6  uint16  reserved, 0
+*     8  uint32  frame sequence
+*     12 uint64  base timestamp in microseconds
+*     20 samples of PAYLOAD_BATCHENTRYSIZE bytes
+*        0 uint16  instance
+*        2 uint32  microseconds since the previous sample (the base for the
+*                  first one)
+*        6 float32 value
+*******************************************************************************/
+#ifndef PAYLOAD_H
+#define PAYLOAD_H
+
+/******* include headers ******************************************************/
+#include <stddef.h>
+#include <stdint.h>
+
+/******* global macros ********************************************************/
+#define PAYLOAD_TEXTSIZE        ((uint32_t) 96u)
+#define PAYLOAD_BINARYSIZE      ((uint32_t) 20u)
+#define PAYLOAD_TRACEDSIZE      ((uint32_t) 32u)
+#define PAYLOAD_MAGIC           ((uint8_t) 0xB5u)
+#define PAYLOAD_VERSION         ((uint8_t) 1u)
+#define PAYLOAD_TYPE_SAMPLE     ((uint8_t) 1u)
+#define PAYLOAD_TYPE_BATCH      ((uint8_t) 2u)
+#define PAYLOAD_BATCHHEADERSIZE ((uint32_t) 20u)
+#define PAYLOAD_BATCHENTRYSIZE  ((uint32_t) 10u)
+
+/* Fields present in a sample */
+#define PAYLOAD_TIMESTAMP       ((uint32_t) 0x01u)
+#define PAYLOAD_SEQUENCE        ((uint32_t) 0x02u)
+#define PAYLOAD_TRACE           ((uint32_t) 0x04u)
+/* Encoding of a sample, not sent as a field */
+#define PAYLOAD_BINARY          ((uint32_t) 0x80u)
+
+/******* type definitions *****************************************************/
+typedef struct
+{
+  float value;
+  uint32_t flags;
+  uint32_t sequence;
+  uint32_t correlation;
+  uint64_t timestampUs;
+  uint64_t sentUs;
+} PayloadSample;
+
+typedef struct
+{
+  uint8_t *frame;
+  size_t capacity;
+  uint32_t count;
+  uint64_t previousUs;
+} PayloadBatchWriter;
+
+typedef struct
+{
+  const uint8_t *next;
+  uint32_t remaining;
+  uint32_t flags;
+  uint32_t sequence;
+  uint64_t timestampUs;
+} PayloadBatchReader;
+
+/******* declaration of global functions **************************************/
+int payloadFormatText(const PayloadSample *sample, char *buffer, size_t size);
+
+int payloadParseText(const void *payload, int payloadLength,
+                     PayloadSample *sample);
+
+int payloadEncodeBinary(const PayloadSample *sample, void *buffer,
+                        size_t size);
+
+int payloadDecodeBinary(const void *payload, int payloadLength,
+                        PayloadSample *sample);
+
+int payloadEncode(const PayloadSample *sample, void *buffer, size_t size);
+
+int payloadDecode(const void *payload, int payloadLength,
+                  PayloadSample *sample);
+
+int payloadBatchBegin(PayloadBatchWriter *writer, void *buffer,
+                      size_t capacity, uint32_t flags, uint32_t sequence,
+                      uint64_t baseUs);
+
+int payloadBatchAdd(PayloadBatchWriter *writer, uint32_t instance,
+                    float value, uint64_t timestampUs);
+
+int payloadBatchEnd(PayloadBatchWriter *writer);
+
+int payloadBatchOpen(PayloadBatchReader *reader, const void *payload,
+                     int payloadLength);
+
+int payloadBatchNext(PayloadBatchReader *reader, uint32_t *instance,
+                     PayloadSample *sample);
+
+#endif /* PAYLOAD_H */
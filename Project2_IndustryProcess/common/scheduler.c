@@ -0,0 +1,173 @@
+/*******************************************************************************
+* Authors:
+*    Uros Cvjetinovic & Uros Popovic
+* @file
+* \brief Drift-free periodic scheduler. On Linux the deadlines are armed on a
+*   timerfd in absolute time, other platforms sleep until each absolute
+*   deadline through the time base. Virtual time never waits.
+*******************************************************************************/
+
+/******* include headers ******************************************************/
+#include <stddef.h>
+#include "scheduler.h"
+#include "timebase.h"
+
+#if defined(__linux__)
+#include <errno.h>
+#include <unistd.h>
+#include <sys/timerfd.h>
+#endif
+
+/******* declaration of local functions ***************************************/
+static void advanceDeadline(PeriodicScheduler *scheduler, uint64_t now,
+                            SchedulerTick *tick);
+
+/******* definition of local functions ****************************************/
+static void advanceDeadline(PeriodicScheduler *scheduler, uint64_t now,
+                            SchedulerTick *tick)
+{
+  uint64_t deadline = scheduler->startNs +
+                      (scheduler->nextIndex * scheduler->periodNs);
+  uint64_t missed = 0u;
+
+  /* Every whole period between the deadline we waited for and now is a tick
+     that can no longer be served on time */
+  if (now > deadline)
+  {
+    missed = (now - deadline) / scheduler->periodNs;
+  }
+
+  tick->index = scheduler->nextIndex + missed;
+  tick->deadlineNs = deadline + (missed * scheduler->periodNs);
+  tick->wakeNs = now;
+  tick->missed = (uint32_t)missed;
+
+  scheduler->nextIndex = tick->index + 1u;
+  scheduler->tickCount++;
+  scheduler->missedTicks += missed;
+}
+
+/******* definition of global functions ***************************************/
+int schedulerInit(PeriodicScheduler *scheduler, uint64_t periodNs)
+{
+  if ((scheduler == NULL) || (periodNs == 0u))
+  {
+    return -1;
+  }
+
+  scheduler->periodNs = periodNs;
+  scheduler->startNs = timebaseNowNs() + periodNs;
+  scheduler->nextIndex = 0u;
+  scheduler->tickCount = 0u;
+  scheduler->missedTicks = 0u;
+  scheduler->timerFd = -1;
+  scheduler->virtualTime = 0;
+
+#if defined(__linux__)
+  {
+    struct itimerspec timerSpec;
+
+    scheduler->timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    if (scheduler->timerFd < 0)
+    {
+      return -1;
+    }
+
+    timerSpec.it_value.tv_sec = (time_t)(scheduler->startNs / TIMEBASE_NS_PER_S);
+    timerSpec.it_value.tv_nsec = (long)(scheduler->startNs % TIMEBASE_NS_PER_S);
+    timerSpec.it_interval.tv_sec = (time_t)(periodNs / TIMEBASE_NS_PER_S);
+    timerSpec.it_interval.tv_nsec = (long)(periodNs % TIMEBASE_NS_PER_S);
+
+    if (timerfd_settime(scheduler->timerFd, TFD_TIMER_ABSTIME, &timerSpec,
+                        NULL) != 0)
+    {
+      close(scheduler->timerFd);
+      scheduler->timerFd = -1;
+      return -1;
+    }
+  }
+#endif
+
+  return 0;
+}
+
+int schedulerInitVirtual(PeriodicScheduler *scheduler, uint64_t periodNs)
+{
+  if ((scheduler == NULL) || (periodNs == 0u))
+  {
+    return -1;
+  }
+
+  scheduler->periodNs = periodNs;
+  scheduler->startNs = periodNs;
+  scheduler->nextIndex = 0u;
+  scheduler->tickCount = 0u;
+  scheduler->missedTicks = 0u;
+  scheduler->timerFd = -1;
+  scheduler->virtualTime = 1;
+
+  return 0;
+}
+
+int schedulerResumeVirtual(PeriodicScheduler *scheduler, uint64_t nextIndex)
+{
+  /* Real time deadlines follow the clock, only simulated time can jump */
+  if (!scheduler->virtualTime)
+  {
+    return -1;
+  }
+
+  scheduler->nextIndex = nextIndex;
+
+  return 0;
+}
+
+int schedulerWaitTick(PeriodicScheduler *scheduler, SchedulerTick *tick)
+{
+  if (scheduler->virtualTime)
+  {
+    /* Simulated time jumps straight to the next deadline */
+    advanceDeadline(scheduler, scheduler->startNs +
+                               (scheduler->nextIndex * scheduler->periodNs),
+                    tick);
+    return 0;
+  }
+
+#if defined(__linux__)
+  uint64_t expirations;
+  ssize_t result;
+
+  /* The kernel keeps the absolute deadlines, a read returns once at least one
+     has passed. The expiration count is not used for the missed ticks since
+     advanceDeadline derives them from the clock for every platform. */
+  do
+  {
+    result = read(scheduler->timerFd, &expirations, sizeof(expirations));
+  } while ((result < 0) && (errno == EINTR));
+
+  if (result != (ssize_t)sizeof(expirations))
+  {
+    return -1;
+  }
+#else
+  timebaseSleepUntilNs(scheduler->startNs +
+                       (scheduler->nextIndex * scheduler->periodNs));
+#endif
+
+  advanceDeadline(scheduler, timebaseNowNs(), tick);
+
+  return 0;
+}
+
+void schedulerClose(PeriodicScheduler *scheduler)
+{
+#if defined(__linux__)
+  if (scheduler->timerFd >= 0)
+  {
+    close(scheduler->timerFd);
+    scheduler->timerFd = -1;
+  }
+#else
+  (void)scheduler;
+#endif
+}
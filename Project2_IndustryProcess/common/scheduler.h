@@ -0,0 +1,50 @@
+/*******************************************************************************
+* Authors:
+*    Uros Cvjetinovic & Uros Popovic
+* @file
+* \brief Drift-free periodic scheduler. Deadlines are computed as
+*   start + n * period, never as "previous wake-up + period", so the sampling
+*   period does not accumulate error. Deadlines that have already passed are
+*   skipped and counted instead of being fired in a burst.
+*   In virtual time mode the scheduler does not wait at all, every call
+*   returns the next deadline of simulated time, which starts at 0 or, after
+*   schedulerResumeVirtual, continues at a tick of an earlier run.
+*******************************************************************************/
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+/******* include headers ******************************************************/
+#include <stdint.h>
+
+/******* type definitions *****************************************************/
+typedef struct
+{
+  uint64_t periodNs;
+  uint64_t startNs;
+  uint64_t nextIndex;
+  uint64_t tickCount;
+  uint64_t missedTicks;
+  int timerFd;
+  int virtualTime;
+} PeriodicScheduler;
+
+typedef struct
+{
+  uint64_t index;       /* ideal tick number since start, missed ones included */
+  uint64_t deadlineNs;  /* ideal deadline of this tick */
+  uint64_t wakeNs;      /* time at which the scheduler actually returned */
+  uint32_t missed;      /* deadlines skipped since the previous tick */
+} SchedulerTick;
+
+/******* declaration of global functions **************************************/
+int schedulerInit(PeriodicScheduler *scheduler, uint64_t periodNs);
+
+int schedulerInitVirtual(PeriodicScheduler *scheduler, uint64_t periodNs);
+
+int schedulerResumeVirtual(PeriodicScheduler *scheduler, uint64_t nextIndex);
+
+int schedulerWaitTick(PeriodicScheduler *scheduler, SchedulerTick *tick);
+
+void schedulerClose(PeriodicScheduler *scheduler);
+
+#endif /* SCHEDULER_H */
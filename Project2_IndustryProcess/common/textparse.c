@@ -0,0 +1,180 @@
+/*******************************************************************************
+* Authors:
+*    Uros Cvjetinovic & Uros Popovic
+* @file
+* \brief Bounded, locale independent number parsers, see textparse.h.
+*******************************************************************************/
+
+/******* include headers ******************************************************/
+#include "textparse.h"
+
+/******* local macros *********************************************************/
+/* Nineteen decimal digits always fit into 64 bits */
+#define MAXMANTISSADIGITS       ((uint32_t) 19u)
+#define MAXEXPONENT             ((int32_t) 9999)
+#define FLOATEXACT              ((uint64_t) 1u << 24)
+#define DOUBLEEXACT             ((uint64_t) 1u << 53)
+#define FLOATPOWERS             ((int32_t) 10)
+#define DOUBLEPOWERS            ((int32_t) 22)
+
+#define ISDIGIT(character)      (((character) >= '0') && ((character) <= '9'))
+
+/******* local data objects ***************************************************/
+/* Powers of ten that are exact in the respective type */
+static const float floatPowers[FLOATPOWERS + 1] =
+{
+  1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f
+};
+
+static const double doublePowers[DOUBLEPOWERS + 1] =
+{
+  1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+/******* declaration of local functions ***************************************/
+static float scaleMantissa(uint64_t mantissa, int32_t exponent);
+
+/******* definition of local functions ****************************************/
+static float scaleMantissa(uint64_t mantissa, int32_t exponent)
+{
+  double result;
+
+  /* Both operands exact, so the one float operation rounds correctly */
+  if ((mantissa <= FLOATEXACT) && (exponent >= -FLOATPOWERS) &&
+      (exponent <= FLOATPOWERS))
+  {
+    return (exponent < 0) ? ((float)mantissa / floatPowers[-exponent]) :
+                            ((float)mantissa * floatPowers[exponent]);
+  }
+
+  result = (double)mantissa;
+  while (exponent > DOUBLEPOWERS)
+  {
+    result *= doublePowers[DOUBLEPOWERS];
+    exponent -= DOUBLEPOWERS;
+  }
+  while (exponent < -DOUBLEPOWERS)
+  {
+    result /= doublePowers[DOUBLEPOWERS];
+    exponent += DOUBLEPOWERS;
+  }
+  result = (exponent < 0) ? (result / doublePowers[-exponent]) :
+                            (result * doublePowers[exponent]);
+
+  return (float)result;
+}
+
+/******* definition of global functions ***************************************/
+/* Accepts leading blanks, a sign, digits with an optional '.' and an optional
+   exponent, like strtof without hexadecimal, inf and nan */
+size_t textParseFloat(const char *text, size_t length, float *value)
+{
+  size_t index = 0u;
+  size_t exponentIndex;
+  uint64_t mantissa = 0u;
+  int32_t exponent = 0;
+  int32_t exponentValue = 0;
+  uint32_t digits = 0u;
+  uint32_t seen = 0u;
+  int negative = 0;
+  int negativeExponent = 0;
+
+  while ((index < length) && ((text[index] == ' ') || (text[index] == '\t')))
+  {
+    index++;
+  }
+  if ((index < length) && ((text[index] == '-') || (text[index] == '+')))
+  {
+    negative = (text[index] == '-');
+    index++;
+  }
+
+  /* Digits beyond the 19th only scale the value, leading zeros are not
+     significant */
+  while ((index < length) && ISDIGIT(text[index]))
+  {
+    if (digits < MAXMANTISSADIGITS)
+    {
+      mantissa = (mantissa * 10u) + (uint64_t)(text[index] - '0');
+      digits += (mantissa != 0u) ? 1u : 0u;
+    }
+    else
+    {
+      exponent++;
+    }
+    seen = 1u;
+    index++;
+  }
+  if ((index < length) && (text[index] == '.'))
+  {
+    index++;
+    while ((index < length) && ISDIGIT(text[index]))
+    {
+      if (digits < MAXMANTISSADIGITS)
+      {
+        mantissa = (mantissa * 10u) + (uint64_t)(text[index] - '0');
+        digits += (mantissa != 0u) ? 1u : 0u;
+        exponent--;
+      }
+      seen = 1u;
+      index++;
+    }
+  }
+  if (!seen)
+  {
+    return 0u;
+  }
+
+  /* An exponent without digits is not part of the number */
+  if ((index < length) && ((text[index] == 'e') || (text[index] == 'E')))
+  {
+    exponentIndex = index + 1u;
+    if ((exponentIndex < length) &&
+        ((text[exponentIndex] == '-') || (text[exponentIndex] == '+')))
+    {
+      negativeExponent = (text[exponentIndex] == '-');
+      exponentIndex++;
+    }
+    if ((exponentIndex < length) && ISDIGIT(text[exponentIndex]))
+    {
+      while ((exponentIndex < length) && ISDIGIT(text[exponentIndex]))
+      {
+        if (exponentValue < MAXEXPONENT)
+        {
+          exponentValue = (exponentValue * 10) + (text[exponentIndex] - '0');
+        }
+        exponentIndex++;
+      }
+      exponent += negativeExponent ? -exponentValue : exponentValue;
+      index = exponentIndex;
+    }
+  }
+
+  *value = (mantissa == 0u) ? 0.0f : scaleMantissa(mantissa, exponent);
+  if (negative)
+  {
+    *value = -*value;
+  }
+
+  return index;
+}
+
+/* Saturates at UINT64_MAX instead of wrapping */
+size_t textParseUint64(const char *text, size_t length, uint64_t *value)
+{
+  size_t index = 0u;
+  uint64_t result = 0u;
+  uint64_t digit;
+
+  while ((index < length) && ISDIGIT(text[index]))
+  {
+    digit = (uint64_t)(text[index] - '0');
+    result = (result > ((UINT64_MAX - digit) / 10u)) ? UINT64_MAX :
+             ((result * 10u) + digit);
+    index++;
+  }
+  *value = result;
+
+  return index;
+}
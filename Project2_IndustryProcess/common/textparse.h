@@ -0,0 +1,26 @@
+/*******************************************************************************
+* Authors:
+*    Uros Cvjetinovic & Uros Popovic
+* @file
+* \brief Bounded number parsers for text payloads. They read straight from a
+*   message buffer that is not null terminated, never look past the given
+*   length, never allocate and always use '.' as decimal separator, whatever
+*   the locale. Each returns the number of characters consumed, 0 when the
+*   text does not start with a number.
+*   Floats with at most 7 significant digits and a decimal exponent of at
+*   most 10, which covers every "%.2f" pressure, are converted with a single
+*   correctly rounded float operation; longer ones go through double.
+*******************************************************************************/
+#ifndef TEXTPARSE_H
+#define TEXTPARSE_H
+
+/******* include headers ******************************************************/
+#include <stddef.h>
+#include <stdint.h>
+
+/******* declaration of global functions **************************************/
+size_t textParseFloat(const char *text, size_t length, float *value);
+
+size_t textParseUint64(const char *text, size_t length, uint64_t *value);
+
+#endif /* TEXTPARSE_H */
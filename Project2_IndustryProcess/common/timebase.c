@@ -0,0 +1,103 @@
+/*******************************************************************************
+* Authors:
+*    Uros Cvjetinovic & Uros Popovic
+* @file
+* \brief Monotonic time base. On Windows it is built on the performance
+*   counter, elsewhere on CLOCK_MONOTONIC and clock_nanosleep with an absolute
+*   deadline, so repeated sleeps do not accumulate error.
+*******************************************************************************/
+
+/******* include headers ******************************************************/
+#include "timebase.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <errno.h>
+#include <time.h>
+#endif
+
+/******* local macros *********************************************************/
+#if defined(_WIN32)
+/* Sleep() may overshoot by a scheduler quantum, so the last part of the wait
+   is spent yielding instead of sleeping */
+#define SPIN_WINDOW_NS          ((uint64_t) 2000000u)
+#define UNIX_EPOCH_TICKS        ((uint64_t) 116444736000000000u)
+#endif
+
+/******* definition of global functions ***************************************/
+#if defined(_WIN32)
+uint64_t timebaseNowNs(void)
+{
+  static LARGE_INTEGER frequency;
+  LARGE_INTEGER counter;
+
+  if (frequency.QuadPart == 0)
+  {
+    QueryPerformanceFrequency(&frequency);
+  }
+  QueryPerformanceCounter(&counter);
+
+  return ((uint64_t)(counter.QuadPart / frequency.QuadPart) * TIMEBASE_NS_PER_S) +
+         (((uint64_t)(counter.QuadPart % frequency.QuadPart) * TIMEBASE_NS_PER_S) /
+          (uint64_t)frequency.QuadPart);
+}
+
+void timebaseSleepUntilNs(uint64_t deadlineNs)
+{
+  uint64_t now = timebaseNowNs();
+
+  if ((deadlineNs > now) && ((deadlineNs - now) > SPIN_WINDOW_NS))
+  {
+    Sleep((DWORD)((deadlineNs - now - SPIN_WINDOW_NS) / TIMEBASE_NS_PER_MS));
+  }
+  while (timebaseNowNs() < deadlineNs)
+  {
+    SwitchToThread();
+  }
+}
+
+uint64_t timebaseWallClockMs(void)
+{
+  FILETIME fileTime;
+  ULARGE_INTEGER ticks;
+
+  /* 100 ns ticks since 1601 */
+  GetSystemTimeAsFileTime(&fileTime);
+  ticks.LowPart = fileTime.dwLowDateTime;
+  ticks.HighPart = fileTime.dwHighDateTime;
+
+  return (ticks.QuadPart - UNIX_EPOCH_TICKS) / 10000u;
+}
+#else
+uint64_t timebaseNowNs(void)
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  return ((uint64_t)now.tv_sec * TIMEBASE_NS_PER_S) + (uint64_t)now.tv_nsec;
+}
+
+void timebaseSleepUntilNs(uint64_t deadlineNs)
+{
+  struct timespec deadline;
+
+  deadline.tv_sec = (time_t)(deadlineNs / TIMEBASE_NS_PER_S);
+  deadline.tv_nsec = (long)(deadlineNs % TIMEBASE_NS_PER_S);
+
+  while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) ==
+         EINTR)
+  {
+  }
+}
+
+uint64_t timebaseWallClockMs(void)
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_REALTIME, &now);
+
+  return ((uint64_t)now.tv_sec * 1000u) + ((uint64_t)now.tv_nsec / 1000000u);
+}
+#endif
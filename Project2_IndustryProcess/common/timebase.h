@@ -0,0 +1,28 @@
+/*******************************************************************************
+* Authors:
+*    Uros Cvjetinovic & Uros Popovic
+* @file
+* \brief Monotonic time base shared by the process and the regulator. All
+*   times are in nanoseconds on a clock that never jumps with wall-clock
+*   adjustments.
+*******************************************************************************/
+#ifndef TIMEBASE_H
+#define TIMEBASE_H
+
+/******* include headers ******************************************************/
+#include <stdint.h>
+
+/******* global macros ********************************************************/
+#define TIMEBASE_NS_PER_US      ((uint64_t) 1000u)
+#define TIMEBASE_NS_PER_MS      ((uint64_t) 1000000u)
+#define TIMEBASE_NS_PER_S       ((uint64_t) 1000000000u)
+
+/******* declaration of global functions **************************************/
+uint64_t timebaseNowNs(void);
+
+void timebaseSleepUntilNs(uint64_t deadlineNs);
+
+/* Milliseconds since 1970 on the wall clock, which may jump */
+uint64_t timebaseWallClockMs(void);
+
+#endif /* TIMEBASE_H */
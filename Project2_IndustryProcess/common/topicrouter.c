@@ -0,0 +1,182 @@
+/*******************************************************************************
+* Authors:
+*    Uros Cvjetinovic & Uros Popovic
+* @file
+* \brief Hash based topic to handler routing, see topicrouter.h.
+*******************************************************************************/
+
+/******* include headers ******************************************************/
+#include <string.h>
+#include "topicrouter.h"
+
+/******* local macros *********************************************************/
+#define FNV_OFFSET              ((uint32_t) 2166136261u)
+#define FNV_PRIME               ((uint32_t) 16777619u)
+#define SLOTMASK                (TOPICROUTER_SLOTS - 1u)
+/* Nine digits always fit into 32 bits */
+#define MAXINSTANCEDIGITS       ((size_t) 9u)
+
+/******* declaration of local functions ***************************************/
+static uint32_t hashTopic(const char *topic, size_t length, uint32_t family);
+
+static uint32_t finishHash(uint32_t hash, uint32_t family);
+
+static uint32_t findRoute(const TopicRouter *router, const char *topic,
+                          size_t length, uint32_t family, uint32_t hash);
+
+static int addRoute(TopicRouter *router, const char *topic, uint32_t family,
+                    uint32_t id);
+
+/******* definition of local functions ****************************************/
+/* FNV-1a, exact topics and families of the same prefix hash differently */
+static uint32_t finishHash(uint32_t hash, uint32_t family)
+{
+  return (hash ^ family) * FNV_PRIME;
+}
+
+static uint32_t hashTopic(const char *topic, size_t length, uint32_t family)
+{
+  uint32_t hash = FNV_OFFSET;
+  size_t index;
+
+  for (index = 0u; index < length; index++)
+  {
+    hash = (hash ^ (uint8_t)topic[index]) * FNV_PRIME;
+  }
+
+  return finishHash(hash, family);
+}
+
+static uint32_t findRoute(const TopicRouter *router, const char *topic,
+                          size_t length, uint32_t family, uint32_t hash)
+{
+  uint32_t slot = hash & SLOTMASK;
+  const TopicRoute *route;
+  uint32_t probe;
+
+  for (probe = 0u; probe < TOPICROUTER_SLOTS; probe++)
+  {
+    route = &router->routes[(slot + probe) & SLOTMASK];
+    if (route->topic == NULL)
+    {
+      break;
+    }
+    if ((route->hash == hash) && (route->length == length) &&
+        (route->family == family) &&
+        (memcmp(route->topic, topic, length) == 0))
+    {
+      return route->id;
+    }
+  }
+
+  return TOPICROUTER_NONE;
+}
+
+static int addRoute(TopicRouter *router, const char *topic, uint32_t family,
+                    uint32_t id)
+{
+  size_t length = strlen(topic);
+  uint32_t hash = hashTopic(topic, length, family);
+  uint32_t slot = hash & SLOTMASK;
+  TopicRoute *route;
+
+  /* Keep the table at most half full so misses end after a few probes */
+  if ((id == TOPICROUTER_NONE) || (router->count >= (TOPICROUTER_SLOTS / 2u)) ||
+      (findRoute(router, topic, length, family, hash) != TOPICROUTER_NONE))
+  {
+    return -1;
+  }
+
+  while (router->routes[slot].topic != NULL)
+  {
+    slot = (slot + 1u) & SLOTMASK;
+  }
+
+  route = &router->routes[slot];
+  route->topic = topic;
+  route->length = (uint32_t)length;
+  route->hash = hash;
+  route->family = family;
+  route->id = id;
+  router->count++;
+
+  return 0;
+}
+
+/******* definition of global functions ***************************************/
+void topicRouterInit(TopicRouter *router)
+{
+  memset(router, 0, sizeof(*router));
+}
+
+int topicRouterAdd(TopicRouter *router, const char *topic, uint32_t id)
+{
+  return addRoute(router, topic, 0u, id);
+}
+
+/* Routes every topic "prefix/<decimal instance>" to id */
+int topicRouterAddFamily(TopicRouter *router, const char *prefix,
+                         uint32_t id)
+{
+  return addRoute(router, prefix, 1u, id);
+}
+
+/* Returns the id of the topic, or TOPICROUTER_NONE. The instance is 0 for an
+   exact topic and the decimal suffix for a family member. The topic is
+   hashed once, the hash of the prefix is the state at its last '/'. */
+uint32_t topicRouterFind(const TopicRouter *router, const char *topic,
+                         size_t length, uint32_t *instance)
+{
+  uint32_t hash = FNV_OFFSET;
+  uint32_t prefixHash = FNV_OFFSET;
+  uint32_t value = 0u;
+  uint32_t id;
+  size_t prefixLength = 0u;
+  size_t digits = 0u;
+  size_t index;
+  uint8_t character;
+
+  for (index = 0u; index < length; index++)
+  {
+    character = (uint8_t)topic[index];
+    if (character == '/')
+    {
+      prefixHash = hash;
+      prefixLength = index;
+      digits = 0u;
+      value = 0u;
+    }
+    else if ((character >= '0') && (character <= '9'))
+    {
+      digits++;
+      value = (value * 10u) + (uint32_t)(character - '0');
+    }
+    else
+    {
+      digits = MAXINSTANCEDIGITS + 1u;
+    }
+    hash = (hash ^ character) * FNV_PRIME;
+  }
+
+  id = findRoute(router, topic, length, 0u, finishHash(hash, 0u));
+  if (id != TOPICROUTER_NONE)
+  {
+    *instance = 0u;
+    return id;
+  }
+
+  /* A family member ends in "/<digits>" after a non-empty prefix */
+  if ((digits == 0u) || (digits > MAXINSTANCEDIGITS) ||
+      (prefixLength == 0u) || ((prefixLength + 1u + digits) != length))
+  {
+    return TOPICROUTER_NONE;
+  }
+
+  id = findRoute(router, topic, prefixLength, 1u, finishHash(prefixHash, 1u));
+  if (id != TOPICROUTER_NONE)
+  {
+    *instance = value;
+  }
+
+  return id;
+}
@@ -0,0 +1,51 @@
+/*******************************************************************************
+* Authors:
+*    Uros Cvjetinovic & Uros Popovic
+* @file
+* \brief Maps an arrived topic to the integer id of its handler. The topics
+*   a program subscribes to are hashed once at start-up into a small open
+*   addressing table; a message then costs one hash over its topic and
+*   usually a single compare, however many topics are routed.
+*   Besides exact topics a route can cover a family "prefix/<instance>", the
+*   decimal instance is returned with the id, so per-instance topics need no
+*   entry of their own.
+*******************************************************************************/
+#ifndef TOPICROUTER_H
+#define TOPICROUTER_H
+
+/******* include headers ******************************************************/
+#include <stddef.h>
+#include <stdint.h>
+
+/******* global macros ********************************************************/
+#define TOPICROUTER_SLOTS       ((uint32_t) 32u)
+#define TOPICROUTER_NONE        UINT32_MAX
+
+/******* type definitions *****************************************************/
+typedef struct
+{
+  const char *topic;            /* not copied, must outlive the router */
+  uint32_t length;
+  uint32_t hash;
+  uint32_t family;
+  uint32_t id;
+} TopicRoute;
+
+typedef struct
+{
+  TopicRoute routes[TOPICROUTER_SLOTS];
+  uint32_t count;
+} TopicRouter;
+
+/******* declaration of global functions **************************************/
+void topicRouterInit(TopicRouter *router);
+
+int topicRouterAdd(TopicRouter *router, const char *topic, uint32_t id);
+
+int topicRouterAddFamily(TopicRouter *router, const char *prefix,
+                         uint32_t id);
+
+uint32_t topicRouterFind(const TopicRouter *router, const char *topic,
+                         size_t length, uint32_t *instance);
+
+#endif /* TOPICROUTER_H */
@@ -0,0 +1,491 @@
+/*******************************************************************************
+* Authors:
+*    Uros Cvjetinovic & Uros Popovic
+* @file
+* \brief This program runs a regulation experiment without anybody moving a
+*  slider: it publishes the set pressures of a schedule file (schedule.h),
+*  steps, ramps and random walks, on SetPressure, which the regulator applies
+*  to all of its loops, and collects the response of the process.
+*  "experiment -n 100 -o run.csv steps.txt" runs steps.txt against 100
+*  process instances. Time is divided into periods of "-p" ms, by default the
+*  1 s sampling period of the process, on a drift-free grid of absolute
+*  deadlines; the set pressure of a period is published at its start when it
+*  changed, the lateness of every publish is recorded. "-s" seeds the random
+*  walks.
+*  Every pressure sample of CurrentPressure (loop 0), CurrentPressure/i and
+*  CurrentPressureBatch is written as a CSV row with its arrival time since
+*  the start of the experiment, the set pressure scheduled at that time and
+*  the last HysteresisCorrection of its loop, and is added to the regulation
+*  quality of its loop in the current segment (response.h). When the schedule
+*  is over, or on Ctrl+C, a line per segment summarizes all loops; "-e" is
+*  the settling band. The process has to run in real time, without "-v".
+*******************************************************************************/
+
+/******* include headers ******************************************************/
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "MQTTClient.h"
+#include "histogram.h"
+#include "payload.h"
+#include "response.h"
+#include "schedule.h"
+#include "timebase.h"
+#include "topicrouter.h"
+
+/******* local macros *********************************************************/
+#define ADDRESS         "tcp://broker.hivemq.com:1883"
+#define CLIENTID        "Experiment"
+#define TOPIC_Y         "CurrentPressure"
+#define TOPIC_YZ        "SetPressure"
+#define TOPIC_X         "HysteresisCorrection"
+#define TOPIC_Y_BATCH   "CurrentPressureBatch"
+#define QOS             0
+#define TIMEOUT         10000L
+#define PAYLOADSIZE     PAYLOAD_TEXTSIZE
+#define LOOPS           ((uint32_t) 1u)
+#define PERIOD          1000L
+#define SEED            1L
+#define BAND            2.0f
+#define OUTPUT          "experiment.csv"
+#define SUMMARYSIZE     ((uint32_t) 384u)
+/* Time between the subscription and the first set pressure */
+#define LEADIN          (100u * TIMEBASE_NS_PER_MS)
+#define USAGE           "Usage: %s [-n number of loops] [-p period in ms]" \
+                        " [-s seed of the random walks] [-e settling band]" \
+                        " [-o csv file] schedule\n"
+
+/* Handlers of the routed topics */
+#define ROUTE_Y         ((uint32_t) 0u)
+#define ROUTE_Y_BATCH   ((uint32_t) 1u)
+#define ROUTE_X         ((uint32_t) 2u)
+
+/******* local data objects ***************************************************/
+MQTTClient client;
+
+TopicRouter topicRouter;
+Schedule schedule;
+uint32_t loops = LOOPS;
+float band = BAND;
+ResponseMetrics *responses;     /* loops per segment, segment major */
+float *outputs;                 /* last correction of every loop */
+FILE *csv;
+uint64_t startNs;
+atomic_uint started;
+atomic_ullong collectedSamples;
+atomic_ullong ignoredMessages;
+Histogram publishLateness;
+uint32_t connectionLost = 0u;
+volatile sig_atomic_t running = 1;
+
+const char *subscriptions[] =
+{
+  TOPIC_Y, TOPIC_Y "/+", TOPIC_Y_BATCH, TOPIC_X, TOPIC_X "/+"
+};
+
+/******* declaration of local functions ***************************************/
+int initTopicRouter(void);
+
+void collectSample(uint32_t loop, float pressure, uint64_t arrivalNs);
+
+void collectBatch(const void *payload, int payloadLength, uint64_t arrivalNs);
+
+int messageArrivedHandler(void *context, char *topicName, int topicLen,
+                          MQTTClient_message *message);
+
+void connectionLostHandler(void *context, char *cause);
+
+void stopHandler(int signalNumber);
+
+int subscribeTopics(void);
+
+int reconnect(MQTTClient_connectOptions *connectionOptions);
+
+int publishSetpoint(float setpoint);
+
+void initResponses(void);
+
+void printSummary(uint32_t segments);
+
+int main(int argc, char* argv[]);
+
+/******* definition of local functions ****************************************/
+/* A topic "prefix" is loop 0, "prefix/i" loop i */
+int initTopicRouter(void)
+{
+  topicRouterInit(&topicRouter);
+
+  return topicRouterAdd(&topicRouter, TOPIC_Y, ROUTE_Y) |
+         topicRouterAddFamily(&topicRouter, TOPIC_Y, ROUTE_Y) |
+         topicRouterAdd(&topicRouter, TOPIC_Y_BATCH, ROUTE_Y_BATCH) |
+         topicRouterAdd(&topicRouter, TOPIC_X, ROUTE_X) |
+         topicRouterAddFamily(&topicRouter, TOPIC_X, ROUTE_X);
+}
+
+/* Runs on the MQTT client thread only, which is the one writer of the CSV
+   file and of the response metrics until the disconnect */
+void collectSample(uint32_t loop, float pressure, uint64_t arrivalNs)
+{
+  uint64_t elapsedNs;
+  uint32_t segment;
+  float setpoint;
+
+  if (!atomic_load_explicit(&started, memory_order_acquire) ||
+      (arrivalNs < startNs) || (loop >= loops))
+  {
+    atomic_fetch_add(&ignoredMessages, 1u);
+    return;
+  }
+  elapsedNs = arrivalNs - startNs;
+  segment = scheduleSegmentAt(&schedule, elapsedNs);
+  if (segment == schedule.count)
+  {
+    atomic_fetch_add(&ignoredMessages, 1u);
+    return;
+  }
+  setpoint = scheduleSetpoint(&schedule, segment, elapsedNs);
+
+  responseAdd(&responses[(segment * loops) + loop], arrivalNs, setpoint,
+              pressure);
+  fprintf(csv, "%.3f,%u,%.2f,%.2f,%.2f\n", elapsedNs / 1e6, loop, setpoint,
+          pressure, outputs[loop]);
+  atomic_fetch_add(&collectedSamples, 1u);
+}
+
+/* The samples of a frame are taken as arrived with the frame */
+void collectBatch(const void *payload, int payloadLength, uint64_t arrivalNs)
+{
+  PayloadBatchReader reader;
+  PayloadSample sample;
+  uint32_t instance;
+
+  if (payloadBatchOpen(&reader, payload, payloadLength) != 0)
+  {
+    atomic_fetch_add(&ignoredMessages, 1u);
+    return;
+  }
+  while (payloadBatchNext(&reader, &instance, &sample) == 1)
+  {
+    collectSample(instance, sample.value, arrivalNs);
+  }
+}
+
+int messageArrivedHandler(void *context, char *topicName, int topicLen,
+                          MQTTClient_message *message)
+{
+  PayloadSample sample;
+  uint32_t instance = 0u;
+  uint32_t route;
+  uint64_t arrivalNs = timebaseNowNs();
+
+  /* The client passes 0 unless the topic contains a null character */
+  route = topicRouterFind(&topicRouter, topicName,
+                          (topicLen > 0) ? (size_t)topicLen : strlen(topicName),
+                          &instance);
+  if (route == ROUTE_Y_BATCH)
+  {
+    collectBatch(message->payload, message->payloadlen, arrivalNs);
+  }
+  else if ((route == TOPICROUTER_NONE) ||
+           (payloadDecode(message->payload, message->payloadlen,
+                          &sample) != 0))
+  {
+    atomic_fetch_add(&ignoredMessages, 1u);
+  }
+  else if (route == ROUTE_Y)
+  {
+    collectSample(instance, sample.value, arrivalNs);
+  }
+  else if (instance < loops)
+  {
+    outputs[instance] = sample.value;
+  }
+
+  MQTTClient_freeMessage(&message);
+  MQTTClient_free(topicName);
+  return 1;
+}
+
+void connectionLostHandler(void *context, char *cause)
+{
+  connectionLost = 1u;
+  printf("\nConnection lost\n");
+  printf("-Cause: %s\n", cause);
+}
+
+void stopHandler(int signalNumber)
+{
+  running = 0;
+}
+
+int subscribeTopics(void)
+{
+  uint32_t index;
+  int result;
+
+  for (index = 0u; index < (sizeof(subscriptions) / sizeof(subscriptions[0]));
+       index++)
+  {
+    result = MQTTClient_subscribe(client, subscriptions[index], QOS);
+    if (result != MQTTCLIENT_SUCCESS)
+    {
+      printf("Failed to subscribe to topic %s, return code %d\n",
+             subscriptions[index], result);
+      return result;
+    }
+  }
+
+  return MQTTCLIENT_SUCCESS;
+}
+
+/* A clean session forgets the subscriptions, they are renewed */
+int reconnect(MQTTClient_connectOptions *connectionOptions)
+{
+  int numberOfConnectRetries = 100;
+  int result = MQTTCLIENT_FAILURE;
+
+  while ((result != MQTTCLIENT_SUCCESS) && (numberOfConnectRetries > 0))
+  {
+    result = MQTTClient_connect(client, connectionOptions);
+    numberOfConnectRetries--;
+  }
+  if (result != MQTTCLIENT_SUCCESS)
+  {
+    printf("Failed to reconnect, return code %d\n", result);
+    return result;
+  }
+  connectionLost = 0u;
+
+  return subscribeTopics();
+}
+
+int publishSetpoint(float setpoint)
+{
+  char payload_yz[PAYLOADSIZE];
+  PayloadSample sample;
+  MQTTClient_message publishMessage = MQTTClient_message_initializer;
+
+  memset(&sample, 0, sizeof(sample));
+  sample.value = setpoint;
+
+  publishMessage.payload = payload_yz;
+  publishMessage.payloadlen = payloadEncode(&sample, payload_yz,
+                                            sizeof(payload_yz));
+  publishMessage.qos = QOS;
+  publishMessage.retained = 0;
+
+  return MQTTClient_publishMessage(client, TOPIC_YZ, &publishMessage, NULL);
+}
+
+/* A step is measured against the set pressure before it, ramps and walks
+   only against the scheduled set pressure */
+void initResponses(void)
+{
+  const ScheduleSegment *segment;
+  uint32_t index;
+  uint32_t loop;
+
+  for (index = 0u; index < schedule.count; index++)
+  {
+    segment = &schedule.segments[index];
+    for (loop = 0u; loop < loops; loop++)
+    {
+      responseInit(&responses[(index * loops) + loop], segment->from,
+                   segment->to, segment->kind == SCHEDULE_STEP,
+                   band, startNs + segment->startNs,
+                   startNs + segment->startNs + segment->durationNs);
+    }
+  }
+}
+
+void printSummary(uint32_t segments)
+{
+  const ScheduleSegment *segment;
+  char summary[SUMMARYSIZE];
+  uint32_t index;
+
+  for (index = 0u; index < segments; index++)
+  {
+    segment = &schedule.segments[index];
+    responseSummarize(&responses[index * loops], loops, summary,
+                      sizeof(summary));
+    printf("segment %u (line %u) %s %.2f->%.2f %.1fs: %s\n", index,
+           segment->line, scheduleKindName(segment->kind), segment->from,
+           segment->to, (double)segment->durationNs / TIMEBASE_NS_PER_S,
+           summary);
+  }
+  printf("collected samples: %llu, ignored messages: %llu\n",
+         (unsigned long long)atomic_load(&collectedSamples),
+         (unsigned long long)atomic_load(&ignoredMessages));
+  histogramPrint(&publishLateness, "publish lateness");
+}
+
+int main(int argc, char* argv[])
+{
+  int result = 0;
+  int option;
+  long period = PERIOD;
+  long seed = SEED;
+  const char *output = OUTPUT;
+  const ScheduleSegment *current;
+  uint64_t periodNs;
+  uint64_t tick;
+  uint64_t elapsedNs;
+  uint32_t segment = 0u;
+  uint32_t lastSegment = UINT32_MAX;
+  uint32_t published = 0u;
+  float setpoint;
+  float lastSetpoint = 0.0f;
+  MQTTClient_connectOptions connectionOptions = MQTTClient_connectOptions_initializer;
+
+  while ((option = getopt(argc, argv, "n:p:s:e:o:")) != -1)
+  {
+    switch (option)
+    {
+      case 'n':
+        loops = (uint32_t)strtoul(optarg, NULL, 10);
+        break;
+      case 'p':
+        period = strtol(optarg, NULL, 10);
+        break;
+      case 's':
+        seed = strtol(optarg, NULL, 10);
+        break;
+      case 'e':
+        band = strtof(optarg, NULL);
+        break;
+      case 'o':
+        output = optarg;
+        break;
+      default:
+        printf(USAGE, argv[0]);
+        return 1;
+    }
+  }
+  /* Exactly one schedule has to follow the options */
+  if (optind != (argc - 1))
+  {
+    printf(USAGE, argv[0]);
+    return 1;
+  }
+  if ((loops == 0u) || (period <= 0) || (band < 0.0f))
+  {
+    printf("Loops and period must be positive, the band not negative\n");
+    return 1;
+  }
+  periodNs = (uint64_t)period * TIMEBASE_NS_PER_MS;
+
+  result = scheduleLoad(&schedule, argv[optind], periodNs, (uint32_t)seed);
+  if ((result != 0) || (schedule.count == 0u))
+  {
+    printf((result < 0) ? "Failed to open %s\n" :
+           (result > 0) ? "Invalid schedule in %s line %d\n" :
+                          "No segment in %s\n",
+           argv[optind], result);
+    return 1;
+  }
+
+  responses = (ResponseMetrics *)calloc((size_t)schedule.count * loops,
+                                        sizeof(ResponseMetrics));
+  outputs = (float *)calloc(loops, sizeof(float));
+  csv = fopen(output, "w");
+  if ((responses == NULL) || (outputs == NULL) || (csv == NULL) ||
+      (initTopicRouter() != 0))
+  {
+    printf("Failed to set up %u loops writing to %s\n", loops, output);
+    return -1;
+  }
+  fprintf(csv, "time_ms,loop,setpoint,pressure,output\n");
+  histogramReset(&publishLateness);
+
+  MQTTClient_create(&client, ADDRESS, CLIENTID, MQTTCLIENT_PERSISTENCE_NONE,
+                    NULL);
+
+  connectionOptions.keepAliveInterval = 20;
+  connectionOptions.cleansession = 1;
+
+  MQTTClient_setCallbacks(client, NULL, connectionLostHandler,
+                          messageArrivedHandler, NULL);
+
+  result = MQTTClient_connect(client, &connectionOptions);
+  if (result != MQTTCLIENT_SUCCESS)
+  {
+    printf("Failed to connect, return code %d\n", result);
+    return -1;
+  }
+  if (subscribeTopics() != MQTTCLIENT_SUCCESS)
+  {
+    return -1;
+  }
+
+  signal(SIGINT, stopHandler);
+  signal(SIGTERM, stopHandler);
+
+  printf("Running %u segment(s) for %.1f s against %u loop(s), "
+         "writing %s\n", schedule.count,
+         (double)schedule.durationNs / TIMEBASE_NS_PER_S, loops, output);
+
+  startNs = timebaseNowNs() + LEADIN;
+  initResponses();
+  atomic_store_explicit(&started, 1u, memory_order_release);
+
+  for (tick = 0u; running; tick++)
+  {
+    elapsedNs = tick * periodNs;
+    segment = scheduleSegmentAt(&schedule, elapsedNs);
+    if (segment == schedule.count)
+    {
+      break;
+    }
+    timebaseSleepUntilNs(startNs + elapsedNs);
+
+    if ((connectionLost == 1u) &&
+        (reconnect(&connectionOptions) != MQTTCLIENT_SUCCESS))
+    {
+      break;
+    }
+
+    setpoint = scheduleSetpoint(&schedule, segment, elapsedNs);
+    if (segment != lastSegment)
+    {
+      current = &schedule.segments[segment];
+      printf("Segment %u (line %u): %s to %.2f for %.1f s\n", segment,
+             current->line, scheduleKindName(current->kind), current->to,
+             (double)current->durationNs / TIMEBASE_NS_PER_S);
+      lastSegment = segment;
+    }
+    if (!published || (setpoint != lastSetpoint))
+    {
+      publishSetpoint(setpoint);
+      histogramRecord(&publishLateness,
+                      timebaseNowNs() - (startNs + elapsedNs));
+      lastSetpoint = setpoint;
+      published = 1u;
+    }
+  }
+  /* The response to the last period is collected until it is over */
+  if (running && (segment == schedule.count))
+  {
+    timebaseSleepUntilNs(startNs + schedule.durationNs);
+  }
+  else
+  {
+    segment++;
+  }
+
+  /* Once disconnected no callback touches the metrics or the file */
+  MQTTClient_disconnect(client, TIMEOUT);
+  MQTTClient_destroy(&client);
+  fclose(csv);
+
+  printSummary((segment < schedule.count) ? segment : schedule.count);
+  free(responses);
+  free(outputs);
+  scheduleFree(&schedule);
+
+  return 0;
+}
@@ -0,0 +1,146 @@
+/*******************************************************************************
+* Authors:
+*    Uros Cvjetinovic & Uros Popovic
+* @file
+* \brief Regulation quality of the response to a schedule segment, see
+*   response.h.
+*******************************************************************************/
+
+/******* include headers ******************************************************/
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include "response.h"
+#include "timebase.h"
+
+/******* definition of global functions ***************************************/
+void responseInit(ResponseMetrics *metrics, float from, float to,
+                  uint32_t step, float band, uint64_t startNs,
+                  uint64_t endNs)
+{
+  memset(metrics, 0, sizeof(*metrics));
+  metrics->from = from;
+  metrics->to = to;
+  metrics->step = step && (to != from);
+  metrics->band = band;
+  metrics->startNs = startNs;
+  metrics->tailNs = endNs - ((endNs - startNs) / 4u);
+}
+
+void responseAdd(ResponseMetrics *metrics, uint64_t nowNs, float setpoint,
+                 float pressure)
+{
+  float error = setpoint - pressure;
+  float fraction;
+
+  if (metrics->samples > 0u)
+  {
+    metrics->iae += fabsf(metrics->lastError) *
+                    ((double)(nowNs - metrics->lastNs) / TIMEBASE_NS_PER_S);
+  }
+  metrics->samples++;
+  metrics->lastNs = nowNs;
+  metrics->lastError = error;
+  metrics->maxError = fmaxf(metrics->maxError, fabsf(error));
+  if (nowNs >= metrics->tailNs)
+  {
+    metrics->tailError += error;
+    metrics->tailSamples++;
+  }
+
+  if (!metrics->step)
+  {
+    return;
+  }
+  fraction = (pressure - metrics->from) / (metrics->to - metrics->from);
+  if ((metrics->rise10Ns == 0u) && (fraction >= 0.1f))
+  {
+    metrics->rise10Ns = nowNs;
+  }
+  if ((metrics->rise90Ns == 0u) && (fraction >= 0.9f))
+  {
+    metrics->rise90Ns = nowNs;
+  }
+  metrics->overshoot = fmaxf(metrics->overshoot,
+                             (fraction - 1.0f) *
+                             fabsf(metrics->to - metrics->from));
+  if (fabsf(metrics->to - pressure) > metrics->band)
+  {
+    metrics->settledNs = 0u;
+  }
+  else if (metrics->settledNs == 0u)
+  {
+    metrics->settledNs = nowNs;
+  }
+}
+
+/* Means over the loops that have a value, worst over all of them */
+int responseSummarize(const ResponseMetrics *loops, uint32_t count,
+                      char *buffer, size_t size)
+{
+  const ResponseMetrics *metrics;
+  uint64_t samples = 0u;
+  uint32_t loop;
+  uint32_t risen = 0u;
+  uint32_t settled = 0u;
+  uint32_t tails = 0u;
+  double rise = 0.0;
+  double settling = 0.0;
+  double worstSettling = 0.0;
+  double steady = 0.0;
+  double iae = 0.0;
+  double worstIae = 0.0;
+  float overshoot = 0.0f;
+  float maxError = 0.0f;
+  float stepSize = fabsf(loops[0].to - loops[0].from);
+  int length;
+
+  for (loop = 0u; loop < count; loop++)
+  {
+    metrics = &loops[loop];
+    samples += metrics->samples;
+    iae += metrics->iae;
+    worstIae = fmax(worstIae, metrics->iae);
+    maxError = fmaxf(maxError, metrics->maxError);
+    overshoot = fmaxf(overshoot, metrics->overshoot);
+    if (metrics->tailSamples > 0u)
+    {
+      steady += metrics->tailError / metrics->tailSamples;
+      tails++;
+    }
+    if ((metrics->rise10Ns != 0u) && (metrics->rise90Ns != 0u))
+    {
+      rise += (double)(metrics->rise90Ns - metrics->rise10Ns) /
+              TIMEBASE_NS_PER_S;
+      risen++;
+    }
+    if (metrics->settledNs != 0u)
+    {
+      settling += (double)(metrics->settledNs - metrics->startNs) /
+                  TIMEBASE_NS_PER_S;
+      worstSettling = fmax(worstSettling,
+                           (double)(metrics->settledNs - metrics->startNs) /
+                           TIMEBASE_NS_PER_S);
+      settled++;
+    }
+  }
+
+  length = snprintf(buffer, size, "loops=%u samples=%llu iae=%.1f "
+                    "(worst %.1f) maxerror=%.2f steady=%.2f", count,
+                    (unsigned long long)samples,
+                    (count > 0u) ? (iae / count) : 0.0, worstIae, maxError,
+                    (tails > 0u) ? (steady / tails) : 0.0);
+  if (!loops[0].step || (length < 0) || ((size_t)length >= size))
+  {
+    return length;
+  }
+
+  return length + snprintf(buffer + length, size - (size_t)length,
+                           " rise=%.1fs (%u/%u) overshoot=%.1f%% "
+                           "settling=%.1fs (worst %.1fs, %u/%u settled "
+                           "within %.2f)",
+                           (risen > 0u) ? (rise / risen) : 0.0, risen, count,
+                           100.0 * overshoot / stepSize,
+                           (settled > 0u) ? (settling / settled) : 0.0,
+                           worstSettling, settled, count, loops[0].band);
+}
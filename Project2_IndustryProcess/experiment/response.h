@@ -0,0 +1,61 @@
+/*******************************************************************************
+* Authors:
+*    Uros Cvjetinovic & Uros Popovic
+* @file
+* \brief Regulation quality of the response of one loop to one segment of a
+*   schedule, measured on the pressure samples as they arrive:
+*   - iae: integral of the absolute error between the scheduled set pressure
+*     and the pressure, in %s, each sample held until the next one
+*   - max error: largest absolute error
+*   - steady: mean error over the last quarter of the segment, for a
+*     hysteresis law the offset of its oscillation
+*   and for a step, of the error to its final set pressure:
+*   - rise: from 10 % to 90 % of the step
+*   - overshoot: beyond the set pressure in the direction of the step, in %
+*     of the step
+*   - settling: from the start of the step until the pressure last entered
+*     the band around the set pressure without leaving it again; a loop that
+*     ended the segment outside the band did not settle
+*   responseSummarize folds the loops of one segment into mean and worst.
+*******************************************************************************/
+#ifndef RESPONSE_H
+#define RESPONSE_H
+
+/******* include headers ******************************************************/
+#include <stddef.h>
+#include <stdint.h>
+
+/******* type definitions *****************************************************/
+typedef struct
+{
+  float from;                   /* set pressure before a step */
+  float to;                     /* set pressure of a step */
+  uint32_t step;                /* rise, overshoot and settling apply */
+  float band;
+  uint64_t startNs;
+  uint64_t tailNs;              /* start of the last quarter */
+  uint32_t samples;
+  uint32_t tailSamples;
+  double iae;
+  double tailError;             /* sum over the tail samples */
+  float maxError;
+  float lastError;
+  float overshoot;              /* largest, in units of pressure */
+  uint64_t lastNs;
+  uint64_t rise10Ns;            /* 0 until reached */
+  uint64_t rise90Ns;
+  uint64_t settledNs;           /* 0 while outside the band */
+} ResponseMetrics;
+
+/******* declaration of global functions **************************************/
+void responseInit(ResponseMetrics *metrics, float from, float to,
+                  uint32_t step, float band, uint64_t startNs,
+                  uint64_t endNs);
+
+void responseAdd(ResponseMetrics *metrics, uint64_t nowNs, float setpoint,
+                 float pressure);
+
+int responseSummarize(const ResponseMetrics *loops, uint32_t count,
+                      char *buffer, size_t size);
+
+#endif /* RESPONSE_H */
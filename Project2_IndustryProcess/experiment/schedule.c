@@ -0,0 +1,325 @@
+/*******************************************************************************
+* Authors:
+*    Uros Cvjetinovic & Uros Popovic
+* @file
+* \brief Set pressure schedule of an experiment, see schedule.h.
+*******************************************************************************/
+
+/******* include headers ******************************************************/
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "schedule.h"
+
+/******* local macros *********************************************************/
+#define SCHEDULE_LINESIZE       ((uint32_t) 256u)
+#define SCHEDULE_NUMBERS        ((uint32_t) 4u)
+#define WALK_MINIMUM            10.0f
+#define WALK_MAXIMUM            90.0f
+#define DELIMITERS              " \t"
+#define XORSHIFT_SEED           ((uint32_t) 2463534242u)
+/* Periods of one segment, a walk holds a set pressure for each of them */
+#define SCHEDULE_MAXPERIODS     ((uint64_t) 10000000u)
+/* Keeps the duration within the nanoseconds of a uint64_t */
+#define SCHEDULE_MAXSECONDS     1.0e9f
+
+/******* local data objects ***************************************************/
+static const char *const kindNames[SCHEDULE_KINDS] =
+{
+  "step", "ramp", "walk"
+};
+
+/******* declaration of local functions ***************************************/
+static int parseNumbers(const char *text, float *numbers);
+
+static uint32_t nextRandom(uint32_t *state);
+
+static int drawWalk(ScheduleSegment *segment, float step, float minimum,
+                    float maximum, uint64_t periodNs, uint32_t *state);
+
+static int parseSegment(const char *text, ScheduleSegment *segment,
+                        uint64_t periodNs, uint32_t *state);
+
+static uint64_t periodsOf(const ScheduleSegment *segment, uint64_t periodNs);
+
+/******* definition of local functions ****************************************/
+/* Returns how many numbers follow, -1 when more than SCHEDULE_NUMBERS or
+   something else does */
+static int parseNumbers(const char *text, float *numbers)
+{
+  int count = 0;
+  char *end;
+
+  while (*(text += strspn(text, DELIMITERS)) != '\0')
+  {
+    if (count == (int)SCHEDULE_NUMBERS)
+    {
+      return -1;
+    }
+    numbers[count] = strtof(text, &end);
+    if ((end == text) || !isfinite(numbers[count]) ||
+        ((*end != '\0') && (strchr(DELIMITERS, *end) == NULL)))
+    {
+      return -1;
+    }
+    count++;
+    text = end;
+  }
+
+  return count;
+}
+
+/* xorshift32, the walks only need to be cheap and reproducible */
+static uint32_t nextRandom(uint32_t *state)
+{
+  uint32_t value = *state;
+
+  value ^= value << 13;
+  value ^= value >> 17;
+  value ^= value << 5;
+  *state = value;
+
+  return value;
+}
+
+static int drawWalk(ScheduleSegment *segment, float step, float minimum,
+                    float maximum, uint64_t periodNs, uint32_t *state)
+{
+  uint32_t index;
+  float value;
+
+  segment->walkCount = (uint32_t)periodsOf(segment, periodNs);
+  segment->walk = (float *)malloc(segment->walkCount * sizeof(float));
+  if (segment->walk == NULL)
+  {
+    return -1;
+  }
+
+  value = fminf(fmaxf(segment->from, minimum), maximum);
+  segment->walk[0] = value;
+  for (index = 1u; index < segment->walkCount; index++)
+  {
+    /* 24 random bits give a uniform float in [-1, 1) */
+    value += step * (((float)(nextRandom(state) >> 8) / 8388608.0f) - 1.0f);
+    value = fminf(fmaxf(value, minimum), maximum);
+    segment->walk[index] = value;
+  }
+  segment->to = value;
+
+  return 0;
+}
+
+/* Fills everything but startNs, from is the set pressure reached so far */
+static int parseSegment(const char *text, ScheduleSegment *segment,
+                        uint64_t periodNs, uint32_t *state)
+{
+  size_t length = strcspn(text, DELIMITERS);
+  float numbers[SCHEDULE_NUMBERS];
+  float minimum = WALK_MINIMUM;
+  float maximum = WALK_MAXIMUM;
+  uint32_t kind;
+  int count;
+
+  for (kind = 0u; kind < SCHEDULE_KINDS; kind++)
+  {
+    if ((strlen(kindNames[kind]) == length) &&
+        (strncmp(text, kindNames[kind], length) == 0))
+    {
+      break;
+    }
+  }
+  count = parseNumbers(text + length, numbers);
+  if ((kind == SCHEDULE_KINDS) || (count < 2) || (numbers[1] <= 0.0f) ||
+      (numbers[1] > SCHEDULE_MAXSECONDS))
+  {
+    return -1;
+  }
+  segment->kind = kind;
+  segment->durationNs = (uint64_t)((double)numbers[1] * 1e9);
+  if ((segment->durationNs < periodNs) ||
+      (periodsOf(segment, periodNs) > SCHEDULE_MAXPERIODS))
+  {
+    /* Shorter segments would be skipped between two periods, longer ones
+       would not fit the walk */
+    return -1;
+  }
+
+  if (kind != SCHEDULE_WALK)
+  {
+    if ((count != 2) || (numbers[0] < SCHEDULE_MINIMUM) ||
+        (numbers[0] > SCHEDULE_MAXIMUM))
+    {
+      return -1;
+    }
+    segment->to = numbers[0];
+    return 0;
+  }
+
+  if (count == 4)
+  {
+    minimum = numbers[2];
+    maximum = numbers[3];
+  }
+  if (((count != 2) && (count != 4)) || (numbers[0] <= 0.0f) ||
+      (minimum < SCHEDULE_MINIMUM) || (maximum > SCHEDULE_MAXIMUM) ||
+      (minimum > maximum))
+  {
+    return -1;
+  }
+
+  return drawWalk(segment, numbers[0], minimum, maximum, periodNs, state);
+}
+
+/* Periods started within the segment, each gets one set pressure */
+static uint64_t periodsOf(const ScheduleSegment *segment, uint64_t periodNs)
+{
+  return (segment->durationNs + periodNs - 1u) / periodNs;
+}
+
+/******* definition of global functions ***************************************/
+/* Returns 0, -1 when the file cannot be read, or the number of the first
+   invalid line */
+int scheduleLoad(Schedule *schedule, const char *path, uint64_t periodNs,
+                 uint32_t seed)
+{
+  FILE *file = fopen(path, "r");
+  ScheduleSegment segment;
+  ScheduleSegment *segments;
+  uint32_t capacity = 0u;
+  uint32_t state = (seed != 0u) ? seed : XORSHIFT_SEED;
+  float setpoint = 0.0f;
+  char line[SCHEDULE_LINESIZE];
+  char *text;
+  int lineNumber = 0;
+  int invalid = 0;
+
+  memset(schedule, 0, sizeof(*schedule));
+  schedule->periodNs = periodNs;
+  if ((file == NULL) || (periodNs == 0u))
+  {
+    if (file != NULL)
+    {
+      fclose(file);
+    }
+    return -1;
+  }
+
+  while (fgets(line, sizeof(line), file) != NULL)
+  {
+    lineNumber++;
+    line[strcspn(line, "#\r\n")] = '\0';
+    text = line + strspn(line, DELIMITERS);
+    if (*text == '\0')
+    {
+      continue;
+    }
+
+    memset(&segment, 0, sizeof(segment));
+    segment.line = (uint32_t)lineNumber;
+    segment.from = setpoint;
+    segment.startNs = schedule->durationNs;
+    if (parseSegment(text, &segment, periodNs, &state) != 0)
+    {
+      invalid = lineNumber;
+      break;
+    }
+    if (schedule->count == capacity)
+    {
+      capacity = (capacity == 0u) ? 16u : (2u * capacity);
+      segments = (ScheduleSegment *)realloc(schedule->segments,
+                                            capacity * sizeof(*segments));
+      if (segments == NULL)
+      {
+        free(segment.walk);
+        invalid = lineNumber;
+        break;
+      }
+      schedule->segments = segments;
+    }
+    schedule->segments[schedule->count++] = segment;
+    schedule->durationNs += segment.durationNs;
+    setpoint = segment.to;
+  }
+  fclose(file);
+
+  if (invalid != 0)
+  {
+    scheduleFree(schedule);
+  }
+
+  return invalid;
+}
+
+uint32_t scheduleSegmentAt(const Schedule *schedule, uint64_t elapsedNs)
+{
+  uint32_t low = 0u;
+  uint32_t high = schedule->count;
+  uint32_t middle;
+
+  if (elapsedNs >= schedule->durationNs)
+  {
+    return schedule->count;
+  }
+  /* Last segment starting at or before the elapsed time */
+  while ((high - low) > 1u)
+  {
+    middle = low + ((high - low) / 2u);
+    if (schedule->segments[middle].startNs <= elapsedNs)
+    {
+      low = middle;
+    }
+    else
+    {
+      high = middle;
+    }
+  }
+
+  return low;
+}
+
+/* The set pressure of the period the elapsed time falls into. A ramp moves
+   one stair per period and reaches its set pressure in the last one. */
+float scheduleSetpoint(const Schedule *schedule, uint32_t segment,
+                       uint64_t elapsedNs)
+{
+  const ScheduleSegment *current = &schedule->segments[segment];
+  uint64_t period = (elapsedNs > current->startNs) ?
+                    ((elapsedNs - current->startNs) / schedule->periodNs) : 0u;
+  uint64_t periods = periodsOf(current, schedule->periodNs);
+
+  if (period >= periods)
+  {
+    period = periods - 1u;
+  }
+
+  switch (current->kind)
+  {
+    case SCHEDULE_RAMP:
+      return current->from + ((current->to - current->from) *
+                              (float)((double)(period + 1u) / periods));
+    case SCHEDULE_WALK:
+      return current->walk[period];
+    default:
+      return current->to;
+  }
+}
+
+const char *scheduleKindName(uint32_t kind)
+{
+  return (kind < SCHEDULE_KINDS) ? kindNames[kind] : "unknown";
+}
+
+void scheduleFree(Schedule *schedule)
+{
+  uint32_t segment;
+
+  for (segment = 0u; segment < schedule->count; segment++)
+  {
+    free(schedule->segments[segment].walk);
+  }
+  free(schedule->segments);
+  schedule->segments = NULL;
+  schedule->count = 0u;
+  schedule->durationNs = 0u;
+}
@@ -0,0 +1,68 @@
+/*******************************************************************************
+* Authors:
+*    Uros Cvjetinovic & Uros Popovic
+* @file
+* \brief Set pressure schedule of an experiment, read from a text file with
+*   one segment per line, '#' starts a comment:
+*   - "step <set pressure> <hold s>": jump to the set pressure and hold it
+*   - "ramp <set pressure> <duration s>": move linearly from the set pressure
+*     reached so far to the given one
+*   - "walk <step> <duration s> [<min> <max>]": random walk, every period the
+*     set pressure moves by a uniform amount of at most step and stays within
+*     min and max, by default the 10 to 90 of the slider of the app
+*   Segments follow each other without gaps, the set pressure before the
+*   first one is 0. The walks are drawn at load time from a generator seeded
+*   with the given seed, so the same file and seed are the same experiment
+*   every time and the set pressure is a function of the elapsed time only.
+*   A segment spans at most 10 million periods.
+*******************************************************************************/
+#ifndef SCHEDULE_H
+#define SCHEDULE_H
+
+/******* include headers ******************************************************/
+#include <stdint.h>
+
+/******* global macros ********************************************************/
+#define SCHEDULE_STEP           ((uint32_t) 0u)
+#define SCHEDULE_RAMP           ((uint32_t) 1u)
+#define SCHEDULE_WALK           ((uint32_t) 2u)
+#define SCHEDULE_KINDS          ((uint32_t) 3u)
+#define SCHEDULE_MINIMUM        0.0f
+#define SCHEDULE_MAXIMUM        100.0f
+
+/******* type definitions *****************************************************/
+typedef struct
+{
+  uint32_t kind;
+  uint32_t line;                /* of the schedule file */
+  float from;                   /* set pressure before the segment */
+  float to;                     /* set pressure at its end */
+  uint64_t startNs;             /* since the start of the experiment */
+  uint64_t durationNs;
+  float *walk;                  /* walk, set pressure of every period */
+  uint32_t walkCount;
+} ScheduleSegment;
+
+typedef struct
+{
+  ScheduleSegment *segments;
+  uint32_t count;
+  uint64_t periodNs;
+  uint64_t durationNs;          /* of all segments */
+} Schedule;
+
+/******* declaration of global functions **************************************/
+int scheduleLoad(Schedule *schedule, const char *path, uint64_t periodNs,
+                 uint32_t seed);
+
+/* Returns count once the schedule is over */
+uint32_t scheduleSegmentAt(const Schedule *schedule, uint64_t elapsedNs);
+
+float scheduleSetpoint(const Schedule *schedule, uint32_t segment,
+                       uint64_t elapsedNs);
+
+const char *scheduleKindName(uint32_t kind);
+
+void scheduleFree(Schedule *schedule);
+
+#endif /* SCHEDULE_H */
@@ -0,0 +1,272 @@
+/*******************************************************************************
+* Authors:
+*    Uros Cvjetinovic & Uros Popovic
+* @file
+* \brief Gorilla compression of a time series, see gorilla.h.
+*   Bit stream of a chunk, most significant bit first:
+*    - first sample: 64-bit time, 32-bit value
+*    - time of every further sample, D being the delta-of-delta:
+*        '0' D == 0, '10' 7-bit D, '110' 9-bit D, '1110' 12-bit D (two's complement),
+*        '1111' 64-bit D
+*    - value of every further sample, X being the XOR with the previous:
+*        '0' X == 0, '10' X inside the previous window of meaningful bits,
+*        '11' 5-bit leading zeros, 5-bit length - 1, meaningful bits
+*******************************************************************************/
+
+/******* include headers ******************************************************/
+#include <string.h>
+#include "gorilla.h"
+
+/******* local macros *********************************************************/
+#define DATABITS                ((uint32_t) (sizeof(((GorillaChunk *)0)->data) * 8u))
+/* Longest encoding of one sample: 4 + 64 time bits, 2 + 5 + 5 + 32 value bits */
+#define MAXSAMPLEBITS           ((uint32_t) 112u)
+#define NOWINDOW                ((uint8_t) 0xFFu)
+
+/******* declaration of local functions ***************************************/
+static void writeBits(GorillaChunk *chunk, uint64_t value, uint32_t bits);
+
+static uint64_t readBits(GorillaReader *reader, uint32_t bits);
+
+static int64_t signExtend(uint64_t value, uint32_t bits);
+
+static uint32_t floatBits(float value);
+
+static float bitsFloat(uint32_t bits);
+
+/******* definition of local functions ****************************************/
+static void writeBits(GorillaChunk *chunk, uint64_t value, uint32_t bits)
+{
+  uint32_t position = chunk->header.bitLength;
+
+  while (bits > 0u)
+  {
+    bits--;
+    if (((value >> bits) & 1u) != 0u)
+    {
+      chunk->data[position >> 3] |= (uint8_t)(0x80u >> (position & 7u));
+    }
+    position++;
+  }
+  chunk->header.bitLength = position;
+}
+
+static uint64_t readBits(GorillaReader *reader, uint32_t bits)
+{
+  uint64_t value = 0u;
+  uint32_t position = reader->bitPosition;
+
+  while (bits > 0u)
+  {
+    value = (value << 1) |
+            ((reader->chunk->data[position >> 3] >> (7u - (position & 7u))) & 1u);
+    position++;
+    bits--;
+  }
+  reader->bitPosition = position;
+
+  return value;
+}
+
+static int64_t signExtend(uint64_t value, uint32_t bits)
+{
+  uint64_t sign = (uint64_t)1u << (bits - 1u);
+
+  return (int64_t)((value ^ sign) - sign);
+}
+
+static uint32_t floatBits(float value)
+{
+  uint32_t bits;
+
+  memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+static float bitsFloat(uint32_t bits)
+{
+  float value;
+
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+/******* definition of global functions ***************************************/
+void gorillaInit(GorillaChunk *chunk)
+{
+  memset(chunk, 0, sizeof(*chunk));
+  chunk->header.leading = NOWINDOW;
+}
+
+/* Returns 0 when the sample was stored, -1 when the chunk is full */
+int gorillaAppend(GorillaChunk *chunk, int64_t timeMs, float value)
+{
+  GorillaChunkHeader *header = &chunk->header;
+  uint32_t valueBits = floatBits(value);
+  uint32_t xorBits;
+  uint32_t leading;
+  uint32_t trailing;
+  uint32_t meaningful;
+  int64_t delta;
+  int64_t deltaOfDelta;
+
+  if ((header->bitLength + MAXSAMPLEBITS) > DATABITS)
+  {
+    return -1;
+  }
+
+  if (header->count == 0u)
+  {
+    writeBits(chunk, (uint64_t)timeMs, 64u);
+    writeBits(chunk, valueBits, 32u);
+    header->firstMs = timeMs;
+    header->minimum = value;
+    header->maximum = value;
+  }
+  else
+  {
+    delta = timeMs - header->lastMs;
+    deltaOfDelta = delta - header->lastDeltaMs;
+    header->lastDeltaMs = delta;
+    if (deltaOfDelta == 0)
+    {
+      writeBits(chunk, 0u, 1u);
+    }
+    else if ((deltaOfDelta >= -64) && (deltaOfDelta <= 63))
+    {
+      writeBits(chunk, 2u, 2u);
+      writeBits(chunk, (uint64_t)deltaOfDelta & 0x7Fu, 7u);
+    }
+    else if ((deltaOfDelta >= -256) && (deltaOfDelta <= 255))
+    {
+      writeBits(chunk, 6u, 3u);
+      writeBits(chunk, (uint64_t)deltaOfDelta & 0x1FFu, 9u);
+    }
+    else if ((deltaOfDelta >= -2048) && (deltaOfDelta <= 2047))
+    {
+      writeBits(chunk, 14u, 4u);
+      writeBits(chunk, (uint64_t)deltaOfDelta & 0xFFFu, 12u);
+    }
+    else
+    {
+      writeBits(chunk, 15u, 4u);
+      writeBits(chunk, (uint64_t)deltaOfDelta, 64u);
+    }
+
+    xorBits = valueBits ^ header->lastValueBits;
+    if (xorBits == 0u)
+    {
+      writeBits(chunk, 0u, 1u);
+    }
+    else
+    {
+      leading = (uint32_t)__builtin_clz(xorBits);
+      trailing = (uint32_t)__builtin_ctz(xorBits);
+      if ((header->leading != NOWINDOW) && (leading >= header->leading) &&
+          (trailing >= header->trailing))
+      {
+        meaningful = 32u - header->leading - header->trailing;
+        writeBits(chunk, 2u, 2u);
+        writeBits(chunk, xorBits >> header->trailing, meaningful);
+      }
+      else
+      {
+        meaningful = 32u - leading - trailing;
+        writeBits(chunk, 3u, 2u);
+        writeBits(chunk, leading, 5u);
+        writeBits(chunk, meaningful - 1u, 5u);
+        writeBits(chunk, xorBits >> trailing, meaningful);
+        header->leading = (uint8_t)leading;
+        header->trailing = (uint8_t)trailing;
+      }
+    }
+
+    if (value < header->minimum)
+    {
+      header->minimum = value;
+    }
+    if (value > header->maximum)
+    {
+      header->maximum = value;
+    }
+  }
+
+  header->lastMs = timeMs;
+  header->lastValueBits = valueBits;
+  header->sum += value;
+  header->count++;
+
+  return 0;
+}
+
+void gorillaReaderInit(GorillaReader *reader, const GorillaChunk *chunk)
+{
+  memset(reader, 0, sizeof(*reader));
+  reader->chunk = chunk;
+  reader->leading = NOWINDOW;
+}
+
+/* Returns 1 for a sample, 0 after the last one of the chunk */
+int gorillaNext(GorillaReader *reader, int64_t *timeMs, float *value)
+{
+  uint32_t meaningful;
+  int64_t deltaOfDelta;
+
+  if (reader->index >= reader->chunk->header.count)
+  {
+    return 0;
+  }
+
+  if (reader->index == 0u)
+  {
+    reader->timeMs = (int64_t)readBits(reader, 64u);
+    reader->valueBits = (uint32_t)readBits(reader, 32u);
+  }
+  else
+  {
+    if (readBits(reader, 1u) == 0u)
+    {
+      deltaOfDelta = 0;
+    }
+    else if (readBits(reader, 1u) == 0u)
+    {
+      deltaOfDelta = signExtend(readBits(reader, 7u), 7u);
+    }
+    else if (readBits(reader, 1u) == 0u)
+    {
+      deltaOfDelta = signExtend(readBits(reader, 9u), 9u);
+    }
+    else if (readBits(reader, 1u) == 0u)
+    {
+      deltaOfDelta = signExtend(readBits(reader, 12u), 12u);
+    }
+    else
+    {
+      deltaOfDelta = (int64_t)readBits(reader, 64u);
+    }
+    reader->deltaMs += deltaOfDelta;
+    reader->timeMs += reader->deltaMs;
+
+    if (readBits(reader, 1u) != 0u)
+    {
+      if (readBits(reader, 1u) != 0u)
+      {
+        reader->leading = (uint8_t)readBits(reader, 5u);
+        meaningful = (uint32_t)readBits(reader, 5u) + 1u;
+        reader->trailing = (uint8_t)(32u - reader->leading - meaningful);
+      }
+      else
+      {
+        meaningful = 32u - reader->leading - reader->trailing;
+      }
+      reader->valueBits ^= (uint32_t)readBits(reader, meaningful)
+                           << reader->trailing;
+    }
+  }
+
+  reader->index++;
+  *timeMs = reader->timeMs;
+  *value = bitsFloat(reader->valueBits);
+
+  return 1;
+}
@@ -0,0 +1,67 @@
+/*******************************************************************************
+* Authors:
+*    Uros Cvjetinovic & Uros Popovic
+* @file
+* \brief Gorilla compression of a time series into fixed-size chunks.
+*   Timestamps are stored as the difference between consecutive deltas
+*   (delta-of-delta), which is 0 for a steady sampling period and then costs
+*   one bit. Values are XORed with the previous value, an unchanged value
+*   costs one bit and a changed one only its meaningful bits.
+*   The chunk header keeps the encoder state and a summary (count, time
+*   range, minimum, maximum, sum and last value) so appending continues
+*   after a restart and aggregates over whole chunks need no decoding.
+*******************************************************************************/
+#ifndef GORILLA_H
+#define GORILLA_H
+
+/******* include headers ******************************************************/
+#include <stdint.h>
+
+/******* global macros ********************************************************/
+#define GORILLA_CHUNKSIZE       ((uint32_t) 4096u)
+
+/******* type definitions *****************************************************/
+typedef struct
+{
+  int64_t firstMs;
+  int64_t lastMs;
+  int64_t lastDeltaMs;
+  uint32_t count;
+  uint32_t bitLength;
+  uint32_t lastValueBits;
+  uint8_t leading;        /* window of the last stored XOR, 0xFF when none */
+  uint8_t trailing;
+  uint16_t reserved;
+  float minimum;
+  float maximum;
+  double sum;
+} GorillaChunkHeader;
+
+typedef struct
+{
+  GorillaChunkHeader header;
+  uint8_t data[GORILLA_CHUNKSIZE - sizeof(GorillaChunkHeader)];
+} GorillaChunk;
+
+typedef struct
+{
+  const GorillaChunk *chunk;
+  uint32_t bitPosition;
+  uint32_t index;
+  int64_t timeMs;
+  int64_t deltaMs;
+  uint32_t valueBits;
+  uint8_t leading;
+  uint8_t trailing;
+} GorillaReader;
+
+/******* declaration of global functions **************************************/
+void gorillaInit(GorillaChunk *chunk);
+
+int gorillaAppend(GorillaChunk *chunk, int64_t timeMs, float value);
+
+void gorillaReaderInit(GorillaReader *reader, const GorillaChunk *chunk);
+
+int gorillaNext(GorillaReader *reader, int64_t *timeMs, float *value);
+
+#endif /* GORILLA_H */
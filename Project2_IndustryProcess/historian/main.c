@@ -0,0 +1,488 @@
+/*******************************************************************************
+* Authors:
+*    Uros Cvjetinovic & Uros Popovic
+* @file
+* \brief This program is a historian for the pressure loops. It subscribes to
+*  CurrentPressure, SetPressure and HysteresisCorrection (plain and per
+*  instance "/i") and CurrentPressureBatch, and stores every sample in a
+*  Gorilla compressed time series per topic (series.h) in the directory
+*  given with "-o". A sample is stamped with its arrival time on the wall
+*  clock in ms, with "-S" with the time it carries when it has one, e.g. the
+*  simulated time of a process running with "-v". Samples of a batch frame
+*  keep their spacing and are stored under CurrentPressure/i.
+*  "historian -q CurrentPressure" answers a query instead: it prints the
+*  samples from "-f" to "-t" ms as CSV, or with "-i" the minimum, maximum,
+*  mean and last value of every interval of that many ms.
+*******************************************************************************/
+
+/******* include headers ******************************************************/
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "MQTTClient.h"
+#include "payload.h"
+#include "series.h"
+#include "timebase.h"
+
+/******* local macros *********************************************************/
+#define ADDRESS         "tcp://broker.hivemq.com:1883"
+#define CLIENTID        "Historian"
+#define TOPIC_Y         "CurrentPressure"
+#define TOPIC_YZ        "SetPressure"
+#define TOPIC_X         "HysteresisCorrection"
+#define TOPIC_Y_BATCH   "CurrentPressureBatch"
+#define TOPIC_INSTANCE  "%s/%u"
+#define QOS             0
+#define TIMEOUT         10000L
+#define DIRECTORY       "."
+#define MAXSERIES       ((uint32_t) 8192u)
+#define FLUSHPERIOD     ((uint64_t) 5000u)
+#define STATSPERIOD     60L
+#define FNV_OFFSET      ((uint32_t) 2166136261u)
+#define FNV_PRIME       ((uint32_t) 16777619u)
+
+/******* local data objects ***************************************************/
+MQTTClient client;
+
+uint32_t connectionLost = 0;
+volatile sig_atomic_t running = 1;
+const char *directory = DIRECTORY;
+uint32_t sampleTimestamps = 0;
+Series *seriesTable[MAXSERIES];
+uint32_t seriesCount = 0;
+uint64_t lastFlushMs = 0;
+atomic_ullong storedSamples;
+atomic_ullong rejectedMessages;
+
+const char *subscriptions[] =
+{
+  TOPIC_Y, TOPIC_Y "/+", TOPIC_YZ, TOPIC_YZ "/+", TOPIC_X, TOPIC_X "/+",
+  TOPIC_Y_BATCH
+};
+
+/******* declaration of local functions ***************************************/
+Series *findSeries(const char *topic);
+
+void storeSample(const char *topic, int64_t timeMs, float value);
+
+void storeBatch(const void *payload, int payloadLength, uint64_t arrivalMs);
+
+void flushSeries(void);
+
+void printStats(void);
+
+int messageArrivedHandler(void *context, char *topicName, int topicLen,
+                          MQTTClient_message *message);
+
+void connectionLostHandler(void *context, char *cause);
+
+void stopHandler(int signalNumber);
+
+int subscribeTopics(void);
+
+int reconnect(MQTTClient_connectOptions *connectionOptions);
+
+void printSample(void *context, int64_t timeMs, float value);
+
+void printBucket(void *context, const SeriesBucket *bucket);
+
+int runQuery(const char *topic, int64_t fromMs, int64_t toMs,
+             int64_t intervalMs);
+
+int main(int argc, char* argv[]);
+
+/******* definition of local functions ****************************************/
+/* Open addressing on the topic name, a series is opened or created the first
+   time its topic is seen */
+Series *findSeries(const char *topic)
+{
+  uint32_t hash = FNV_OFFSET;
+  uint32_t slot;
+  uint32_t probe;
+  const char *character;
+  Series *series;
+
+  for (character = topic; *character != '\0'; character++)
+  {
+    hash = (hash ^ (uint8_t)*character) * FNV_PRIME;
+  }
+
+  for (probe = 0u; probe < MAXSERIES; probe++)
+  {
+    slot = (hash + probe) % MAXSERIES;
+    series = seriesTable[slot];
+    if (series == NULL)
+    {
+      break;
+    }
+    /* A series that lost its mapping matches no topic any more */
+    if ((series->header != NULL) &&
+        (strcmp(series->header->topic, topic) == 0))
+    {
+      return series;
+    }
+  }
+  if ((probe == MAXSERIES) || (seriesCount >= (MAXSERIES / 2u)))
+  {
+    return NULL;
+  }
+
+  series = (Series *)malloc(sizeof(Series));
+  if ((series == NULL) || (seriesOpen(series, directory, topic, 1) != 0))
+  {
+    printf("Failed to open series of %s\n", topic);
+    free(series);
+    return NULL;
+  }
+  seriesTable[slot] = series;
+  seriesCount++;
+
+  return series;
+}
+
+void storeSample(const char *topic, int64_t timeMs, float value)
+{
+  Series *series = findSeries(topic);
+
+  if ((series == NULL) || (seriesAppend(series, timeMs, value) != 0))
+  {
+    atomic_fetch_add(&rejectedMessages, 1u);
+    return;
+  }
+  atomic_fetch_add(&storedSamples, 1u);
+}
+
+/* Entries of a frame are spaced by their own timestamps, the last entry
+   arrived now */
+void storeBatch(const void *payload, int payloadLength, uint64_t arrivalMs)
+{
+  PayloadBatchReader reader;
+  PayloadSample sample;
+  uint32_t instance;
+  uint64_t lastUs = 0u;
+  int64_t timeMs;
+  char topic[SERIES_TOPICSIZE];
+
+  if (payloadBatchOpen(&reader, payload, payloadLength) != 0)
+  {
+    atomic_fetch_add(&rejectedMessages, 1u);
+    return;
+  }
+  while (payloadBatchNext(&reader, &instance, &sample) == 1)
+  {
+    lastUs = sample.timestampUs;
+  }
+
+  payloadBatchOpen(&reader, payload, payloadLength);
+  while (payloadBatchNext(&reader, &instance, &sample) == 1)
+  {
+    timeMs = sampleTimestamps ? (int64_t)(sample.timestampUs / 1000u) :
+             (int64_t)(arrivalMs - ((lastUs - sample.timestampUs) / 1000u));
+    snprintf(topic, sizeof(topic), TOPIC_INSTANCE, TOPIC_Y, instance);
+    storeSample(topic, timeMs, sample.value);
+  }
+}
+
+void flushSeries(void)
+{
+  uint32_t slot;
+
+  for (slot = 0u; slot < MAXSERIES; slot++)
+  {
+    if (seriesTable[slot] != NULL)
+    {
+      seriesFlush(seriesTable[slot]);
+    }
+  }
+}
+
+void printStats(void)
+{
+  uint64_t samples = 0u;
+  uint64_t bits = 0u;
+  uint32_t slot;
+  uint32_t chunk;
+  const Series *series;
+
+  for (slot = 0u; slot < MAXSERIES; slot++)
+  {
+    series = seriesTable[slot];
+    if ((series == NULL) || (series->header == NULL))
+    {
+      continue;
+    }
+    samples += series->header->samples;
+    for (chunk = 0u; chunk < series->chunkCount; chunk++)
+    {
+      bits += series->chunks[chunk].header.bitLength;
+    }
+  }
+
+  printf("Series: %u, stored samples: %llu, rejected: %llu, "
+         "%.2f bits per sample\n", seriesCount,
+         (unsigned long long)atomic_load(&storedSamples),
+         (unsigned long long)atomic_load(&rejectedMessages),
+         (samples > 0u) ? ((double)bits / samples) : 0.0);
+}
+
+int messageArrivedHandler(void *context, char *topicName, int topicLen,
+                          MQTTClient_message *message) 
+{
+  PayloadSample sample;
+  uint64_t arrivalMs = timebaseWallClockMs();
+  int64_t timeMs = (int64_t)arrivalMs;
+
+  if (strcmp(topicName, TOPIC_Y_BATCH) == 0)
+  {
+    storeBatch(message->payload, message->payloadlen, arrivalMs);
+  }
+  else if (payloadDecode(message->payload, message->payloadlen, &sample) == 0)
+  {
+    if (sampleTimestamps && ((sample.flags & PAYLOAD_TIMESTAMP) != 0u))
+    {
+      timeMs = (int64_t)(sample.timestampUs / 1000u);
+    }
+    storeSample(topicName, timeMs, sample.value);
+  }
+  else
+  {
+    atomic_fetch_add(&rejectedMessages, 1u);
+  }
+
+  /* The series are only touched from this thread while connected */
+  if ((arrivalMs - lastFlushMs) >= FLUSHPERIOD)
+  {
+    flushSeries();
+    lastFlushMs = arrivalMs;
+  }
+
+  MQTTClient_freeMessage(&message);
+  MQTTClient_free(topicName);
+  return 1;
+}
+
+void connectionLostHandler(void *context, char *cause) 
+{
+  connectionLost = 1u;
+  printf("\nConnection lost\n");
+  printf("-Cause: %s\n", cause);
+}
+
+void stopHandler(int signalNumber) 
+{
+  running = 0;
+}
+
+int subscribeTopics(void)
+{
+  uint32_t index;
+  int result;
+
+  for (index = 0u; index < (sizeof(subscriptions) / sizeof(subscriptions[0]));
+       index++)
+  {
+    result = MQTTClient_subscribe(client, subscriptions[index], QOS);
+    if (result != MQTTCLIENT_SUCCESS)
+    {
+      printf("Failed to subscribe to topic %s, return code %d\n",
+             subscriptions[index], result);
+      return result;
+    }
+  }
+
+  return MQTTCLIENT_SUCCESS;
+}
+
+/* A clean session forgets the subscriptions, they are renewed */
+int reconnect(MQTTClient_connectOptions *connectionOptions)
+{
+  int numberOfConnectRetries = 100;
+  int result = MQTTCLIENT_FAILURE;
+
+  while ((result != MQTTCLIENT_SUCCESS) && (numberOfConnectRetries > 0))
+  {
+    result = MQTTClient_connect(client, connectionOptions);
+    numberOfConnectRetries--;
+  }
+  if (result != MQTTCLIENT_SUCCESS)
+  {
+    printf("Failed to reconnect, return code %d\n", result);
+    return result;
+  }
+  connectionLost = 0u;
+
+  return subscribeTopics();
+}
+
+void printSample(void *context, int64_t timeMs, float value)
+{
+  printf("%lld,%.6g\n", (long long)timeMs, value);
+}
+
+void printBucket(void *context, const SeriesBucket *bucket)
+{
+  printf("%lld,%.6g,%.6g,%.6g,%.6g,%u\n", (long long)bucket->startMs,
+         bucket->minimum, bucket->maximum, bucket->sum / bucket->count,
+         bucket->last, bucket->count);
+}
+
+int runQuery(const char *topic, int64_t fromMs, int64_t toMs,
+             int64_t intervalMs)
+{
+  Series series;
+  uint64_t startNs = timebaseNowNs();
+  uint64_t rows;
+
+  if (seriesOpen(&series, directory, topic, 0) != 0)
+  {
+    fprintf(stderr, "No series of %s in %s\n", topic, directory);
+    return 1;
+  }
+
+  if (intervalMs > 0)
+  {
+    /* Without a start the buckets are aligned to the interval */
+    if ((fromMs == INT64_MIN) && (series.chunkCount > 0u))
+    {
+      fromMs = series.chunks[0].header.firstMs -
+               (series.chunks[0].header.firstMs % intervalMs);
+    }
+    printf("time_ms,min,max,mean,last,count\n");
+    rows = seriesDownsample(&series, fromMs, toMs, intervalMs, printBucket,
+                            NULL);
+  }
+  else
+  {
+    printf("time_ms,value\n");
+    rows = seriesQuery(&series, fromMs, toMs, printSample, NULL);
+  }
+
+  fprintf(stderr, "%llu row(s) from %llu sample(s) in %.3f ms\n",
+          (unsigned long long)rows,
+          (unsigned long long)series.header->samples,
+          (timebaseNowNs() - startNs) / 1e6);
+  seriesClose(&series);
+
+  return 0;
+}
+
+int main(int argc, char* argv[]) 
+{
+  int result = 0;
+  int option;
+  uint32_t index;
+  const char *queryTopic = NULL;
+  int64_t fromMs = INT64_MIN;
+  int64_t toMs = INT64_MAX;
+  int64_t intervalMs = 0;
+  uint64_t nextStatsNs;
+  MQTTClient_connectOptions connectionOptions = MQTTClient_connectOptions_initializer;
+
+  while ((option = getopt(argc, argv, "o:Sq:f:t:i:")) != -1)
+  {
+    switch (option)
+    {
+      case 'o':
+        directory = optarg;
+        break;
+      case 'S':
+        sampleTimestamps = 1u;
+        break;
+      case 'q':
+        queryTopic = optarg;
+        break;
+      case 'f':
+        fromMs = strtoll(optarg, NULL, 10);
+        break;
+      case 't':
+        toMs = strtoll(optarg, NULL, 10);
+        break;
+      case 'i':
+        intervalMs = strtoll(optarg, NULL, 10);
+        break;
+      default:
+        printf("Usage: %s [-o directory] [-S use sample timestamps]"
+               " [-q topic [-f from ms] [-t to ms] [-i interval in ms]]\n",
+               argv[0]);
+        return 1;
+    }
+  }
+
+  if (queryTopic != NULL)
+  {
+    if (intervalMs < 0)
+    {
+      printf("Interval must be positive\n");
+      return 1;
+    }
+    return runQuery(queryTopic, fromMs, toMs, intervalMs);
+  }
+
+  MQTTClient_create(&client, ADDRESS, CLIENTID, MQTTCLIENT_PERSISTENCE_NONE,
+                    NULL);
+                    
+  connectionOptions.keepAliveInterval = 20;
+  connectionOptions.cleansession = 1;
+
+  MQTTClient_setCallbacks(client, NULL, connectionLostHandler,
+                          messageArrivedHandler, NULL);
+
+  result = MQTTClient_connect(client, &connectionOptions);
+  if (result != MQTTCLIENT_SUCCESS) 
+  {
+    printf("Failed to connect, return code %d\n", result);
+    return -1;
+  }
+
+  if (subscribeTopics() != MQTTCLIENT_SUCCESS)
+  {
+    return -1;
+  }
+  printf("Storing samples in %s\n", directory);
+
+  signal(SIGINT, stopHandler);
+  signal(SIGTERM, stopHandler);
+
+  nextStatsNs = timebaseNowNs() + ((uint64_t)STATSPERIOD * TIMEBASE_NS_PER_S);
+  while (running)
+  {
+    timebaseSleepUntilNs(timebaseNowNs() + (100u * TIMEBASE_NS_PER_MS));
+
+    if (timebaseNowNs() >= nextStatsNs)
+    {
+      printf("Stored samples: %llu, rejected: %llu\n",
+             (unsigned long long)atomic_load(&storedSamples),
+             (unsigned long long)atomic_load(&rejectedMessages));
+      nextStatsNs += (uint64_t)STATSPERIOD * TIMEBASE_NS_PER_S;
+    }
+
+    if (connectionLost == 1u)
+    {
+      result = reconnect(&connectionOptions);
+      if (result != MQTTCLIENT_SUCCESS)
+      {
+        break;
+      }
+    }
+  }
+
+  /* Once disconnected no callback touches the series any more */
+  MQTTClient_disconnect(client, TIMEOUT);
+  MQTTClient_destroy(&client);
+
+  printStats();
+  for (index = 0u; index < MAXSERIES; index++)
+  {
+    if (seriesTable[index] != NULL)
+    {
+      seriesClose(seriesTable[index]);
+      free(seriesTable[index]);
+    }
+  }
+
+  return (result == MQTTCLIENT_SUCCESS) ? 0 : -1;
+}
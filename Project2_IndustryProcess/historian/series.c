@@ -0,0 +1,350 @@
+/*******************************************************************************
+* Authors:
+*    Uros Cvjetinovic & Uros Popovic
+* @file
+* \brief Time series of one topic in a memory-mapped file, see series.h.
+*   File layout: the header in a slot of one chunk size, then the chunks.
+*******************************************************************************/
+
+/******* include headers ******************************************************/
+#include <stdio.h>
+#include <string.h>
+#include "series.h"
+
+/******* local macros *********************************************************/
+#define SERIES_MAGIC            ((uint32_t) 0x53544853u)  /* "SHTS" */
+#define SERIES_VERSION          ((uint32_t) 1u)
+#define SERIES_INITIALCHUNKS    ((uint32_t) 16u)
+#define SERIES_EXTENSION        ".hts"
+
+/******* declaration of local functions ***************************************/
+static int mapSeries(Series *series, uint32_t capacity, int readOnly);
+
+static size_t fileSize(uint32_t capacity);
+
+static uint32_t firstChunk(const Series *series, int64_t fromMs);
+
+static void addToBucket(SeriesBucket *bucket, float value);
+
+/******* definition of local functions ****************************************/
+static size_t fileSize(uint32_t capacity)
+{
+  return (size_t)GORILLA_CHUNKSIZE * ((size_t)capacity + 1u);
+}
+
+/* Maps the file with room for capacity chunks, 0 keeps its current size.
+   Without a mapping nothing points into the file any more. */
+static int mapSeries(Series *series, uint32_t capacity, int readOnly)
+{
+  int result;
+
+  series->header = NULL;
+  series->chunks = NULL;
+  series->capacity = 0u;
+  series->chunkCount = 0u;
+  result = readOnly ?
+           mappedFileOpenReadOnly(&series->file, series->path) :
+           mappedFileOpen(&series->file, series->path,
+                          (capacity == 0u) ? 0u : fileSize(capacity));
+  if (result != 0)
+  {
+    return -1;
+  }
+  if (series->file.size < fileSize(0u))
+  {
+    mappedFileClose(&series->file);
+    return -1;
+  }
+
+  series->header = (SeriesHeader *)series->file.data;
+  series->chunks = (GorillaChunk *)((uint8_t *)series->file.data +
+                                    GORILLA_CHUNKSIZE);
+  series->capacity = (uint32_t)((series->file.size / GORILLA_CHUNKSIZE) - 1u);
+
+  return 0;
+}
+
+/* Index of the first chunk that may hold samples at or after fromMs */
+static uint32_t firstChunk(const Series *series, int64_t fromMs)
+{
+  uint32_t low = 0u;
+  uint32_t high = series->chunkCount;
+  uint32_t middle;
+
+  while (low < high)
+  {
+    middle = low + ((high - low) / 2u);
+    if (series->chunks[middle].header.lastMs < fromMs)
+    {
+      low = middle + 1u;
+    }
+    else
+    {
+      high = middle;
+    }
+  }
+
+  return low;
+}
+
+static void addToBucket(SeriesBucket *bucket, float value)
+{
+  if ((bucket->count == 0u) || (value < bucket->minimum))
+  {
+    bucket->minimum = value;
+  }
+  if ((bucket->count == 0u) || (value > bucket->maximum))
+  {
+    bucket->maximum = value;
+  }
+  bucket->last = value;
+  bucket->sum += value;
+  bucket->count++;
+}
+
+/******* definition of global functions ***************************************/
+void seriesPath(const char *directory, const char *topic, char *path,
+                size_t size)
+{
+  size_t length;
+  size_t index;
+
+  snprintf(path, size, "%s/", directory);
+  length = strlen(path);
+  for (index = 0u; (topic[index] != '\0') && ((length + 1u) < size); index++)
+  {
+    /* Topic levels become part of the file name */
+    path[length++] = ((topic[index] == '/') || (topic[index] == '\\') ||
+                      (topic[index] == ':')) ? '_' : topic[index];
+  }
+  path[length] = '\0';
+  snprintf(path + length, size - length, "%s", SERIES_EXTENSION);
+}
+
+int seriesOpen(Series *series, const char *directory, const char *topic,
+               int create)
+{
+  memset(series, 0, sizeof(*series));
+  seriesPath(directory, topic, series->path, sizeof(series->path));
+
+  if (mapSeries(series, 0u, !create) == 0)
+  {
+    /* A writer may add chunks while a query runs, the query only reads the
+       ones inside its mapping */
+    series->chunkCount = series->header->chunkCount;
+    if ((series->header->magic != SERIES_MAGIC) ||
+        (series->header->version != SERIES_VERSION) ||
+        (series->header->chunkSize != GORILLA_CHUNKSIZE) ||
+        (create && (series->chunkCount > series->capacity)))
+    {
+      seriesClose(series);
+      return -1;
+    }
+    if (series->chunkCount > series->capacity)
+    {
+      series->chunkCount = series->capacity;
+    }
+    return 0;
+  }
+  if (!create)
+  {
+    return -1;
+  }
+
+  if (mapSeries(series, SERIES_INITIALCHUNKS, 0) != 0)
+  {
+    return -1;
+  }
+  memset(series->header, 0, GORILLA_CHUNKSIZE);
+  series->header->magic = SERIES_MAGIC;
+  series->header->version = SERIES_VERSION;
+  series->header->chunkSize = GORILLA_CHUNKSIZE;
+  snprintf(series->header->topic, sizeof(series->header->topic), "%s", topic);
+
+  return 0;
+}
+
+int seriesAppend(Series *series, int64_t timeMs, float value)
+{
+  GorillaChunk *chunk = NULL;
+  uint32_t chunkCount;
+
+  if ((series->header == NULL) || series->file.readOnly)
+  {
+    return -1;
+  }
+  chunkCount = series->header->chunkCount;
+  if (chunkCount > 0u)
+  {
+    chunk = &series->chunks[chunkCount - 1u];
+    if (timeMs < chunk->header.lastMs)
+    {
+      timeMs = chunk->header.lastMs;
+      series->header->clamped++;
+    }
+  }
+
+  if ((chunk == NULL) || (gorillaAppend(chunk, timeMs, value) != 0))
+  {
+    if (chunkCount == series->capacity)
+    {
+      /* Remapping moves the chunks, nothing may point into them here.
+         A file holding only its header has no chunk to double */
+      mappedFileClose(&series->file);
+      if (mapSeries(series, (chunkCount < SERIES_INITIALCHUNKS) ?
+                    SERIES_INITIALCHUNKS : (2u * chunkCount), 0) != 0)
+      {
+        /* Back at the old size the series is full but still consistent,
+           without any mapping it stays without header */
+        if (mapSeries(series, chunkCount, 0) == 0)
+        {
+          series->chunkCount = chunkCount;
+        }
+        return -1;
+      }
+    }
+    chunk = &series->chunks[chunkCount];
+    gorillaInit(chunk);
+    series->header->chunkCount = chunkCount + 1u;
+    gorillaAppend(chunk, timeMs, value);
+  }
+  series->chunkCount = series->header->chunkCount;
+  series->header->samples++;
+
+  return 0;
+}
+
+/* Calls back for every sample from fromMs to toMs, returns their number */
+uint64_t seriesQuery(const Series *series, int64_t fromMs, int64_t toMs,
+                     SeriesSampleCallback callback, void *context)
+{
+  GorillaReader reader;
+  uint32_t chunk;
+  int64_t timeMs;
+  float value;
+  uint64_t samples = 0u;
+
+  for (chunk = firstChunk(series, fromMs);
+       (chunk < series->chunkCount) &&
+       (series->chunks[chunk].header.firstMs <= toMs);
+       chunk++)
+  {
+    gorillaReaderInit(&reader, &series->chunks[chunk]);
+    while (gorillaNext(&reader, &timeMs, &value) == 1)
+    {
+      if ((timeMs >= fromMs) && (timeMs <= toMs))
+      {
+        callback(context, timeMs, value);
+        samples++;
+      }
+    }
+  }
+
+  return samples;
+}
+
+/* Calls back for every non-empty bucket of intervalMs starting at fromMs,
+   returns the number of buckets */
+uint64_t seriesDownsample(const Series *series, int64_t fromMs, int64_t toMs,
+                          int64_t intervalMs, SeriesBucketCallback callback,
+                          void *context)
+{
+  const GorillaChunkHeader *header;
+  GorillaReader reader;
+  SeriesBucket bucket;
+  uint32_t chunk;
+  int64_t timeMs;
+  int64_t bucketIndex;
+  float value;
+  uint64_t buckets = 0u;
+
+  memset(&bucket, 0, sizeof(bucket));
+  for (chunk = firstChunk(series, fromMs);
+       (chunk < series->chunkCount) &&
+       (series->chunks[chunk].header.firstMs <= toMs);
+       chunk++)
+  {
+    header = &series->chunks[chunk].header;
+    bucketIndex = (header->firstMs - fromMs) / intervalMs;
+
+    if ((header->firstMs >= fromMs) && (header->lastMs <= toMs) &&
+        (bucketIndex == ((header->lastMs - fromMs) / intervalMs)))
+    {
+      /* The whole chunk falls into one bucket, its summary is enough */
+      if ((bucket.count > 0u) &&
+          (bucket.startMs != (fromMs + (bucketIndex * intervalMs))))
+      {
+        callback(context, &bucket);
+        buckets++;
+        bucket.count = 0u;
+      }
+      if (bucket.count == 0u)
+      {
+        memset(&bucket, 0, sizeof(bucket));
+        bucket.startMs = fromMs + (bucketIndex * intervalMs);
+        bucket.minimum = header->minimum;
+        bucket.maximum = header->maximum;
+      }
+      if (header->minimum < bucket.minimum)
+      {
+        bucket.minimum = header->minimum;
+      }
+      if (header->maximum > bucket.maximum)
+      {
+        bucket.maximum = header->maximum;
+      }
+      memcpy(&bucket.last, &header->lastValueBits, sizeof(bucket.last));
+      bucket.sum += header->sum;
+      bucket.count += header->count;
+      continue;
+    }
+
+    gorillaReaderInit(&reader, &series->chunks[chunk]);
+    while (gorillaNext(&reader, &timeMs, &value) == 1)
+    {
+      if ((timeMs < fromMs) || (timeMs > toMs))
+      {
+        continue;
+      }
+      bucketIndex = (timeMs - fromMs) / intervalMs;
+      if ((bucket.count > 0u) &&
+          (bucket.startMs != (fromMs + (bucketIndex * intervalMs))))
+      {
+        callback(context, &bucket);
+        buckets++;
+        bucket.count = 0u;
+      }
+      if (bucket.count == 0u)
+      {
+        memset(&bucket, 0, sizeof(bucket));
+        bucket.startMs = fromMs + (bucketIndex * intervalMs);
+      }
+      addToBucket(&bucket, value);
+    }
+  }
+  if (bucket.count > 0u)
+  {
+    callback(context, &bucket);
+    buckets++;
+  }
+
+  return buckets;
+}
+
+int seriesFlush(Series *series)
+{
+  return mappedFileFlush(&series->file, 0);
+}
+
+void seriesClose(Series *series)
+{
+  if (series->file.data == NULL)
+  {
+    return;
+  }
+
+  mappedFileFlush(&series->file, 1);
+  mappedFileClose(&series->file);
+  series->header = NULL;
+  series->chunks = NULL;
+}
@@ -0,0 +1,89 @@
+/*******************************************************************************
+* Authors:
+*    Uros Cvjetinovic & Uros Popovic
+* @file
+* \brief Time series of one topic stored in a memory-mapped file of Gorilla
+*   chunks (gorilla.h). Samples are only appended, so the chunks are ordered
+*   by time and a range query finds its first chunk by binary search. A
+*   downsampling query takes the summary of every chunk that falls into one
+*   bucket as a whole and decodes only the chunks that straddle a bucket
+*   border or the range. The file doubles in size when its chunks run out.
+*   A series may be appended to by one thread only.
+*   Opened without create a series is mapped read only for queries, which
+*   may run next to a historian appending to the same file: a query sees the
+*   chunks that existed when it opened the series. A series whose file
+*   could not be remapped to grow has no header any more and refuses every
+*   append.
+*******************************************************************************/
+#ifndef SERIES_H
+#define SERIES_H
+
+/******* include headers ******************************************************/
+#include <stddef.h>
+#include <stdint.h>
+#include "gorilla.h"
+#include "mappedfile.h"
+
+/******* global macros ********************************************************/
+#define SERIES_TOPICSIZE        ((uint32_t) 128u)
+#define SERIES_PATHSIZE         ((uint32_t) 512u)
+
+/******* type definitions *****************************************************/
+typedef struct
+{
+  uint32_t magic;
+  uint32_t version;
+  uint32_t chunkSize;
+  uint32_t chunkCount;
+  uint64_t samples;
+  uint64_t clamped;     /* samples older than their predecessor */
+  char topic[SERIES_TOPICSIZE];
+} SeriesHeader;
+
+typedef struct
+{
+  MappedFile file;
+  char path[SERIES_PATHSIZE];
+  SeriesHeader *header;
+  GorillaChunk *chunks;
+  uint32_t capacity;
+  uint32_t chunkCount;          /* chunks within this mapping */
+} Series;
+
+typedef struct
+{
+  int64_t startMs;
+  uint32_t count;
+  float minimum;
+  float maximum;
+  float last;
+  double sum;
+} SeriesBucket;
+
+typedef void (*SeriesSampleCallback)(void *context, int64_t timeMs,
+                                     float value);
+
+typedef void (*SeriesBucketCallback)(void *context,
+                                     const SeriesBucket *bucket);
+
+/******* declaration of global functions **************************************/
+void seriesPath(const char *directory, const char *topic, char *path,
+                size_t size);
+
+int seriesOpen(Series *series, const char *directory, const char *topic,
+               int create);
+
+int seriesAppend(Series *series, int64_t timeMs, float value);
+
+uint64_t seriesQuery(const Series *series, int64_t fromMs, int64_t toMs,
+                     SeriesSampleCallback callback, void *context);
+
+uint64_t seriesDownsample(const Series *series, int64_t fromMs, int64_t toMs,
+                          int64_t intervalMs, SeriesBucketCallback callback,
+                          void *context);
+
+int seriesFlush(Series *series);
+
+void seriesClose(Series *series);
+
+#endif /* SERIES_H */
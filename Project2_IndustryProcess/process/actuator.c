@@ -0,0 +1,124 @@
+/*******************************************************************************
+* Authors:
+*    Uros Cvjetinovic & Uros Popovic
+* @file
+* \brief Handoff of the actuator values to the tick thread, see actuator.h.
+*******************************************************************************/
+
+/******* include headers ******************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "actuator.h"
+
+/******* local macros *********************************************************/
+#define CELL_COUNTSHIFT   32u
+#define CELL_VALUEMASK    ((uint64_t) 0xFFFFFFFFu)
+
+/******* declaration of local functions ***************************************/
+static uint64_t packCell(uint32_t writeCount, float value);
+
+static float cellValue(uint64_t cell);
+
+/******* definition of local functions ****************************************/
+static uint64_t packCell(uint32_t writeCount, float value)
+{
+  uint32_t bits;
+
+  memcpy(&bits, &value, sizeof(bits));
+  return ((uint64_t)writeCount << CELL_COUNTSHIFT) | bits;
+}
+
+static float cellValue(uint64_t cell)
+{
+  uint32_t bits = (uint32_t)(cell & CELL_VALUEMASK);
+  float value;
+
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+/******* definition of global functions ***************************************/
+int actuatorInit(ActuatorInputs *inputs, uint32_t count)
+{
+  uint32_t instance;
+
+  memset(inputs, 0, sizeof(*inputs));
+  inputs->count = count;
+  inputs->cells = (atomic_ullong *)calloc(count, sizeof(atomic_ullong));
+  inputs->readCount = (uint32_t *)calloc(count, sizeof(uint32_t));
+  if ((inputs->cells == NULL) || (inputs->readCount == NULL))
+  {
+    actuatorFree(inputs);
+    return -1;
+  }
+
+  for (instance = 0u; instance < count; instance++)
+  {
+    atomic_init(&inputs->cells[instance], packCell(0u, 0.0f));
+  }
+
+  return 0;
+}
+
+void actuatorWrite(ActuatorInputs *inputs, uint32_t instance, float value)
+{
+  atomic_ullong *cell = &inputs->cells[instance];
+  uint64_t previous = atomic_load_explicit(cell, memory_order_relaxed);
+  uint32_t writeCount = (uint32_t)(previous >> CELL_COUNTSHIFT) + 1u;
+
+  /* Single writer per cell, a plain store is enough to publish the pair */
+  atomic_store_explicit(cell, packCell(writeCount, value),
+                        memory_order_release);
+}
+
+/* Returns the number of instances with a new value, their indexes are stored
+   in changed unless it is NULL */
+uint32_t actuatorSnapshot(ActuatorInputs *inputs, float *values,
+                          uint32_t *changed)
+{
+  uint32_t instance;
+  uint32_t changes = 0u;
+  uint64_t cell;
+  uint32_t writeCount;
+
+  for (instance = 0u; instance < inputs->count; instance++)
+  {
+    cell = atomic_load_explicit(&inputs->cells[instance],
+                                memory_order_acquire);
+    writeCount = (uint32_t)(cell >> CELL_COUNTSHIFT);
+    if (writeCount == inputs->readCount[instance])
+    {
+      /* Nothing new, the plant input still holds the last value */
+      continue;
+    }
+
+    inputs->applied++;
+    inputs->overwritten += writeCount - inputs->readCount[instance] - 1u;
+    inputs->readCount[instance] = writeCount;
+    values[instance] = cellValue(cell);
+    if (changed != NULL)
+    {
+      changed[changes] = instance;
+    }
+    changes++;
+  }
+
+  return changes;
+}
+
+int actuatorFormatStats(const ActuatorInputs *inputs, char *buffer,
+                        size_t size)
+{
+  return snprintf(buffer, size, "actuator: applied=%llu overwritten=%llu",
+                  (unsigned long long)inputs->applied,
+                  (unsigned long long)inputs->overwritten);
+}
+
+void actuatorFree(ActuatorInputs *inputs)
+{
+  free(inputs->cells);
+  free(inputs->readCount);
+  inputs->cells = NULL;
+  inputs->readCount = NULL;
+}
@@ -0,0 +1,47 @@
+/*******************************************************************************
+* Authors:
+*    Uros Cvjetinovic & Uros Popovic
+* @file
+* \brief Handoff of the actuator values (hysteresis corrections) from the MQTT
+*   callback thread to the tick thread. Every instance owns a latest-value
+*   cell, a single 64-bit atomic word holding the value together with the
+*   number of values written so far, so neither side ever waits or retries:
+*   a newer value simply replaces an older one and the tick thread copies a
+*   consistent snapshot of all cells into the plant input once per tick.
+*   Each cell may be written by one thread only, which holds for the MQTT
+*   client that delivers all messages from its receive thread.
+*******************************************************************************/
+#ifndef ACTUATOR_H
+#define ACTUATOR_H
+
+/******* include headers ******************************************************/
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/******* type definitions *****************************************************/
+typedef struct
+{
+  uint32_t count;
+  /* Write count in the upper half, bits of the float value in the lower */
+  atomic_ullong *cells;
+  /* Owned by the tick thread */
+  uint32_t *readCount;
+  uint64_t applied;
+  uint64_t overwritten;
+} ActuatorInputs;
+
+/******* declaration of global functions **************************************/
+int actuatorInit(ActuatorInputs *inputs, uint32_t count);
+
+void actuatorWrite(ActuatorInputs *inputs, uint32_t instance, float value);
+
+uint32_t actuatorSnapshot(ActuatorInputs *inputs, float *values,
+                          uint32_t *changed);
+
+int actuatorFormatStats(const ActuatorInputs *inputs, char *buffer,
+                        size_t size);
+
+void actuatorFree(ActuatorInputs *inputs);
+
+#endif /* ACTUATOR_H */
@@ -0,0 +1,417 @@
+/*******************************************************************************
+* Authors:
+*    Uros Cvjetinovic & Uros Popovic
+* @file
+* \brief Summaries of the pressure over tumbling windows, see aggregator.h.
+*   A window is published on "<topic>/<length>" for a single loop and
+*   "<topic>/<length>/group/<group>" for a group, e.g.
+*   CurrentPressureSummary/10s/group/3, as
+*   {"min":..,"max":..,"mean":..,"last":..,"count":..}. The loops of many
+*   are published in frames on "<topic>/<length>/loops" as an array of
+*   [{"loop":..,"min":..,"max":..,"mean":..,"last":..,"count":..},...].
+*******************************************************************************/
+
+/******* include headers ******************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "aggregator.h"
+#include "timebase.h"
+
+/******* local macros *********************************************************/
+#define LABELSIZE               ((uint32_t) 24u)
+#define PAYLOADSIZE             ((uint32_t) 128u)
+/* A loop record is at most PAYLOADSIZE - 1 characters and a comma, a frame
+   holds at least this many between its brackets */
+#define FRAMERECORDS            ((PUBLISHER_PAYLOADSIZE - 2u) / PAYLOADSIZE)
+
+/******* declaration of local functions ***************************************/
+static void mergeCell(AggregateCell *destination, const AggregateCell *source);
+
+static void formatLength(uint64_t lengthNs, char *label, size_t size);
+
+static int postCell(Aggregator *aggregator, const char *topic,
+                    const AggregateCell *cell);
+
+static void postFrame(Aggregator *aggregator, const char *topic,
+                      char *frame, int length, uint32_t records);
+
+static void closeWindow(Aggregator *aggregator, uint32_t windowIndex);
+
+static void postLoops(Aggregator *aggregator, AggregateWindow *window,
+                      uint32_t *space);
+
+/******* definition of local functions ****************************************/
+static void mergeCell(AggregateCell *destination, const AggregateCell *source)
+{
+  if (source->count == 0u)
+  {
+    return;
+  }
+  if (destination->count == 0u)
+  {
+    *destination = *source;
+    return;
+  }
+
+  if (source->minimum < destination->minimum)
+  {
+    destination->minimum = source->minimum;
+  }
+  if (source->maximum > destination->maximum)
+  {
+    destination->maximum = source->maximum;
+  }
+  destination->last = source->last;
+  destination->sum += source->sum;
+  destination->count += source->count;
+}
+
+static void formatLength(uint64_t lengthNs, char *label, size_t size)
+{
+  if ((lengthNs % TIMEBASE_NS_PER_S) == 0u)
+  {
+    snprintf(label, size, "%llus",
+             (unsigned long long)(lengthNs / TIMEBASE_NS_PER_S));
+  }
+  else
+  {
+    snprintf(label, size, "%llums",
+             (unsigned long long)(lengthNs / TIMEBASE_NS_PER_MS));
+  }
+}
+
+static int postCell(Aggregator *aggregator, const char *topic,
+                    const AggregateCell *cell)
+{
+  char payload[PAYLOADSIZE];
+  int length;
+
+  length = snprintf(payload, sizeof(payload),
+                    "{\"min\":%.2f,\"max\":%.2f,\"mean\":%.2f,\"last\":%.2f,"
+                    "\"count\":%u}",
+                    cell->minimum, cell->maximum, cell->sum / cell->count,
+                    cell->last, cell->count);
+  if ((length >= (int)sizeof(payload)) ||
+      (publisherPostMessage(aggregator->publisher, topic, payload,
+                            length) != 0))
+  {
+    return -1;
+  }
+  aggregator->posted++;
+
+  return 0;
+}
+
+/* Closes the array of the frame, which has room for its bracket */
+static void postFrame(Aggregator *aggregator, const char *topic,
+                      char *frame, int length, uint32_t records)
+{
+  frame[length] = ']';
+  if (publisherPostMessage(aggregator->publisher, topic, frame,
+                           length + 1) == 0)
+  {
+    aggregator->posted++;
+    aggregator->loopsPosted += records;
+  }
+  else
+  {
+    aggregator->skipped += records;
+  }
+}
+
+static void closeWindow(Aggregator *aggregator, uint32_t windowIndex)
+{
+  AggregateWindow *window = &aggregator->windows[windowIndex];
+  AggregateWindow *longer = NULL;
+  AggregateCell *closed;
+  uint32_t instance;
+  uint32_t group;
+  char label[LABELSIZE];
+  char topic[PUBLISHER_TOPICSIZE];
+
+  if ((windowIndex + 1u) < aggregator->windowCount)
+  {
+    longer = &aggregator->windows[windowIndex + 1u];
+  }
+
+  for (instance = window->postIndex; instance < aggregator->count; instance++)
+  {
+    if (window->closedLoops[instance].count > 0u)
+    {
+      aggregator->skipped++;
+    }
+  }
+
+  if (aggregator->groupCount > 0u)
+  {
+    memset(window->groups, 0,
+           aggregator->groupCount * sizeof(AggregateCell));
+  }
+  for (instance = 0u; instance < aggregator->count; instance++)
+  {
+    if (aggregator->groupCount > 0u)
+    {
+      mergeCell(&window->groups[instance / aggregator->groupSize],
+                &window->loops[instance]);
+    }
+    if (longer != NULL)
+    {
+      mergeCell(&longer->loops[instance], &window->loops[instance]);
+    }
+  }
+
+  closed = window->loops;
+  window->loops = window->closedLoops;
+  window->closedLoops = closed;
+  memset(window->loops, 0, aggregator->count * sizeof(AggregateCell));
+  window->postIndex = 0u;
+  window->endNs += window->lengthNs;
+
+  /* A single loop is its own group */
+  if (aggregator->count == 1u)
+  {
+    return;
+  }
+  formatLength(window->lengthNs, label, sizeof(label));
+  for (group = 0u; group < aggregator->groupCount; group++)
+  {
+    if (window->groups[group].count > 0u)
+    {
+      snprintf(topic, sizeof(topic), "%s/%s/group/%u", aggregator->topic,
+               label, group);
+      postCell(aggregator, topic, &window->groups[group]);
+    }
+  }
+}
+
+static void postLoops(Aggregator *aggregator, AggregateWindow *window,
+                      uint32_t *space)
+{
+  char label[LABELSIZE];
+  char topic[PUBLISHER_TOPICSIZE];
+  char record[PAYLOADSIZE];
+  char frame[PUBLISHER_PAYLOADSIZE];
+  const AggregateCell *cell;
+  uint32_t records = 0u;
+  int length = 1;
+  int recordLength;
+
+  formatLength(window->lengthNs, label, sizeof(label));
+  if (aggregator->count == 1u)
+  {
+    if ((window->postIndex == 0u) && (*space > 0u))
+    {
+      if (window->closedLoops[0].count > 0u)
+      {
+        snprintf(topic, sizeof(topic), "%s/%s", aggregator->topic, label);
+        if (postCell(aggregator, topic, &window->closedLoops[0]) == 0)
+        {
+          aggregator->loopsPosted++;
+        }
+        else
+        {
+          aggregator->skipped++;
+        }
+        (*space)--;
+      }
+      window->postIndex = 1u;
+    }
+    return;
+  }
+
+  snprintf(topic, sizeof(topic), "%s/%s/loops", aggregator->topic, label);
+  frame[0] = '[';
+  while ((window->postIndex < aggregator->count) && (*space > 0u))
+  {
+    cell = &window->closedLoops[window->postIndex];
+    if (cell->count == 0u)
+    {
+      window->postIndex++;
+      continue;
+    }
+
+    recordLength = snprintf(record, sizeof(record),
+                            "{\"loop\":%u,\"min\":%.2f,\"max\":%.2f,"
+                            "\"mean\":%.2f,\"last\":%.2f,\"count\":%u}",
+                            window->postIndex, cell->minimum, cell->maximum,
+                            cell->sum / cell->count, cell->last, cell->count);
+    if (recordLength >= (int)sizeof(record))
+    {
+      aggregator->skipped++;
+      window->postIndex++;
+      continue;
+    }
+
+    /* A comma before the record and the closing bracket after it */
+    if ((length + recordLength + 2) > (int)sizeof(frame))
+    {
+      postFrame(aggregator, topic, frame, length, records);
+      (*space)--;
+      records = 0u;
+      length = 1;
+      continue;
+    }
+    if (records > 0u)
+    {
+      frame[length++] = ',';
+    }
+    memcpy(&frame[length], record, (size_t)recordLength);
+    length += recordLength;
+    records++;
+    window->postIndex++;
+  }
+
+  /* Only a posted frame takes space, the last one still has it */
+  if (records > 0u)
+  {
+    postFrame(aggregator, topic, frame, length, records);
+    (*space)--;
+  }
+}
+
+/******* definition of global functions ***************************************/
+/* Messages of a round of all windows closing in the same tick: its groups
+   and the frames of its loops, which hold at least FRAMERECORDS each */
+uint32_t aggregatorMessageCount(uint32_t count, uint32_t groupSize,
+                                uint32_t windowCount)
+{
+  uint32_t groupCount = 0u;
+
+  if (count == 1u)
+  {
+    return windowCount;
+  }
+  if (groupSize > 0u)
+  {
+    groupCount = (count + groupSize - 1u) / groupSize;
+  }
+
+  return windowCount *
+         (groupCount + ((count + FRAMERECORDS - 1u) / FRAMERECORDS));
+}
+
+int aggregatorInit(Aggregator *aggregator, Publisher *publisher,
+                   const char *topic, uint32_t count, uint32_t groupSize,
+                   const uint64_t *windowsNs, uint32_t windowCount,
+                   uint64_t startNs)
+{
+  AggregateWindow *window;
+  uint32_t index;
+
+  memset(aggregator, 0, sizeof(*aggregator));
+  if ((count == 0u) || (windowCount == 0u) ||
+      (windowCount > AGGREGATOR_MAXWINDOWS) || (groupSize > count))
+  {
+    return -1;
+  }
+  for (index = 0u; index < windowCount; index++)
+  {
+    if ((windowsNs[index] == 0u) ||
+        ((index > 0u) && ((windowsNs[index] <= windowsNs[index - 1u]) ||
+                          ((windowsNs[index] % windowsNs[index - 1u]) != 0u))))
+    {
+      return -1;
+    }
+  }
+
+  aggregator->publisher = publisher;
+  aggregator->topic = topic;
+  aggregator->count = count;
+  /* Without a group size only the loops are summarized */
+  aggregator->groupSize = groupSize;
+  aggregator->groupCount = (groupSize == 0u) ? 0u :
+                           ((count + groupSize - 1u) / groupSize);
+  aggregator->windowCount = windowCount;
+
+  for (index = 0u; index < windowCount; index++)
+  {
+    window = &aggregator->windows[index];
+    window->lengthNs = windowsNs[index];
+    window->endNs = startNs + windowsNs[index];
+    window->postIndex = count;
+    window->loops = (AggregateCell *)calloc(count, sizeof(AggregateCell));
+    window->closedLoops = (AggregateCell *)calloc(count,
+                                                  sizeof(AggregateCell));
+    if (aggregator->groupCount > 0u)
+    {
+      window->groups = (AggregateCell *)calloc(aggregator->groupCount,
+                                               sizeof(AggregateCell));
+    }
+    if ((window->loops == NULL) || (window->closedLoops == NULL) ||
+        ((aggregator->groupCount > 0u) && (window->groups == NULL)))
+    {
+      aggregatorFree(aggregator);
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+void aggregatorAdd(Aggregator *aggregator, uint32_t instance, float value)
+{
+  AggregateCell *cell = &aggregator->windows[0].loops[instance];
+
+  if ((cell->count == 0u) || (value < cell->minimum))
+  {
+    cell->minimum = value;
+  }
+  if ((cell->count == 0u) || (value > cell->maximum))
+  {
+    cell->maximum = value;
+  }
+  cell->last = value;
+  cell->sum += value;
+  cell->count++;
+}
+
+/* Closes the windows that ended by nowNs, shortest first so its cells are
+   folded into the longer ones before those close, then posts loop summaries,
+   longest window first, while the publisher has room */
+void aggregatorTick(Aggregator *aggregator, uint64_t nowNs)
+{
+  uint32_t index;
+  uint32_t space;
+
+  for (index = 0u; index < aggregator->windowCount; index++)
+  {
+    while (nowNs >= aggregator->windows[index].endNs)
+    {
+      closeWindow(aggregator, index);
+    }
+  }
+
+  space = publisherMessageSpace(aggregator->publisher);
+  for (index = aggregator->windowCount; index > 0u; index--)
+  {
+    postLoops(aggregator, &aggregator->windows[index - 1u], &space);
+  }
+}
+
+int aggregatorFormatStats(const Aggregator *aggregator, char *buffer,
+                          size_t size)
+{
+  return snprintf(buffer, size,
+                  "aggregator: windows=%u groups=%u posted=%llu loops=%llu "
+                  "skipped=%llu",
+                  aggregator->windowCount, aggregator->groupCount,
+                  (unsigned long long)aggregator->posted,
+                  (unsigned long long)aggregator->loopsPosted,
+                  (unsigned long long)aggregator->skipped);
+}
+
+void aggregatorFree(Aggregator *aggregator)
+{
+  uint32_t index;
+
+  for (index = 0u; index < AGGREGATOR_MAXWINDOWS; index++)
+  {
+    free(aggregator->windows[index].loops);
+    free(aggregator->windows[index].closedLoops);
+    free(aggregator->windows[index].groups);
+    aggregator->windows[index].loops = NULL;
+    aggregator->windows[index].closedLoops = NULL;
+    aggregator->windows[index].groups = NULL;
+  }
+}
@@ -0,0 +1,84 @@
+/*******************************************************************************
+* Authors:
+*    Uros Cvjetinovic & Uros Popovic
+* @file
+* \brief Summaries of the pressure over tumbling windows (e.g. 1 s, 10 s and
+*   1 min) for dashboards that cannot follow the raw samples of many loops.
+*   For every window the minimum, maximum, mean and last value are published
+*   per loop and, given a group size, per group of consecutive loops.
+*   A sample only updates the cell of its loop in the shortest window. When
+*   a window closes its cells are folded into the next longer window, which
+*   is why every window must be a whole multiple of the previous one, and
+*   into the group cells. The cost per sample is therefore constant, however
+*   many windows and groups there are.
+*   Group summaries are posted when their window closes. The loop summaries
+*   of many loops are packed into frames, as many as fit one message, and
+*   posted as long as the message ring of the publisher has room, the rest
+*   follows on the next ticks. aggregatorMessageCount gives the ring that
+*   takes the summaries of all windows closing in one tick. Loop summaries
+*   still waiting when their window closes again are skipped and counted.
+*******************************************************************************/
+#ifndef AGGREGATOR_H
+#define AGGREGATOR_H
+
+/******* include headers ******************************************************/
+#include <stddef.h>
+#include <stdint.h>
+#include "publisher.h"
+
+/******* global macros ********************************************************/
+#define AGGREGATOR_MAXWINDOWS   ((uint32_t) 4u)
+
+/******* type definitions *****************************************************/
+typedef struct
+{
+  float minimum;
+  float maximum;
+  float last;
+  uint32_t count;
+  double sum;
+} AggregateCell;
+
+typedef struct
+{
+  uint64_t lengthNs;
+  uint64_t endNs;
+  AggregateCell *loops;         /* window being filled */
+  AggregateCell *closedLoops;   /* last closed window, being posted */
+  AggregateCell *groups;
+  uint32_t postIndex;           /* next closed loop to post */
+} AggregateWindow;
+
+typedef struct
+{
+  Publisher *publisher;
+  const char *topic;
+  uint32_t count;
+  uint32_t groupSize;
+  uint32_t groupCount;
+  uint32_t windowCount;
+  AggregateWindow windows[AGGREGATOR_MAXWINDOWS];
+  uint64_t posted;              /* messages, one per group or frame */
+  uint64_t loopsPosted;
+  uint64_t skipped;
+} Aggregator;
+
+/******* declaration of global functions **************************************/
+uint32_t aggregatorMessageCount(uint32_t count, uint32_t groupSize,
+                                uint32_t windowCount);
+
+int aggregatorInit(Aggregator *aggregator, Publisher *publisher,
+                   const char *topic, uint32_t count, uint32_t groupSize,
+                   const uint64_t *windowsNs, uint32_t windowCount,
+                   uint64_t startNs);
+
+void aggregatorAdd(Aggregator *aggregator, uint32_t instance, float value);
+
+void aggregatorTick(Aggregator *aggregator, uint64_t nowNs);
+
+int aggregatorFormatStats(const Aggregator *aggregator, char *buffer,
+                          size_t size);
+
+void aggregatorFree(Aggregator *aggregator);
+
+#endif /* AGGREGATOR_H */
@@ -0,0 +1,139 @@
+/*******************************************************************************
+* Authors:
+*    Uros Cvjetinovic & Uros Popovic
+* @file
+* \brief Packs pressure samples into batch frames, see batcher.h.
+*******************************************************************************/
+
+/******* include headers ******************************************************/
+#include <stdio.h>
+#include <string.h>
+#include "batcher.h"
+#include "timebase.h"
+
+/******* declaration of local functions ***************************************/
+static void beginFrame(Batcher *batcher, uint64_t timestampNs);
+
+/******* definition of local functions ****************************************/
+static void beginFrame(Batcher *batcher, uint64_t timestampNs)
+{
+  payloadBatchBegin(&batcher->writer, batcher->frame, sizeof(batcher->frame),
+                    batcher->flags, batcher->sequence,
+                    timestampNs / TIMEBASE_NS_PER_US);
+}
+
+/******* definition of global functions ***************************************/
+int batcherInit(Batcher *batcher, Publisher *publisher, const char *topic,
+                uint32_t flags, uint32_t maxSamples, uint64_t maxAgeNs)
+{
+  if ((maxSamples == 0u) || (maxSamples > BATCHER_MAXSAMPLES))
+  {
+    return -1;
+  }
+
+  memset(batcher, 0, sizeof(*batcher));
+  batcher->publisher = publisher;
+  batcher->topic = topic;
+  batcher->flags = flags;
+  batcher->maxSamples = maxSamples;
+  batcher->maxAgeNs = maxAgeNs;
+  histogramReset(&batcher->addedLatency);
+
+  return 0;
+}
+
+void batcherAdd(Batcher *batcher, uint32_t instance, float value,
+                uint64_t timestampNs)
+{
+  uint64_t timestampUs = timestampNs / TIMEBASE_NS_PER_US;
+  int result;
+
+  if (batcher->writer.count == 0u)
+  {
+    beginFrame(batcher, timestampNs);
+  }
+  result = payloadBatchAdd(&batcher->writer, instance, value, timestampUs);
+  /* A time step the frame cannot encode starts a new frame, a sample no
+     frame can hold is dropped */
+  if ((result != 0) && (batcher->writer.count > 0u))
+  {
+    batcherFlush(batcher, timestampNs);
+    beginFrame(batcher, timestampNs);
+    result = payloadBatchAdd(&batcher->writer, instance, value, timestampUs);
+  }
+  if (result != 0)
+  {
+    batcher->samplesDropped++;
+    return;
+  }
+  if (batcher->samples == 0u)
+  {
+    batcher->firstSampleNs = timestampNs;
+  }
+
+  batcher->sampleNs[batcher->writer.count - 1u] = timestampNs;
+  batcher->lastSampleNs = timestampNs;
+  batcher->samples++;
+
+  if (batcher->writer.count >= batcher->maxSamples)
+  {
+    batcherFlush(batcher, timestampNs);
+  }
+}
+
+void batcherPoll(Batcher *batcher, uint64_t nowNs)
+{
+  if ((batcher->writer.count > 0u) &&
+      ((nowNs - batcher->sampleNs[0]) >= batcher->maxAgeNs))
+  {
+    batcherFlush(batcher, nowNs);
+  }
+}
+
+void batcherFlush(Batcher *batcher, uint64_t nowNs)
+{
+  uint32_t index;
+  int length;
+
+  if (batcher->writer.count == 0u)
+  {
+    return;
+  }
+
+  for (index = 0u; index < batcher->writer.count; index++)
+  {
+    histogramRecord(&batcher->addedLatency, nowNs - batcher->sampleNs[index]);
+  }
+
+  length = payloadBatchEnd(&batcher->writer);
+  if (publisherPostMessage(batcher->publisher, batcher->topic, batcher->frame,
+                           length) != 0)
+  {
+    batcher->framesDropped++;
+  }
+  batcher->frames++;
+  batcher->sequence++;
+  batcher->writer.count = 0u;
+}
+
+int batcherFormatStats(const Batcher *batcher, char *buffer, size_t size)
+{
+  char latency[160];
+  double seconds = (double)(batcher->lastSampleNs - batcher->firstSampleNs) /
+                   1e9;
+
+  histogramFormat(&batcher->addedLatency, "addedlatency", latency,
+                  sizeof(latency));
+
+  return snprintf(buffer, size,
+                  "batcher: samples=%llu sampledrops=%llu frames=%llu "
+                  "dropped=%llu savedmsgs/s=%.1f\n%s",
+                  (unsigned long long)batcher->samples,
+                  (unsigned long long)batcher->samplesDropped,
+                  (unsigned long long)batcher->frames,
+                  (unsigned long long)batcher->framesDropped,
+                  (seconds > 0.0) ?
+                  ((double)(batcher->samples - batcher->frames) / seconds) :
+                  0.0,
+                  latency);
+}
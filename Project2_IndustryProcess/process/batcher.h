@@ -0,0 +1,63 @@
+/*******************************************************************************
+* Authors:
+*    Uros Cvjetinovic & Uros Popovic
+* @file
+* \brief Packs pressure samples into batch frames (see payload.h) before they
+*   are handed to the publisher. Samples of one instance over several ticks
+*   and samples of many instances within a tick end up in the same frame. A
+*   frame is flushed when it holds the configured number of samples or when
+*   its oldest sample reaches the maximum age. The delay a sample spends
+*   waiting for its frame is recorded, as is the number of messages saved.
+*   A sample the open frame cannot encode, e.g. a step back in time, starts
+*   a new frame; one no frame can hold is counted as dropped.
+*******************************************************************************/
+#ifndef BATCHER_H
+#define BATCHER_H
+
+/******* include headers ******************************************************/
+#include <stddef.h>
+#include <stdint.h>
+#include "histogram.h"
+#include "payload.h"
+#include "publisher.h"
+
+/******* global macros ********************************************************/
+#define BATCHER_MAXSAMPLES      ((PUBLISHER_PAYLOADSIZE -                     \
+                                  PAYLOAD_BATCHHEADERSIZE) /                  \
+                                 PAYLOAD_BATCHENTRYSIZE)
+
+/******* type definitions *****************************************************/
+typedef struct
+{
+  Publisher *publisher;
+  const char *topic;
+  uint32_t flags;
+  uint32_t maxSamples;
+  uint64_t maxAgeNs;
+  PayloadBatchWriter writer;
+  uint8_t frame[PUBLISHER_PAYLOADSIZE];
+  uint64_t sampleNs[BATCHER_MAXSAMPLES];
+  uint64_t firstSampleNs;
+  uint64_t lastSampleNs;
+  uint32_t sequence;
+  uint64_t samples;
+  uint64_t samplesDropped;      /* not encodable in any frame */
+  uint64_t frames;
+  uint64_t framesDropped;
+  Histogram addedLatency;
+} Batcher;
+
+/******* declaration of global functions **************************************/
+int batcherInit(Batcher *batcher, Publisher *publisher, const char *topic,
+                uint32_t flags, uint32_t maxSamples, uint64_t maxAgeNs);
+
+void batcherAdd(Batcher *batcher, uint32_t instance, float value,
+                uint64_t timestampNs);
+
+void batcherPoll(Batcher *batcher, uint64_t nowNs);
+
+void batcherFlush(Batcher *batcher, uint64_t nowNs);
+
+int batcherFormatStats(const Batcher *batcher, char *buffer, size_t size);
+
+#endif /* BATCHER_H */
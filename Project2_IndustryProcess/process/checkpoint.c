@@ -0,0 +1,295 @@
+/*******************************************************************************
+* Authors:
+*    Uros Cvjetinovic & Uros Popovic
+* @file
+* \brief Checkpoint of the simulated process state, see checkpoint.h.
+*   File layout: a header describing the plant the checkpoint belongs to,
+*   followed by two slots. A slot starts with CheckpointSlot and continues
+*   with whole rows of stride values: input, previous input, output, sample
+*   numbers, the model state rows and the dead time rows.
+*******************************************************************************/
+
+/******* include headers ******************************************************/
+#include <stdio.h>
+#include <string.h>
+#include "checkpoint.h"
+#include "timebase.h"
+
+/******* local macros *********************************************************/
+#define CHECKPOINT_MAGIC        ((uint32_t) 0x54504B43u)  /* "CKPT" */
+#define CHECKPOINT_VERSION      ((uint32_t) 1u)
+#define CHECKPOINT_HEADERSIZE   ((size_t) 128u)
+#define CHECKPOINT_SLOTS        ((uint32_t) 2u)
+#define CHECKPOINT_FIXEDROWS    ((uint32_t) 4u)
+#define FNV_OFFSET              ((uint32_t) 2166136261u)
+#define FNV_PRIME               ((uint32_t) 16777619u)
+
+/******* type definitions *****************************************************/
+typedef struct
+{
+  uint32_t magic;
+  uint32_t version;
+  uint32_t count;
+  uint32_t stride;
+  uint32_t order;
+  uint32_t delay;
+  uint32_t slotSize;
+  uint32_t reserved;
+  float b[LTI_MAXORDER + 1u];
+  float a[LTI_MAXORDER + 1u];
+} CheckpointHeader;
+
+typedef struct
+{
+  uint64_t generation;    /* 0 while the slot is empty or being written */
+  uint64_t tickIndex;
+  uint32_t delayIndex;
+  uint32_t batchSequence;
+  uint32_t checksum;      /* over the whole slot with this field zero */
+  uint32_t reserved;
+} CheckpointSlot;
+
+_Static_assert(sizeof(CheckpointHeader) <= CHECKPOINT_HEADERSIZE,
+               "checkpoint header does not fit its area");
+
+/******* declaration of local functions ***************************************/
+static void fillHeader(CheckpointHeader *header, const PlantEngine *plant,
+                       size_t slotSize);
+
+static uint8_t *slotData(const Checkpoint *checkpoint, uint32_t slot);
+
+static uint32_t slotChecksum(const Checkpoint *checkpoint, const uint8_t *data);
+
+/******* definition of local functions ****************************************/
+static void fillHeader(CheckpointHeader *header, const PlantEngine *plant,
+                       size_t slotSize)
+{
+  memset(header, 0, sizeof(*header));
+  header->magic = CHECKPOINT_MAGIC;
+  header->version = CHECKPOINT_VERSION;
+  header->count = plant->count;
+  header->stride = plant->stride;
+  header->order = plant->order;
+  header->delay = plant->delay;
+  header->slotSize = (uint32_t)slotSize;
+  memcpy(header->b, plant->b, sizeof(header->b));
+  memcpy(header->a, plant->a, sizeof(header->a));
+}
+
+static uint8_t *slotData(const Checkpoint *checkpoint, uint32_t slot)
+{
+  return (uint8_t *)checkpoint->file.data + CHECKPOINT_HEADERSIZE +
+         ((size_t)slot * checkpoint->slotSize);
+}
+
+/* FNV-1a over 32-bit words, the slot size is a whole number of words */
+static uint32_t slotChecksum(const Checkpoint *checkpoint, const uint8_t *data)
+{
+  const CheckpointSlot *slot = (const CheckpointSlot *)data;
+  uint32_t hash = FNV_OFFSET;
+  uint32_t word;
+  size_t offset;
+
+  for (offset = 0u; offset < checkpoint->slotSize; offset += sizeof(word))
+  {
+    memcpy(&word, data + offset, sizeof(word));
+    if ((data + offset) == (const uint8_t *)&slot->checksum)
+    {
+      word = 0u;
+    }
+    hash = (hash ^ word) * FNV_PRIME;
+  }
+
+  return hash;
+}
+
+/******* definition of global functions ***************************************/
+int checkpointOpen(Checkpoint *checkpoint, const char *path,
+                   const PlantEngine *plant)
+{
+  CheckpointHeader header;
+  size_t fileSize;
+  uint32_t slot;
+
+  memset(checkpoint, 0, sizeof(*checkpoint));
+  checkpoint->rows = CHECKPOINT_FIXEDROWS + plant->order + plant->delay;
+  checkpoint->rowSize = (size_t)plant->stride * sizeof(float);
+  checkpoint->slotSize = sizeof(CheckpointSlot) +
+                         ((size_t)checkpoint->rows * checkpoint->rowSize);
+  if (checkpoint->slotSize > UINT32_MAX)
+  {
+    return -1;
+  }
+  fileSize = CHECKPOINT_HEADERSIZE + (CHECKPOINT_SLOTS * checkpoint->slotSize);
+
+  if (mappedFileOpen(&checkpoint->file, path, fileSize) != 0)
+  {
+    return -1;
+  }
+
+  fillHeader(&header, plant, checkpoint->slotSize);
+  if ((checkpoint->file.previousSize == fileSize) &&
+      (memcmp(checkpoint->file.data, &header, sizeof(header)) == 0))
+  {
+    checkpoint->restorable = 1;
+    return 0;
+  }
+
+  /* A new file or one of another plant: start with both slots empty */
+  memset(checkpoint->file.data, 0, CHECKPOINT_HEADERSIZE);
+  memcpy(checkpoint->file.data, &header, sizeof(header));
+  for (slot = 0u; slot < CHECKPOINT_SLOTS; slot++)
+  {
+    memset(slotData(checkpoint, slot), 0, sizeof(CheckpointSlot));
+  }
+
+  return 0;
+}
+
+int checkpointRestore(Checkpoint *checkpoint, PlantEngine *plant,
+                      Publisher *publisher, CheckpointCounters *counters)
+{
+  const CheckpointSlot *latest = NULL;
+  const CheckpointSlot *candidate;
+  const uint8_t *rows;
+  uint32_t slot;
+  uint32_t latestSlot = 0u;
+  uint32_t instance;
+  uint32_t sampleNumber;
+  size_t rowSize = checkpoint->rowSize;
+
+  if (!checkpoint->restorable)
+  {
+    return -1;
+  }
+
+  for (slot = 0u; slot < CHECKPOINT_SLOTS; slot++)
+  {
+    candidate = (const CheckpointSlot *)slotData(checkpoint, slot);
+    if ((candidate->generation != 0u) &&
+        ((latest == NULL) || (candidate->generation > latest->generation)) &&
+        (candidate->checksum == slotChecksum(checkpoint, (const uint8_t *)candidate)))
+    {
+      latest = candidate;
+      latestSlot = slot;
+    }
+  }
+  if (latest == NULL)
+  {
+    return -1;
+  }
+
+  rows = (const uint8_t *)latest + sizeof(CheckpointSlot);
+  memcpy(plant->input, rows, rowSize);
+  memcpy(plant->previousInput, rows + rowSize, rowSize);
+  memcpy(plant->output, rows + (2u * rowSize), rowSize);
+  for (instance = 0u; instance < plant->count; instance++)
+  {
+    memcpy(&sampleNumber,
+           rows + (3u * rowSize) + (instance * sizeof(sampleNumber)),
+           sizeof(sampleNumber));
+    publisherSetSampleNumber(publisher, instance, sampleNumber);
+  }
+  memcpy(plant->state, rows + (CHECKPOINT_FIXEDROWS * rowSize),
+         plant->order * rowSize);
+  if (plant->delay > 0u)
+  {
+    memcpy(plant->delayLine,
+           rows + ((CHECKPOINT_FIXEDROWS + plant->order) * rowSize),
+           plant->delay * rowSize);
+  }
+  plant->delayIndex = latest->delayIndex;
+
+  counters->tickIndex = latest->tickIndex;
+  counters->batchSequence = latest->batchSequence;
+
+  /* The next save must not overwrite the slot just restored */
+  checkpoint->generation = latest->generation;
+  checkpoint->nextSlot = (latestSlot + 1u) % CHECKPOINT_SLOTS;
+
+  return 0;
+}
+
+int checkpointSave(Checkpoint *checkpoint, const PlantEngine *plant,
+                   const Publisher *publisher,
+                   const CheckpointCounters *counters)
+{
+  uint64_t startNs = timebaseNowNs();
+  uint8_t *data = slotData(checkpoint, checkpoint->nextSlot);
+  CheckpointSlot *slot = (CheckpointSlot *)data;
+  uint8_t *rows = data + sizeof(CheckpointSlot);
+  size_t rowSize = checkpoint->rowSize;
+  uint32_t instance;
+  uint32_t sampleNumber;
+
+  slot->generation = 0u;
+  slot->tickIndex = counters->tickIndex;
+  slot->delayIndex = plant->delayIndex;
+  slot->batchSequence = counters->batchSequence;
+  slot->reserved = 0u;
+
+  memcpy(rows, plant->input, rowSize);
+  memcpy(rows + rowSize, plant->previousInput, rowSize);
+  memcpy(rows + (2u * rowSize), plant->output, rowSize);
+  memset(rows + (3u * rowSize), 0, rowSize);
+  for (instance = 0u; instance < plant->count; instance++)
+  {
+    sampleNumber = publisherGetSampleNumber(publisher, instance);
+    memcpy(rows + (3u * rowSize) + (instance * sizeof(sampleNumber)),
+           &sampleNumber, sizeof(sampleNumber));
+  }
+  memcpy(rows + (CHECKPOINT_FIXEDROWS * rowSize), plant->state,
+         plant->order * rowSize);
+  if (plant->delay > 0u)
+  {
+    memcpy(rows + ((CHECKPOINT_FIXEDROWS + plant->order) * rowSize),
+           plant->delayLine, plant->delay * rowSize);
+  }
+
+  /* The generation is stored last, it is part of the checksum so a slot
+     caught half written by a crash of the machine is rejected */
+  slot->generation = checkpoint->generation + 1u;
+  slot->checksum = slotChecksum(checkpoint, data);
+  checkpoint->generation++;
+  checkpoint->nextSlot = (checkpoint->nextSlot + 1u) % CHECKPOINT_SLOTS;
+
+  /* The pages are written back in the background, a crash of the program
+     alone cannot lose them any more */
+  if (mappedFileFlush(&checkpoint->file, 0) != 0)
+  {
+    return -1;
+  }
+
+  checkpoint->saves++;
+  checkpoint->lastSaveNs = timebaseNowNs() - startNs;
+  if (checkpoint->lastSaveNs > checkpoint->maxSaveNs)
+  {
+    checkpoint->maxSaveNs = checkpoint->lastSaveNs;
+  }
+
+  return 0;
+}
+
+int checkpointFormatStats(const Checkpoint *checkpoint, char *buffer,
+                          size_t size)
+{
+  return snprintf(buffer, size,
+                  "checkpoint: saves=%llu generation=%llu size=%lluB "
+                  "last=%.1fus max=%.1fus",
+                  (unsigned long long)checkpoint->saves,
+                  (unsigned long long)checkpoint->generation,
+                  (unsigned long long)checkpoint->slotSize,
+                  checkpoint->lastSaveNs / 1000.0,
+                  checkpoint->maxSaveNs / 1000.0);
+}
+
+void checkpointClose(Checkpoint *checkpoint)
+{
+  if (checkpoint->file.data == NULL)
+  {
+    return;
+  }
+
+  mappedFileFlush(&checkpoint->file, 1);
+  mappedFileClose(&checkpoint->file);
+}
@@ -0,0 +1,64 @@
+/*******************************************************************************
+* Authors:
+*    Uros Cvjetinovic & Uros Popovic
+* @file
+* \brief Checkpoint of the simulated process state in a memory-mapped file, so
+*   a restarted process continues where the previous one stopped instead of
+*   starting again from the initial pressure. A checkpoint holds everything
+*   the next tick depends on: plant input, previous input, output and model
+*   state of every instance, the dead time ring with its position, the
+*   sample sequence numbers and the tick index.
+*   The file keeps two slots written alternately. A slot is invalidated
+*   before it is overwritten and carries a checksum, so the other slot is
+*   still there if the program or the machine stops in the middle of a save.
+*   A checkpoint is only restored into a process with the same number of
+*   instances, model and dead time, otherwise the process starts afresh.
+*******************************************************************************/
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+/******* include headers ******************************************************/
+#include <stddef.h>
+#include <stdint.h>
+#include "mappedfile.h"
+#include "plant.h"
+#include "publisher.h"
+
+/******* type definitions *****************************************************/
+typedef struct
+{
+  uint64_t tickIndex;
+  uint32_t batchSequence;
+} CheckpointCounters;
+
+typedef struct
+{
+  MappedFile file;
+  size_t rowSize;
+  size_t slotSize;
+  uint32_t rows;
+  uint32_t nextSlot;
+  uint64_t generation;
+  int restorable;
+  uint64_t saves;
+  uint64_t lastSaveNs;
+  uint64_t maxSaveNs;
+} Checkpoint;
+
+/******* declaration of global functions **************************************/
+int checkpointOpen(Checkpoint *checkpoint, const char *path,
+                   const PlantEngine *plant);
+
+int checkpointRestore(Checkpoint *checkpoint, PlantEngine *plant,
+                      Publisher *publisher, CheckpointCounters *counters);
+
+int checkpointSave(Checkpoint *checkpoint, const PlantEngine *plant,
+                   const Publisher *publisher,
+                   const CheckpointCounters *counters);
+
+int checkpointFormatStats(const Checkpoint *checkpoint, char *buffer,
+                          size_t size);
+
+void checkpointClose(Checkpoint *checkpoint);
+
+#endif /* CHECKPOINT_H */
@@ -0,0 +1,81 @@
+/*******************************************************************************
+* Authors:
+*    Uros Cvjetinovic & Uros Popovic
+* @file
+* \brief Report-by-exception filter for the pressure samples, see deadband.h.
+*******************************************************************************/
+
+/******* include headers ******************************************************/
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "deadband.h"
+
+/******* definition of global functions ***************************************/
+int deadbandInit(Deadband *deadband, uint32_t count, float threshold,
+                 uint64_t maxSilenceNs)
+{
+  memset(deadband, 0, sizeof(*deadband));
+  deadband->threshold = threshold;
+  deadband->maxSilenceNs = maxSilenceNs;
+  deadband->count = count;
+  deadband->lastReported = (float *)calloc(count, sizeof(float));
+  deadband->lastReportNs = (uint64_t *)calloc(count, sizeof(uint64_t));
+  if ((deadband->lastReported == NULL) || (deadband->lastReportNs == NULL))
+  {
+    deadbandFree(deadband);
+    return -1;
+  }
+
+  return 0;
+}
+
+int deadbandShouldPublish(Deadband *deadband, uint32_t instance, float value,
+                          uint64_t nowNs)
+{
+  float change = fabsf(value - deadband->lastReported[instance]);
+
+  /* The very first sample of an instance is always published */
+  if ((deadband->lastReportNs[instance] == 0u) ||
+      (change > deadband->threshold) ||
+      ((nowNs - deadband->lastReportNs[instance]) >= deadband->maxSilenceNs))
+  {
+    deadband->lastReported[instance] = value;
+    deadband->lastReportNs[instance] = nowNs;
+    deadband->published++;
+    return 1;
+  }
+
+  deadband->suppressed++;
+  deadband->reportErrorSum += change;
+  if (change > deadband->reportErrorMax)
+  {
+    deadband->reportErrorMax = change;
+  }
+
+  return 0;
+}
+
+int deadbandFormatStats(const Deadband *deadband, char *buffer, size_t size)
+{
+  uint64_t total = deadband->published + deadband->suppressed;
+
+  return snprintf(buffer, size,
+                  "deadband: threshold=%.2f published=%llu suppressed=%llu "
+                  "saved=%.1f%% reporterror mean=%.3f max=%.3f",
+                  deadband->threshold,
+                  (unsigned long long)deadband->published,
+                  (unsigned long long)deadband->suppressed,
+                  (total > 0u) ? (100.0 * deadband->suppressed / total) : 0.0,
+                  (total > 0u) ? (deadband->reportErrorSum / total) : 0.0,
+                  deadband->reportErrorMax);
+}
+
+void deadbandFree(Deadband *deadband)
+{
+  free(deadband->lastReported);
+  free(deadband->lastReportNs);
+  deadband->lastReported = NULL;
+  deadband->lastReportNs = NULL;
+}
@@ -0,0 +1,45 @@
+/*******************************************************************************
+* Authors:
+*    Uros Cvjetinovic & Uros Popovic
+* @file
+* \brief Report-by-exception filter for the pressure samples. A sample of an
+*   instance is published only when it moved more than the threshold away
+*   from the value last published for that instance, or when nothing was
+*   published for the maximum silence interval. Besides the suppressed
+*   samples it measures the report error, the difference between the actual
+*   pressure and the last value the regulator received, which is the price
+*   paid in control error for the saved bandwidth.
+*******************************************************************************/
+#ifndef DEADBAND_H
+#define DEADBAND_H
+
+/******* include headers ******************************************************/
+#include <stddef.h>
+#include <stdint.h>
+
+/******* type definitions *****************************************************/
+typedef struct
+{
+  float threshold;
+  uint64_t maxSilenceNs;
+  uint32_t count;
+  float *lastReported;
+  uint64_t *lastReportNs;
+  uint64_t published;
+  uint64_t suppressed;
+  double reportErrorSum;
+  float reportErrorMax;
+} Deadband;
+
+/******* declaration of global functions **************************************/
+int deadbandInit(Deadband *deadband, uint32_t count, float threshold,
+                 uint64_t maxSilenceNs);
+
+int deadbandShouldPublish(Deadband *deadband, uint32_t instance, float value,
+                          uint64_t nowNs);
+
+int deadbandFormatStats(const Deadband *deadband, char *buffer, size_t size);
+
+void deadbandFree(Deadband *deadband);
+
+#endif /* DEADBAND_H */
@@ -0,0 +1,155 @@
+/*******************************************************************************
+* Authors:
+*    Uros Cvjetinovic & Uros Popovic
+* @file
+* \brief Sensor to actuator latency of every control loop, see looplatency.h.
+*******************************************************************************/
+
+/******* include headers ******************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "looplatency.h"
+#include "timebase.h"
+
+/******* definition of global functions ***************************************/
+int loopLatencyInit(LoopLatency *latency, uint32_t count, uint64_t slowNs)
+{
+  uint32_t loop;
+
+  memset(latency, 0, sizeof(*latency));
+  latency->count = count;
+  latency->slowNs = slowNs;
+  latency->lastCorrelation = (uint32_t *)calloc(count, sizeof(uint32_t));
+  latency->loops = (Histogram *)calloc(count, sizeof(Histogram));
+  if ((latency->lastCorrelation == NULL) || (latency->loops == NULL))
+  {
+    loopLatencyFree(latency);
+    return -1;
+  }
+
+  for (loop = 0u; loop < count; loop++)
+  {
+    histogramReset(&latency->loops[loop]);
+  }
+  histogramReset(&latency->all);
+
+  return 0;
+}
+
+void loopLatencyRecord(LoopLatency *latency, uint32_t loop,
+                       const PayloadSample *answer, uint64_t nowNs)
+{
+  uint64_t sentNs = answer->sentUs * TIMEBASE_NS_PER_US;
+  uint64_t elapsedNs;
+
+  latency->answers++;
+  if ((answer->flags & PAYLOAD_TRACE) == 0u)
+  {
+    latency->untraced++;
+    return;
+  }
+  /* Correlation ids only grow, 0 is never sent */
+  if ((int32_t)(answer->correlation - latency->lastCorrelation[loop]) <= 0)
+  {
+    latency->reordered++;
+  }
+  else
+  {
+    latency->lastCorrelation[loop] = answer->correlation;
+  }
+
+  elapsedNs = (nowNs > sentNs) ? (nowNs - sentNs) : 0u;
+  histogramRecord(&latency->loops[loop], elapsedNs);
+  histogramRecord(&latency->all, elapsedNs);
+  latency->slow += (elapsedNs > latency->slowNs) ? 1u : 0u;
+}
+
+int loopLatencyFormatStats(const LoopLatency *latency, char *buffer,
+                           size_t size)
+{
+  char allLine[160];
+
+  histogramFormat(&latency->all, "sensor to actuator", allLine,
+                  sizeof(allLine));
+
+  return snprintf(buffer, size,
+                  "latency: answers=%llu untraced=%llu reordered=%llu "
+                  "slow=%llu (>%.1fus) %s",
+                  (unsigned long long)latency->answers,
+                  (unsigned long long)latency->untraced,
+                  (unsigned long long)latency->reordered,
+                  (unsigned long long)latency->slow,
+                  (double)latency->slowNs / TIMEBASE_NS_PER_US, allLine);
+}
+
+/* The worst LOOPLATENCY_REPORTED loops by 99th percentile above the slow
+   threshold, one pass with a small insertion sorted list */
+int loopLatencyFormatSlowLoops(const LoopLatency *latency, char *buffer,
+                               size_t size)
+{
+  uint32_t worst[LOOPLATENCY_REPORTED];
+  uint64_t worstNs[LOOPLATENCY_REPORTED];
+  uint32_t reported = 0u;
+  uint32_t slowLoops = 0u;
+  uint32_t loop;
+  uint32_t index;
+  uint64_t p99Ns;
+  const Histogram *histogram;
+  int length;
+  int total;
+
+  for (loop = 0u; loop < latency->count; loop++)
+  {
+    p99Ns = histogramPercentileNs(&latency->loops[loop], 99.0);
+    if ((latency->loops[loop].count == 0u) || (p99Ns <= latency->slowNs))
+    {
+      continue;
+    }
+    slowLoops++;
+
+    index = (reported < LOOPLATENCY_REPORTED) ? reported++ :
+                                                LOOPLATENCY_REPORTED;
+    while ((index > 0u) && (worstNs[index - 1u] < p99Ns))
+    {
+      if (index < LOOPLATENCY_REPORTED)
+      {
+        worst[index] = worst[index - 1u];
+        worstNs[index] = worstNs[index - 1u];
+      }
+      index--;
+    }
+    if (index < LOOPLATENCY_REPORTED)
+    {
+      worst[index] = loop;
+      worstNs[index] = p99Ns;
+    }
+  }
+
+  total = snprintf(buffer, size, "slow loops: %u of %u", slowLoops,
+                   latency->count);
+  for (index = 0u; (index < reported) && (total >= 0) &&
+                   ((size_t)total < size); index++)
+  {
+    histogram = &latency->loops[worst[index]];
+    length = snprintf(buffer + total, size - total,
+                      "%s %u p50=%.1fus p99=%.1fus max=%.1fus n=%llu",
+                      (index == 0u) ? ":" : ",", worst[index],
+                      (double)histogramPercentileNs(histogram, 50.0) /
+                      TIMEBASE_NS_PER_US,
+                      (double)worstNs[index] / TIMEBASE_NS_PER_US,
+                      (double)histogram->maxNs / TIMEBASE_NS_PER_US,
+                      (unsigned long long)histogram->count);
+    total = (length < 0) ? length : (total + length);
+  }
+
+  return total;
+}
+
+void loopLatencyFree(LoopLatency *latency)
+{
+  free(latency->lastCorrelation);
+  free(latency->loops);
+  latency->lastCorrelation = NULL;
+  latency->loops = NULL;
+}
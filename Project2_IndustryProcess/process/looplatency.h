@@ -0,0 +1,57 @@
+/*******************************************************************************
+* Authors:
+*    Uros Cvjetinovic & Uros Popovic
+* @file
+* \brief Sensor to actuator latency of every control loop. A traced pressure
+*   sample carries a correlation id and the time it was handed to the client
+*   (payload.h), the regulator echoes both in its correction, so the process
+*   measures the whole round trip through the broker and the regulator on its
+*   own clock when the correction arrives. Every loop keeps a histogram; the
+*   slow loop report lists the loops whose 99th percentile exceeds the slow
+*   threshold, worst first. Answers that take longer than a sampling period
+*   reach the plant a tick late, which is where the broker starts to hurt
+*   regulation.
+*   Only the MQTT client thread records; the statistics may be read from
+*   another thread and are then approximate.
+*******************************************************************************/
+#ifndef LOOPLATENCY_H
+#define LOOPLATENCY_H
+
+/******* include headers ******************************************************/
+#include <stddef.h>
+#include <stdint.h>
+#include "histogram.h"
+#include "payload.h"
+
+/******* global macros ********************************************************/
+#define LOOPLATENCY_REPORTED    ((uint32_t) 5u)
+
+/******* type definitions *****************************************************/
+typedef struct
+{
+  uint32_t count;
+  uint64_t slowNs;
+  uint32_t *lastCorrelation;    /* per loop, newest answered sample */
+  Histogram *loops;
+  Histogram all;
+  uint64_t answers;
+  uint64_t untraced;            /* answers without trace fields */
+  uint64_t reordered;           /* answers older than one already seen */
+  uint64_t slow;                /* answers slower than slowNs */
+} LoopLatency;
+
+/******* declaration of global functions **************************************/
+int loopLatencyInit(LoopLatency *latency, uint32_t count, uint64_t slowNs);
+
+void loopLatencyRecord(LoopLatency *latency, uint32_t loop,
+                       const PayloadSample *answer, uint64_t nowNs);
+
+int loopLatencyFormatStats(const LoopLatency *latency, char *buffer,
+                           size_t size);
+
+int loopLatencyFormatSlowLoops(const LoopLatency *latency, char *buffer,
+                               size_t size);
+
+void loopLatencyFree(LoopLatency *latency);
+
+#endif /* LOOPLATENCY_H */
@@ -0,0 +1,114 @@
+/*******************************************************************************
+* Authors:
+*    Uros Cvjetinovic & Uros Popovic
+* @file
+* \brief Discrete-time linear time-invariant plant models, see lti.h.
+*******************************************************************************/
+
+/******* include headers ******************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include "lti.h"
+
+/******* declaration of local functions ***************************************/
+static int parseCoefficients(const char *text, double *coefficients,
+                             uint32_t capacity, const char **end);
+
+/******* definition of local functions ****************************************/
+static int parseCoefficients(const char *text, double *coefficients,
+                             uint32_t capacity, const char **end)
+{
+  char *next;
+  uint32_t count = 0u;
+
+  while (count < capacity)
+  {
+    coefficients[count] = strtod(text, &next);
+    if (next == text)
+    {
+      return -1;
+    }
+    count++;
+    text = next;
+    if (*text != ',')
+    {
+      break;
+    }
+    text++;
+  }
+
+  *end = text;
+  return (int)count;
+}
+
+/******* definition of global functions ***************************************/
+int ltiParse(const char *text, LtiModel *model)
+{
+  int numeratorCount;
+  int denominatorCount = 0;
+  const char *end;
+
+  /* "b0,b1,...,bn:a1,...,an", a0 is implied */
+  memset(model, 0, sizeof(*model));
+  model->a[0] = 1.0;
+
+  numeratorCount = parseCoefficients(text, model->b, LTI_MAXORDER + 1u, &end);
+  if (numeratorCount <= 0)
+  {
+    return -1;
+  }
+  if (*end == ':')
+  {
+    denominatorCount = parseCoefficients(end + 1, &model->a[1], LTI_MAXORDER,
+                                         &end);
+    if (denominatorCount <= 0)
+    {
+      return -1;
+    }
+  }
+  if (*end != '\0')
+  {
+    return -1;
+  }
+
+  model->order = ((uint32_t)(numeratorCount - 1) > (uint32_t)denominatorCount) ?
+                 (uint32_t)(numeratorCount - 1) : (uint32_t)denominatorCount;
+
+  return (model->order > 0u) ? 0 : -1;
+}
+
+float ltiStep(uint32_t order, const float *b, const float *a, float *state,
+              uint32_t stride, float x)
+{
+  uint32_t index;
+  float y = (b[0] * x) + state[0];
+
+  for (index = 1u; index < order; index++)
+  {
+    state[(index - 1u) * stride] = ((b[index] * x) - (a[index] * y)) +
+                                   state[index * stride];
+  }
+  state[(order - 1u) * stride] = (b[order] * x) - (a[order] * y);
+
+  return y;
+}
+
+void ltiSteadyState(uint32_t order, const float *a, float y, float *state,
+                    uint32_t stride)
+{
+  uint32_t index;
+  float sum = 0.0f;
+
+  /* State left behind by an output held at y with the input at 0:
+     state[k] = -y * (a[k + 1] + ... + a[order]) */
+  for (index = order; index > 0u; index--)
+  {
+    sum += a[index];
+    state[(index - 1u) * stride] = -y * sum;
+  }
+}
+
+int ltiIsSymmetricFirstOrder(const LtiModel *model)
+{
+  return (model->order == 1u) && (model->b[0] == model->b[1]);
+}
@@ -0,0 +1,101 @@
+/*******************************************************************************
+* Authors:
+*    Uros Cvjetinovic & Uros Popovic
+* @file
+* \brief Discrete-time linear time-invariant plant models.
+*   A model is the transfer function
+*     H(z) = (b0 + b1 z^-1 + ... + bn z^-n) / (1 + a1 z^-1 + ... + an z^-n)
+*   evaluated in transposed direct form II. The LTI_*_INIT macros derive the
+*   coefficients of common continuous plants with the bilinear (Tustin)
+*   transform s = (2 / Ts) * (z - 1) / (z + 1). They are constant expressions,
+*   so a model built from constants is computed by the compiler, e.g.
+*     static const LtiModel model = LTI_FIRST_ORDER_INIT(1.0, 10.0, 1.0);
+*   gives b0 = b1 = 1/21 and a1 = -19/21, the process of the assignment.
+*   Fixed order steps are inline and unrolled, ltiStep handles any order up
+*   to LTI_MAXORDER at run time. The state of a model is addressed with a
+*   stride, state[k * stride], so the state of many models can be kept in
+*   structure-of-arrays layout.
+*******************************************************************************/
+#ifndef LTI_H
+#define LTI_H
+
+/******* include headers ******************************************************/
+#include <stdint.h>
+
+/******* global macros ********************************************************/
+#define LTI_MAXORDER            ((uint32_t) 8u)
+
+/* K / (tau s + 1) */
+#define LTI_FIRST_ORDER_B0(K, TAU, TS)   ((K) * (TS) / ((TS) + 2.0 * (TAU)))
+#define LTI_FIRST_ORDER_A1(TAU, TS)      (((TS) - 2.0 * (TAU)) / \
+                                          ((TS) + 2.0 * (TAU)))
+
+#define LTI_FIRST_ORDER_INIT(K, TAU, TS)                                      \
+  { 1u,                                                                       \
+    { LTI_FIRST_ORDER_B0(K, TAU, TS), LTI_FIRST_ORDER_B0(K, TAU, TS) },       \
+    { 1.0, LTI_FIRST_ORDER_A1(TAU, TS) } }
+
+/* K wn^2 / (s^2 + 2 zeta wn s + wn^2), with c = 2 / Ts */
+#define LTI_C(TS)                        (2.0 / (TS))
+#define LTI_SECOND_ORDER_D(WN, ZETA, TS)                                      \
+  ((LTI_C(TS) * LTI_C(TS)) + (2.0 * (ZETA) * (WN) * LTI_C(TS)) +              \
+   ((WN) * (WN)))
+#define LTI_SECOND_ORDER_B0(K, WN, ZETA, TS)                                  \
+  ((K) * (WN) * (WN) / LTI_SECOND_ORDER_D(WN, ZETA, TS))
+#define LTI_SECOND_ORDER_A1(WN, ZETA, TS)                                     \
+  ((2.0 * ((WN) * (WN) - LTI_C(TS) * LTI_C(TS))) /                            \
+   LTI_SECOND_ORDER_D(WN, ZETA, TS))
+#define LTI_SECOND_ORDER_A2(WN, ZETA, TS)                                     \
+  (((LTI_C(TS) * LTI_C(TS)) - (2.0 * (ZETA) * (WN) * LTI_C(TS)) +             \
+    ((WN) * (WN))) / LTI_SECOND_ORDER_D(WN, ZETA, TS))
+
+#define LTI_SECOND_ORDER_INIT(K, WN, ZETA, TS)                                \
+  { 2u,                                                                       \
+    { LTI_SECOND_ORDER_B0(K, WN, ZETA, TS),                                   \
+      2.0 * LTI_SECOND_ORDER_B0(K, WN, ZETA, TS),                             \
+      LTI_SECOND_ORDER_B0(K, WN, ZETA, TS) },                                 \
+    { 1.0, LTI_SECOND_ORDER_A1(WN, ZETA, TS),                                 \
+      LTI_SECOND_ORDER_A2(WN, ZETA, TS) } }
+
+/******* type definitions *****************************************************/
+typedef struct
+{
+  uint32_t order;
+  double b[LTI_MAXORDER + 1u];
+  double a[LTI_MAXORDER + 1u];  /* a[0] is always 1 */
+} LtiModel;
+
+/******* definition of inline functions ***************************************/
+static inline float ltiStepOrder1(const float *b, const float *a,
+                                  float *state0, float x)
+{
+  float y = (b[0] * x) + *state0;
+
+  *state0 = (b[1] * x) - (a[1] * y);
+
+  return y;
+}
+
+static inline float ltiStepOrder2(const float *b, const float *a,
+                                  float *state0, float *state1, float x)
+{
+  float y = (b[0] * x) + *state0;
+
+  *state0 = ((b[1] * x) - (a[1] * y)) + *state1;
+  *state1 = (b[2] * x) - (a[2] * y);
+
+  return y;
+}
+
+/******* declaration of global functions **************************************/
+int ltiParse(const char *text, LtiModel *model);
+
+float ltiStep(uint32_t order, const float *b, const float *a, float *state,
+              uint32_t stride, float x);
+
+void ltiSteadyState(uint32_t order, const float *a, float y, float *state,
+                    uint32_t stride);
+
+int ltiIsSymmetricFirstOrder(const LtiModel *model);
+
+#endif /* LTI_H */
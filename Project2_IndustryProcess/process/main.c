@@ -7,113 +7,656 @@
 *  describing the process is:
 *  y_n = ((1.0/21.0) * (x_n + x_n-1)) + (19.0/21.0) * y_n-1
 *  where y represents pressure, and x 
+*  These coefficients are derived by the compiler from the gain, the time
+*  constant and the sampling period (see lti.h). Gain and time constant can be
+*  changed with "-K" and "-T", any discrete model can be given with
+*  "-L b0,b1,...:a1,a2,...". "-W" with "-Z" selects a second order process
+*  with the given natural frequency and damping instead, and "-D" adds a dead
+*  time in front of any of them (first order plus dead time with "-D" alone).
+*  Any number of process instances can be simulated at once ("process -n 1000"),
+*  instance i then publishes to CurrentPressure/i and listens to
+*  HysteresisCorrection/i. A single instance keeps the plain topic names.
+*  The sampling period is kept by a drift-free periodic scheduler and can be
+*  changed from the command line, e.g. "process -p 1" samples every 1 ms.
+*  With "-v" the process runs in virtual time: ticks follow each other as fast
+*  as possible and the samples carry the simulated time. Adding "-w" makes
+*  every tick wait for the regulator to answer the previous samples, so a
+*  closed loop experiment runs faster than real time and deterministically.
+*  Answers carrying the timestamp of another tick arrived too late, they are
+*  dropped and counted.
+*  "-b" switches the pressure samples to the compact binary payload of
+*  payload.h, text stays the default for the IoT MQTT Panel app.
+*  "-e" enables report by exception: a sample is published only when it moved
+*  more than the given deadband or after "-m" seconds of silence.
+*  "-k" packs that many samples into one binary frame on CurrentPressureBatch,
+*  a frame that is not full is sent once its oldest sample is "-a" ms old.
+*  Hysteresis corrections arrive on the MQTT client thread and are handed to
+*  the tick through lock-free latest-value cells (actuator.h), the tick
+*  applies the newest correction of every instance at its start.
+*  "-c file" checkpoints the process state every "-C" seconds of simulated
+*  time and on exit to a memory-mapped file and resumes from it on the next
+*  start, so a restarted process continues without a transient.
+*  "-r file" records every tick, received set pressure and applied hysteresis
+*  correction together with the resulting pressures, "process -R file"
+*  replays such a recording offline at full speed through the same tick code
+*  and the regulator's control law and checks that every pressure matches
+*  bit for bit and every correction is the one the regulator would choose.
+*  "-g law" names the law the regulator runs for all loops, e.g.
+*  -g "pid kp=4", the recording keeps it (default hysteresis).
+*  Replay assumes every sample reaches the regulator and a set pressure
+*  reaches it after it answered the previous tick.
+*  "-A 1,10,60" publishes minimum, maximum, mean and last pressure of every
+*  loop and of every group of "-G" loops over windows of 1 s, 10 s and 1 min
+*  on CurrentPressureSummary (aggregator.h), for dashboards of many loops.
+*  "-l <ms>" traces every pressure sample: the regulator echoes its
+*  correlation id and send time, so the sensor to actuator latency of every
+*  loop is measured (looplatency.h), and loops slower than that many ms, the
+*  sampling period with 0, are reported with the statistics. Samples packed
+*  into batch frames are not traced.
 *******************************************************************************/
  
 /******* include headers ******************************************************/
-#include <windows.h>
+#include <errno.h>
+#include <semaphore.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include "MQTTClient.h"
+#include "actuator.h"
+#include "aggregator.h"
+#include "batcher.h"
+#include "checkpoint.h"
+#include "controllaw.h"
+#include "deadband.h"
+#include "looplatency.h"
+#include "lti.h"
+#include "payload.h"
+#include "plant.h"
+#include "publisher.h"
+#include "recorder.h"
+#include "scheduler.h"
+#include "tickstats.h"
+#include "timebase.h"
+#include "topicrouter.h"
 
 #include <unistd.h>
 #include <signal.h>
 #include <sys/time.h>
+#include <time.h>
 
 /******* local macros *********************************************************/
 #define ADDRESS         "broker.hivemq.com:1883"
 #define CLIENTID        "IndustryProcess"
 #define TOPIC_Y         "CurrentPressure"
 #define TOPIC_X	        "HysteresisCorrection"
+#define TOPIC_YZ        "SetPressure"
+#define TOPIC_STATS     "ProcessStats"
+#define TOPIC_Y_BATCH   "CurrentPressureBatch"
+#define TOPIC_Y_SUMMARY "CurrentPressureSummary"
+#define TOPIC_INSTANCE  "%s/%u"
+#define TOPIC_X_ALL     TOPIC_X "/+"
+#define TOPIC_YZ_ALL    TOPIC_YZ "/+"
+#define ROUTE_X         ((uint32_t) 0u)
+#define ROUTE_YZ        ((uint32_t) 1u)
 #define QOS             0
 #define TIMEOUT         10000L
 #define TIMERPERIOD     1000L
-#define PAYLOADSIZE     ((uint32_t) 50u)
+#define DURATION        0L
+#define MINTIMERPERIOD  1L
+#define STATSPERIOD     10L
+#define STATSSIZE       PUBLISHER_PAYLOADSIZE
+#define TOPICSIZE       PUBLISHER_TOPICSIZE
+#define RESPONSETIMEOUT 1000L
+#define MAXSILENCE      10L
+#define BATCHAGE        1000L
+#define CHECKPOINTPERIOD 1L
+#define INSTANCES       1L
+#define PROCESSGAIN     1.0
+#define TIMECONSTANT    10.0
+#define DAMPING         0.7
+#define DEADTIME        0.0
+#define INITIALPRESSURE 100.0f
 #define DEBUGLOG        0
 
 /******* local data objects ***************************************************/
 MQTTClient client;
 
 uint32_t connectionLost = 0;
-float hysteresis_correction[2u] = {0};
-float pressure[2u] = {0};
+volatile sig_atomic_t running = 1;
+PlantEngine plant;
+ActuatorInputs actuator;
+const LtiModel defaultModel = LTI_FIRST_ORDER_INIT(PROCESSGAIN, TIMECONSTANT,
+                                                   TIMERPERIOD / 1000.0);
+TickStats tickStats;
+Publisher publisher;
+Deadband deadband;
+uint32_t deadbandEnabled = 0;
+Batcher batcher;
+uint32_t batchSamples = 0;
+Checkpoint checkpoint;
+Aggregator aggregator;
+TopicRouter topicRouter;
+uint32_t aggregating = 0;
+LoopLatency loopLatency;
+uint32_t tracing = 0;
+Recorder recorder;
+uint32_t recording = 0;
+ActuatorInputs setpoints;
+float *setpointValues = NULL;
+uint32_t *changedInstances = NULL;
+
+uint32_t lockstep = 0;
+atomic_ullong expectedTimestampUs;
+atomic_uint responses;
+atomic_uint expectedResponses;
+sem_t responsesReady;
+uint64_t responseTimeouts = 0;
+atomic_ullong staleCorrections;
 
 /******* declaration of local functions ***************************************/
-void updatePressureValue(float pressureValue);
+void updatePressureValue(uint32_t instance, float pressureValue,
+                         uint64_t timestampNs);
+
+void waitForResponses(void);
+
+void appendStatsLine(char *payload, size_t size, const char *line);
+
+void publishTickStats(void);
+
+int initTopicRouter(void);
 
 int messageArrivedHandler(void *context, char *topicName, int topicLen,
                           MQTTClient_message *message);
 
-void CALLBACK timerCallback(HWND hwnd, UINT uMsg, UINT_PTR idEvent,
-                            DWORD dwTime);
+void processTick(const SchedulerTick *tick);
+
+void timerCallback(const SchedulerTick *tick);
+
+float replayReceived(float value, uint32_t payloadFlags);
+
+uint32_t replayTick(const SchedulerTick *tick, ControlLoop *regulators,
+                    uint32_t payloadFlags);
+
+int replayRecording(const char *path);
                     
 void connectionLostHandler(void *context, char *cause);
+
+void stopHandler(int signalNumber);
         
-int main(void);
+int main(int argc, char* argv[]);
 
 /******* definition of local functions ****************************************/
-void updatePressureValue(float pressureValue) 
+void updatePressureValue(uint32_t instance, float pressureValue,
+                         uint64_t timestampNs) 
 {
-  int result;
-  char payload[PAYLOADSIZE];
-  MQTTClient_deliveryToken token;
-  MQTTClient_message publishMessage = MQTTClient_message_initializer;
-  
-  publishMessage.payload = payload;
-  publishMessage.payloadlen = strlen(payload);
-  publishMessage.qos = QOS;
-  publishMessage.retained = 0;
-  
-  snprintf(payload, sizeof(payload), "%.2f", pressureValue);
+  /* Never waits on the network, the sender thread publishes the latest
+     value as soon as the broker accepts it */
+  publisherPostSample(&publisher, instance, pressureValue, timestampNs);
+#if (DEBUGLOG)
+  printf("Message queued for %u: %.2f\n", instance, pressureValue);
+#endif
+}
 
-  result = MQTTClient_publishMessage(client, TOPIC_Y, &publishMessage, &token);
-  if (result != MQTTCLIENT_SUCCESS) 
+void appendStatsLine(char *payload, size_t size, const char *line) 
+{
+  size_t length = strlen(payload);
+  size_t lineLength = strlen(line);
+
+  if ((length + 1u + lineLength) < size)
+  {
+    payload[length++] = '\n';
+    memcpy(payload + length, line, lineLength + 1u);
+  }
+}
+
+void publishTickStats(void) 
+{
+  char payload[STATSSIZE];
+  char line[STATSSIZE];
+
+  tickStatsFormat(&tickStats, payload, sizeof(payload));
+  publisherFormatStats(&publisher, line, sizeof(line));
+  appendStatsLine(payload, sizeof(payload), line);
+  actuatorFormatStats(&actuator, line, sizeof(line));
+  appendStatsLine(payload, sizeof(payload), line);
+  if (deadbandEnabled)
   {
-    printf("Failed to publish message, return code %d\n", result);
+    deadbandFormatStats(&deadband, line, sizeof(line));
+    appendStatsLine(payload, sizeof(payload), line);
   }
-  else 
+  if (batchSamples > 0u)
   {
-#if (DEBUGLOG)
-    printf("Message published: %s\n", payload);
-#endif
-    result = MQTTClient_waitForCompletion(client, token, TIMEOUT);
-#if (DEBUGLOG)
-    printf("Message with delivery token %d delivered\n", token);
-#endif
+    batcherFormatStats(&batcher, line, sizeof(line));
+    appendStatsLine(payload, sizeof(payload), line);
+  }
+  if (checkpoint.file.data != NULL)
+  {
+    checkpointFormatStats(&checkpoint, line, sizeof(line));
+    appendStatsLine(payload, sizeof(payload), line);
+  }
+  if (aggregating)
+  {
+    aggregatorFormatStats(&aggregator, line, sizeof(line));
+    appendStatsLine(payload, sizeof(payload), line);
+  }
+  if (tracing)
+  {
+    loopLatencyFormatStats(&loopLatency, line, sizeof(line));
+    appendStatsLine(payload, sizeof(payload), line);
+    loopLatencyFormatSlowLoops(&loopLatency, line, sizeof(line));
+    appendStatsLine(payload, sizeof(payload), line);
+  }
+
+  if (publisherPostMessage(&publisher, TOPIC_STATS, payload,
+                           strlen(payload)) != 0) 
+  {
+    printf("Failed to queue tick statistics\n");
   }
 }
 
+void waitForResponses(void) 
+{
+  struct timespec deadline;
+
+  /* All answers may have arrived before the expected count was known */
+  if (atomic_load(&responses) >= atomic_load(&expectedResponses))
+  {
+    return;
+  }
+
+  clock_gettime(CLOCK_REALTIME, &deadline);
+  deadline.tv_sec += RESPONSETIMEOUT / 1000L;
+  deadline.tv_nsec += (RESPONSETIMEOUT % 1000L) * 1000000L;
+  if (deadline.tv_nsec >= 1000000000L)
+  {
+    deadline.tv_sec++;
+    deadline.tv_nsec -= 1000000000L;
+  }
+
+  while (sem_timedwait(&responsesReady, &deadline) != 0)
+  {
+    if (errno != EINTR)
+    {
+      responseTimeouts++;
+      printf("Regulator did not answer within %ld ms\n", RESPONSETIMEOUT);
+      break;
+    }
+  }
+}
+
+/* A topic "prefix" is instance 0, "prefix/i" instance i; set pressures are
+   only routed while recording */
+int initTopicRouter(void)
+{
+  int result;
+
+  topicRouterInit(&topicRouter);
+  result = topicRouterAdd(&topicRouter, TOPIC_X, ROUTE_X) |
+           topicRouterAddFamily(&topicRouter, TOPIC_X, ROUTE_X);
+  if (recording)
+  {
+    result |= topicRouterAdd(&topicRouter, TOPIC_YZ, ROUTE_YZ) |
+              topicRouterAddFamily(&topicRouter, TOPIC_YZ, ROUTE_YZ);
+  }
+
+  return result;
+}
+
 int messageArrivedHandler(void *context, char *topicName, int topicLen,
                           MQTTClient_message *message) 
 {
-  if (strcmp(topicName, TOPIC_X) == 0) 
+  PayloadSample sample;
+  uint32_t instance = 0u;
+  uint32_t route;
+  uint64_t arrivalNs = timebaseNowNs();
+
+  /* The client passes 0 unless the topic contains a null character */
+  route = topicRouterFind(&topicRouter, topicName,
+                          (topicLen > 0) ? (size_t)topicLen : strlen(topicName),
+                          &instance);
+  if ((route == ROUTE_YZ) && (instance < plant.count) &&
+      (payloadDecode(message->payload, message->payloadlen, &sample) == 0))
   {
-    sscanf((char *)message->payload, "%f", &hysteresis_correction[1u]);
-    printf("Received xn: %.2f\n", hysteresis_correction[1u]);
+    actuatorWrite(&setpoints, instance, sample.value);
+  }
+
+  if ((route == ROUTE_X) && (instance < plant.count) &&
+      (payloadDecode(message->payload, message->payloadlen, &sample) == 0))
+  {
+    if (tracing)
+    {
+      loopLatencyRecord(&loopLatency, instance, &sample, arrivalNs);
+    }
+
+    /* In lockstep only answers to the tick being waited on move the
+       actuator, a late one would make the run depend on the broker */
+    if (lockstep && (((sample.flags & PAYLOAD_TIMESTAMP) == 0u) ||
+                     (sample.timestampUs !=
+                      atomic_load(&expectedTimestampUs))))
+    {
+      atomic_fetch_add(&staleCorrections, 1u);
+    }
+    else
+    {
+      actuatorWrite(&actuator, instance, sample.value);
+      if (plant.count == 1u)
+      {
+        printf("Received xn: %.2f\n", sample.value);
+      }
+
+      /* The last answer to the samples of the current tick releases it */
+      if (lockstep &&
+          ((atomic_fetch_add(&responses, 1u) + 1u) ==
+           atomic_load(&expectedResponses)))
+      {
+        sem_post(&responsesReady);
+      }
+    }
   }
   MQTTClient_freeMessage(&message);
   MQTTClient_free(topicName);
   return 1;
 }
 
-void CALLBACK timerCallback(HWND hwnd, UINT uMsg, UINT_PTR idEvent,
-                            DWORD dwTime) 
+/* Everything a tick computes, shared by the live process and the replay */
+void processTick(const SchedulerTick *tick) 
 {
+  uint32_t changes;
+  uint32_t change;
+  uint32_t instance;
+
+  changes = actuatorSnapshot(&actuator, plant.input, changedInstances);
+  if (recording)
+  {
+    recorderWrite(&recorder, RECORDER_TICK, (uint32_t)tick->index,
+                  tick->deadlineNs, 0.0f, tick->missed);
+    for (change = 0u; change < changes; change++)
+    {
+      instance = changedInstances[change];
+      recorderWrite(&recorder, RECORDER_CORRECTION, instance, tick->deadlineNs,
+                    plant.input[instance], 0u);
+    }
+    changes = actuatorSnapshot(&setpoints, setpointValues, changedInstances);
+    for (change = 0u; change < changes; change++)
+    {
+      instance = changedInstances[change];
+      recorderWrite(&recorder, RECORDER_SETPOINT, instance, tick->deadlineNs,
+                    setpointValues[instance], 0u);
+    }
+  }
+
 #if (DEBUGLOG)
-  printf("x[n] = %f\n", hysteresis_correction[0u]);
-  printf("x[n-1] = %f\n", hysteresis_correction[1u]);
-  printf("y[n-1] = %f\n", pressure[0u]);
+  printf("x[n] = %f\n", plant.input[0u]);
+  printf("x[n-1] = %f\n", plant.previousInput[0u]);
+  printf("y[n-1] = %f\n", plant.output[0u]);
 #endif
-  pressure[1u] = ((1.0/21.0) * 
-                  (hysteresis_correction[1u] + hysteresis_correction[0u])) +
-                 (19.0/21.0) * pressure[0u];
+  plantStep(&plant);
+
+  if (recording)
+  {
+    for (instance = 0u; instance < plant.count; instance++)
+    {
+      recorderWrite(&recorder, RECORDER_OUTPUT, instance, tick->deadlineNs,
+                    plant.output[instance], 0u);
+    }
+  }
+}
+
+void timerCallback(const SchedulerTick *tick) 
+{
+  uint32_t instance;
+  uint32_t published = 0u;
+
+  if (tick->missed > 0u)
+  {
+    printf("Missed %u tick(s) before tick %llu\n", tick->missed,
+           (unsigned long long)tick->index);
+  }
+
+  /* Until the number of published samples is known no answer may release
+     the tick */
+  if (lockstep)
+  {
+    while (sem_trywait(&responsesReady) == 0)
+    {
+    }
+    atomic_store(&expectedResponses, UINT32_MAX);
+    atomic_store(&responses, 0u);
+    atomic_store(&expectedTimestampUs, tick->deadlineNs / TIMEBASE_NS_PER_US);
+  }
+
+  processTick(tick);
+
+  if (plant.count == 1u)
+  {
+    printf("y[n] = %f\n", plant.output[0u]);
+  }
+  if (aggregating)
+  {
+    aggregatorTick(&aggregator, tick->deadlineNs);
+  }
+  for (instance = 0u; instance < plant.count; instance++)
+  {
+    if (aggregating)
+    {
+      aggregatorAdd(&aggregator, instance, plant.output[instance]);
+    }
+    if (deadbandEnabled &&
+        !deadbandShouldPublish(&deadband, instance, plant.output[instance],
+                               tick->deadlineNs))
+    {
+      continue;
+    }
+    if (batchSamples > 0u)
+    {
+      batcherAdd(&batcher, instance, plant.output[instance], tick->deadlineNs);
+      continue;
+    }
+    updatePressureValue(instance, plant.output[instance], tick->deadlineNs);
+    published++;
+  }
+  if (batchSamples > 0u)
+  {
+    batcherPoll(&batcher, tick->deadlineNs);
+  }
+  publisherFlush(&publisher);
+
+  if (lockstep)
+  {
+    atomic_store(&expectedResponses, published);
+  }
+}
+
+/* Runs one recorded tick and returns the number of instances whose input
+   differs from what the regulator would have answered to the previous one */
+/* A value as the other side receives it, text carries two decimals */
+float replayReceived(float value, uint32_t payloadFlags)
+{
+  PayloadSample sample;
+  char payload[PAYLOAD_TEXTSIZE];
+  int length;
+
+  if ((payloadFlags & PAYLOAD_BINARY) != 0u)
+  {
+    return value;
+  }
+  memset(&sample, 0, sizeof(sample));
+  sample.value = value;
+  length = payloadFormatText(&sample, payload, sizeof(payload));
+  if ((length < 0) || (payloadParseText(payload, length, &sample) != 0))
+  {
+    return value;
+  }
+
+  return sample.value;
+}
+
+/* A sample carries the deadline of its tick, the time of a law in virtual
+   time */
+uint32_t replayTick(const SchedulerTick *tick, ControlLoop *regulators,
+                    uint32_t payloadFlags)
+{
+  uint32_t instance;
+  uint32_t disagreements = 0u;
+
+  processTick(tick);
+  for (instance = 0u; instance < plant.count; instance++)
+  {
+    if (plant.input[instance] !=
+        replayReceived(regulators[instance].output, payloadFlags))
+    {
+      disagreements++;
+    }
+    controlLoopUpdate(&regulators[instance],
+                      replayReceived(plant.output[instance], payloadFlags),
+                      tick->deadlineNs);
+  }
+
+  return disagreements;
+}
+
+int replayRecording(const char *path)
+{
+  Recorder log;
+  RecorderEvent event;
+  SchedulerTick tick = {0u, 0u, 0u, 0u};
+  ControlLoop *regulators;
+  ControlLawParameters *law;
+  uint32_t payloadFlags;
+  uint32_t instance;
+  uint32_t stepped = 1u;
+  uint32_t disagreements;
+  uint64_t ticks = 0u;
+  uint64_t outputMismatches = 0u;
+  uint64_t regulatorDisagreements = 0u;
+  uint64_t firstMismatchTick = UINT64_MAX;
+  uint64_t firstDisagreementTick = UINT64_MAX;
+  uint64_t malformed = 0u;
+  uint64_t startNs = timebaseNowNs();
+
+  if (recorderOpen(&log, path) != 0)
+  {
+    printf("Failed to open recording %s\n", path);
+    return 1;
+  }
+  law = &log.header.law;
+  payloadFlags = log.header.payloadFlags;
+  if ((log.header.count < 1u) || (log.header.count > UINT16_MAX) ||
+      (log.header.delay > PLANT_MAXDELAY) || (law->law >= CONTROLLAW_COUNT) ||
+      (law->periodS <= 0.0f) ||
+      (plantInit(&plant, log.header.count, &log.header.model,
+                 log.header.delay, log.header.initialOutput) != 0))
+  {
+    printf("Recording %s describes no valid process\n", path);
+    recorderClose(&log);
+    return 1;
+  }
+  if (actuatorInit(&actuator, plant.count) != 0)
+  {
+    printf("Failed to create actuator inputs.\n");
+    plantFree(&plant);
+    recorderClose(&log);
+    return 1;
+  }
+  regulators = (ControlLoop *)calloc(plant.count, sizeof(ControlLoop));
+  if (regulators == NULL)
+  {
+    printf("Failed to create regulators.\n");
+    actuatorFree(&actuator);
+    plantFree(&plant);
+    recorderClose(&log);
+    return 1;
+  }
+  for (instance = 0u; instance < plant.count; instance++)
+  {
+    controlLoopConfigure(&regulators[instance], law);
+  }
+
+  while (recorderRead(&log, &event) == 1)
+  {
+    if ((event.type != RECORDER_TICK) && (event.instance >= plant.count))
+    {
+      malformed++;
+      continue;
+    }
+
+    switch (event.type)
+    {
+      case RECORDER_TICK:
+        if (!stepped)
+        {
+          replayTick(&tick, regulators, payloadFlags);
+        }
+        tick.index = event.instance;
+        tick.deadlineNs = event.timeNs;
+        tick.wakeNs = event.timeNs;
+        tick.missed = event.extra;
+        stepped = 0u;
+        ticks++;
+        break;
+      case RECORDER_CORRECTION:
+        actuatorWrite(&actuator, event.instance, event.value);
+        break;
+      case RECORDER_SETPOINT:
+        regulators[event.instance].setpoint = event.value;
+        break;
+      case RECORDER_OUTPUT:
+        if (!stepped)
+        {
+          disagreements = replayTick(&tick, regulators, payloadFlags);
+          if ((disagreements > 0u) && (regulatorDisagreements == 0u))
+          {
+            firstDisagreementTick = tick.index;
+          }
+          regulatorDisagreements += disagreements;
+          stepped = 1u;
+        }
+        if (memcmp(&plant.output[event.instance], &event.value,
+                   sizeof(event.value)) != 0)
+        {
+          if (outputMismatches == 0u)
+          {
+            firstMismatchTick = tick.index;
+          }
+          outputMismatches++;
+        }
+        break;
+      default:
+        malformed++;
+        break;
+    }
+  }
+  if (!stepped)
+  {
+    replayTick(&tick, regulators, payloadFlags);
+  }
 
-  pressure[0u] = pressure[1u];
-  hysteresis_correction[0u] = hysteresis_correction[1u];
+  printf("Replayed %llu tick(s) of %u instance(s), %llu events in %.1f ms\n",
+         (unsigned long long)ticks, plant.count,
+         (unsigned long long)log.events,
+         (timebaseNowNs() - startNs) / 1e6);
+  printf("Pressure mismatches: %llu", (unsigned long long)outputMismatches);
+  if (outputMismatches > 0u)
+  {
+    printf(" (first at tick %llu)", (unsigned long long)firstMismatchTick);
+  }
+  printf("\nRegulator disagreements: %llu",
+         (unsigned long long)regulatorDisagreements);
+  if (regulatorDisagreements > 0u)
+  {
+    printf(" (first at tick %llu)", (unsigned long long)firstDisagreementTick);
+  }
+  printf("\nMalformed events: %llu\n", (unsigned long long)malformed);
+
+  recorderClose(&log);
+  free(regulators);
+  plantFree(&plant);
+  actuatorFree(&actuator);
 
-  printf("y[n] = %f\n", pressure[1u]);
-  updatePressureValue(pressure[1u]);
+  return ((outputMismatches == 0u) && (regulatorDisagreements == 0u) &&
+          (malformed == 0u)) ? 0 : 1;
 }
 
 void connectionLostHandler(void *context, char *cause) 
@@ -125,19 +668,328 @@ void connectionLostHandler(void *context, char *cause)
 #endif
 }
 
-int main() 
+void stopHandler(int signalNumber) 
+{
+  running = 0;
+}
+
+int main(int argc, char* argv[]) 
 {
   int result;
+  int option;
   int numberOfConnectRetries = 100u;
+  long timerPeriod = TIMERPERIOD;
+  long statsPeriod = STATSPERIOD;
+  long instances = INSTANCES;
+  long duration = DURATION;
+  long maxSilence = MAXSILENCE;
+  double deadbandThreshold = 0.0;
+  long batchAge = BATCHAGE;
+  long checkpointPeriod = CHECKPOINTPERIOD;
+  const char *checkpointPath = NULL;
+  const char *recordPath = NULL;
+  const char *replayPath = NULL;
+  const char *lawSpec = NULL;
+  ControlLawParameters law;
+  RecorderHeader recorderHeader;
+  const char *windowList = NULL;
+  char *windowEnd;
+  uint64_t windowsNs[AGGREGATOR_MAXWINDOWS];
+  uint32_t windowCount = 0u;
+  uint32_t messageCount;
+  long groupSize = 0;
+  long slowLatency = -1;
+  CheckpointCounters counters = {0u, 0u};
+  uint64_t tickBase = 0u;
+  uint64_t runStartNs;
+  uint64_t checkpointPeriodNs;
+  uint64_t nextCheckpointNs;
+  uint64_t restoreStartNs;
+  uint32_t virtualTime = 0u;
+  uint32_t customModel = 0u;
+  uint32_t payloadFlags = 0u;
+  double processGain = PROCESSGAIN;
+  double timeConstant = TIMECONSTANT;
+  double naturalFrequency = 0.0;
+  double damping = DAMPING;
+  double deadTime = DEADTIME;
+  double samplingTime;
+  uint32_t delay;
+  const char *modelText = NULL;
+  LtiModel model = defaultModel;
+  uint32_t instance;
+  char topic[TOPICSIZE];
+  uint64_t statsPeriodNs;
+  uint64_t nextStatsNs;
+  uint64_t bodyStartNs;
+  char statsLine[STATSSIZE];
   MQTTClient_connectOptions connectionOptions = MQTTClient_connectOptions_initializer;
-  MSG receivedMessage;
-  UINT_PTR timerId;
+  PeriodicScheduler scheduler;
+  SchedulerTick tick = {0u, 0u, 0u, 0u};
 
-  pressure[0u] = 100u;
-  pressure[1u] = 0u;
-  
-  hysteresis_correction[0u] = 0u;
-  hysteresis_correction[1u] = 0u;
+  while ((option = getopt(argc, argv, "p:s:n:d:vwbe:m:k:a:c:C:r:R:g:A:G:K:T:L:W:Z:D:l:")) != -1)
+  {
+    switch (option)
+    {
+      case 'p':
+        timerPeriod = strtol(optarg, NULL, 10);
+        customModel = 1u;
+        break;
+      case 's':
+        statsPeriod = strtol(optarg, NULL, 10);
+        break;
+      case 'n':
+        instances = strtol(optarg, NULL, 10);
+        break;
+      case 'd':
+        duration = strtol(optarg, NULL, 10);
+        break;
+      case 'v':
+        virtualTime = 1u;
+        break;
+      case 'w':
+        lockstep = 1u;
+        break;
+      case 'b':
+        payloadFlags |= PAYLOAD_BINARY | PAYLOAD_SEQUENCE;
+        break;
+      case 'e':
+        deadbandThreshold = strtod(optarg, NULL);
+        deadbandEnabled = 1u;
+        break;
+      case 'm':
+        maxSilence = strtol(optarg, NULL, 10);
+        break;
+      case 'k':
+        batchSamples = (uint32_t)strtoul(optarg, NULL, 10);
+        break;
+      case 'a':
+        batchAge = strtol(optarg, NULL, 10);
+        break;
+      case 'r':
+        recordPath = optarg;
+        break;
+      case 'R':
+        replayPath = optarg;
+        break;
+      case 'g':
+        lawSpec = optarg;
+        break;
+      case 'A':
+        windowList = optarg;
+        break;
+      case 'G':
+        groupSize = strtol(optarg, NULL, 10);
+        break;
+      case 'c':
+        checkpointPath = optarg;
+        break;
+      case 'C':
+        checkpointPeriod = strtol(optarg, NULL, 10);
+        break;
+      case 'K':
+        processGain = strtod(optarg, NULL);
+        customModel = 1u;
+        break;
+      case 'T':
+        timeConstant = strtod(optarg, NULL);
+        customModel = 1u;
+        break;
+      case 'L':
+        modelText = optarg;
+        break;
+      case 'W':
+        naturalFrequency = strtod(optarg, NULL);
+        customModel = 1u;
+        break;
+      case 'Z':
+        damping = strtod(optarg, NULL);
+        customModel = 1u;
+        break;
+      case 'D':
+        deadTime = strtod(optarg, NULL);
+        break;
+      case 'l':
+        slowLatency = strtol(optarg, NULL, 10);
+        break;
+      default:
+        printf("Usage: %s [-p sampling period in ms]"
+               " [-s statistics period in s, 0 disables]"
+               " [-n number of process instances]"
+               " [-d duration in simulated s, 0 runs forever]"
+               " [-v virtual time] [-w wait for regulator every tick]"
+               " [-b binary payloads]"
+               " [-e deadband] [-m maximum silence in s]"
+               " [-k samples per batch frame] [-a maximum frame age in ms]"
+               " [-c checkpoint file] [-C checkpoint period in s]"
+               " [-r record to file] [-R replay file]"
+               " [-g control law of the regulator, recorded]"
+               " [-A summary windows in s, e.g. 1,10,60] [-G loops per group]"
+               " [-K process gain] [-T time constant in s]"
+               " [-L b0,b1,...:a1,a2,... discrete model]"
+               " [-W natural frequency in rad/s] [-Z damping]"
+               " [-D dead time in s]"
+               " [-l slow loop latency in ms, 0 is the sampling period]\n",
+               argv[0]);
+        return 1;
+    }
+  }
+  if (replayPath != NULL)
+  {
+    return replayRecording(replayPath);
+  }
+  controlLawDefaults(&law, CONTROLLAW_HYSTERESIS);
+  if ((lawSpec != NULL) && (controlLawParse(lawSpec, &law) != 0))
+  {
+    printf("Invalid control law \"%s\", expected \"hysteresis|pid|bangbang"
+           " [band=|kp=|ki=|kd=|ts=|min=|max=|dwell=<value> ...]\"\n",
+           lawSpec);
+    return 1;
+  }
+
+  while ((windowList != NULL) && (*windowList != '\0') &&
+         (windowCount < AGGREGATOR_MAXWINDOWS))
+  {
+    windowsNs[windowCount++] = (uint64_t)strtoul(windowList, &windowEnd, 10) *
+                               TIMEBASE_NS_PER_S;
+    windowList = (*windowEnd == ',') ? (windowEnd + 1) : windowEnd;
+    if (windowEnd == windowList)
+    {
+      break;
+    }
+  }
+  if ((windowList != NULL) && (*windowList != '\0'))
+  {
+    printf("Expected at most %u summary windows in s, each a multiple of the "
+           "previous one\n", AGGREGATOR_MAXWINDOWS);
+    return 1;
+  }
+
+  if (timerPeriod < MINTIMERPERIOD)
+  {
+    printf("Sampling period must be at least %ld ms\n", MINTIMERPERIOD);
+    return 1;
+  }
+
+  if ((instances < 1) || (instances > UINT16_MAX))
+  {
+    printf("Number of instances must be between 1 and %u\n", UINT16_MAX);
+    return 1;
+  }
+
+  samplingTime = timerPeriod / 1000.0;
+  if (modelText != NULL)
+  {
+    if (ltiParse(modelText, &model) != 0)
+    {
+      printf("Invalid model %s, expected b0,b1,...:a1,a2,... with at most %u "
+             "poles\n", modelText, LTI_MAXORDER);
+      return 1;
+    }
+  }
+  else if (customModel && (naturalFrequency > 0.0))
+  {
+    if (damping < 0.0)
+    {
+      printf("Damping must not be negative\n");
+      return 1;
+    }
+    model = (LtiModel)LTI_SECOND_ORDER_INIT(processGain, naturalFrequency,
+                                            damping, samplingTime);
+  }
+  else if (customModel)
+  {
+    if (timeConstant <= 0.0)
+    {
+      printf("Time constant must be positive\n");
+      return 1;
+    }
+    model = (LtiModel)LTI_FIRST_ORDER_INIT(processGain, timeConstant,
+                                           samplingTime);
+  }
+
+  if ((deadTime < 0.0) || ((deadTime / samplingTime) > PLANT_MAXDELAY))
+  {
+    printf("Dead time must be between 0 and %u samples\n", PLANT_MAXDELAY);
+    return 1;
+  }
+  delay = (uint32_t)((deadTime / samplingTime) + 0.5);
+
+  if (plantInit(&plant, (uint32_t)instances, &model, delay,
+                INITIALPRESSURE) != 0)
+  {
+    printf("Failed to create %ld process instances.\n", instances);
+    return 1;
+  }
+  if (actuatorInit(&actuator, plant.count) != 0)
+  {
+    printf("Failed to create actuator inputs.\n");
+    return 1;
+  }
+  if ((batchSamples > 0u) && lockstep)
+  {
+    printf("Batch frames cannot be combined with waiting for the regulator\n");
+    return 1;
+  }
+
+  if (recordPath != NULL)
+  {
+    /* A replay starts from the initial state and expects the regulator to
+       see every sample */
+    if (deadbandEnabled || (batchSamples > 0u) || (checkpointPath != NULL))
+    {
+      printf("Recording cannot be combined with -e, -k or -c\n");
+      return 1;
+    }
+    memset(&recorderHeader, 0, sizeof(recorderHeader));
+    recorderHeader.count = plant.count;
+    recorderHeader.delay = plant.delay;
+    recorderHeader.periodNs = (uint64_t)timerPeriod * TIMEBASE_NS_PER_MS;
+    recorderHeader.initialOutput = INITIALPRESSURE;
+    recorderHeader.payloadFlags = payloadFlags;
+    recorderHeader.model = model;
+    recorderHeader.law = law;
+    setpointValues = (float *)calloc(plant.count, sizeof(float));
+    changedInstances = (uint32_t *)calloc(plant.count, sizeof(uint32_t));
+    if ((setpointValues == NULL) || (changedInstances == NULL) ||
+        (actuatorInit(&setpoints, plant.count) != 0) ||
+        (recorderCreate(&recorder, recordPath, &recorderHeader) != 0))
+    {
+      printf("Failed to create recording %s\n", recordPath);
+      return 1;
+    }
+    recording = 1u;
+  }
+
+  if (deadbandEnabled &&
+      (deadbandInit(&deadband, plant.count, (float)deadbandThreshold,
+                    (uint64_t)maxSilence * TIMEBASE_NS_PER_S) != 0))
+  {
+    printf("Failed to create deadband.\n");
+    return 1;
+  }
+
+  printf("Simulating %u process instance(s) with %s kernel, dead time %u "
+         "sample(s)\n", plant.count, plant.kernelName, plant.delay);
+
+  if (initTopicRouter() != 0)
+  {
+    printf("Failed to set up the topic routes\n");
+    return 1;
+  }
+  if (slowLatency >= 0)
+  {
+    if (loopLatencyInit(&loopLatency, plant.count,
+                        (uint64_t)((slowLatency > 0) ? slowLatency :
+                                                       timerPeriod) *
+                        TIMEBASE_NS_PER_MS) != 0)
+    {
+      printf("Failed to allocate latency histograms\n");
+      return 1;
+    }
+    payloadFlags |= PAYLOAD_TRACE;
+    tracing = 1u;
+  }
 
   MQTTClient_create(&client, ADDRESS, CLIENTID, MQTTCLIENT_PERSISTENCE_NONE,
                     NULL);
@@ -153,19 +1005,163 @@ int main()
     printf("Failed to connect, return code %d\n", result);
     return 1;
   }
-  MQTTClient_subscribe(client, TOPIC_X, QOS);
+  /* The regulator answers batched samples per instance, even a single one */
+  MQTTClient_subscribe(client,
+                       ((plant.count == 1u) && (batchSamples == 0u)) ?
+                       TOPIC_X : TOPIC_X_ALL, QOS);
+  if (recording)
+  {
+    MQTTClient_subscribe(client, (plant.count == 1u) ? TOPIC_YZ : TOPIC_YZ_ALL,
+                         QOS);
+  }
 
-  timerId = SetTimer(NULL, 0, TIMERPERIOD, (TIMERPROC)timerCallback);
-  if (timerId == 0) 
+  if (virtualTime || lockstep)
+  {
+    payloadFlags |= PAYLOAD_TIMESTAMP;
+  }
+  /* The ring takes every summary of a tick besides the other messages */
+  messageCount = PUBLISHER_QUEUESIZE;
+  if ((windowCount > 0u) && (groupSize >= 0))
+  {
+    messageCount += aggregatorMessageCount(plant.count, (uint32_t)groupSize,
+                                           windowCount);
+  }
+  if (publisherStart(&publisher, client, QOS, TIMEOUT, plant.count,
+                     messageCount, payloadFlags) != 0)
+  {
+    printf("Failed to start publisher.\n");
+    return 1;
+  }
+  for (instance = 0u; instance < plant.count; instance++)
+  {
+    if (plant.count == 1u)
+    {
+      publisherSetSampleTopic(&publisher, instance, TOPIC_Y);
+    }
+    else
+    {
+      snprintf(topic, sizeof(topic), TOPIC_INSTANCE, TOPIC_Y, instance);
+      publisherSetSampleTopic(&publisher, instance, topic);
+    }
+  }
+  if ((batchSamples > 0u) &&
+      (batcherInit(&batcher, &publisher, TOPIC_Y_BATCH, payloadFlags,
+                   batchSamples, (uint64_t)batchAge * TIMEBASE_NS_PER_MS) != 0))
+  {
+    printf("Batch frames hold 1 to %u samples\n", (uint32_t)BATCHER_MAXSAMPLES);
+    return 1;
+  }
+
+  if (checkpointPath != NULL)
+  {
+    restoreStartNs = timebaseNowNs();
+    if (checkpointOpen(&checkpoint, checkpointPath, &plant) != 0)
+    {
+      printf("Failed to open checkpoint file %s\n", checkpointPath);
+      return 1;
+    }
+    if (checkpointRestore(&checkpoint, &plant, &publisher, &counters) == 0)
+    {
+      batcher.sequence = counters.batchSequence;
+      tickBase = counters.tickIndex + 1u;
+      printf("Resumed at tick %llu from %s in %.1f us\n",
+             (unsigned long long)counters.tickIndex, checkpointPath,
+             (timebaseNowNs() - restoreStartNs) / 1000.0);
+    }
+    else
+    {
+      printf("No checkpoint of this process in %s, starting afresh\n",
+             checkpointPath);
+    }
+  }
+
+  signal(SIGINT, stopHandler);
+  signal(SIGTERM, stopHandler);
+
+  sem_init(&responsesReady, 0, 0);
+  if (virtualTime)
+  {
+    result = schedulerInitVirtual(&scheduler,
+                                  (uint64_t)timerPeriod * TIMEBASE_NS_PER_MS);
+  }
+  else
+  {
+    result = schedulerInit(&scheduler,
+                           (uint64_t)timerPeriod * TIMEBASE_NS_PER_MS);
+  }
+  if ((result == 0) && virtualTime && (tickBase > 0u))
+  {
+    /* Simulated time continues where the checkpoint left it */
+    result = schedulerResumeVirtual(&scheduler, tickBase);
+    tickBase = 0u;
+  }
+  if (result != 0) 
   {
     printf("Failed to create timer.\n");
     return 1;
   }
+  tickStatsInit(&tickStats, scheduler.periodNs);
+  runStartNs = scheduler.startNs + (scheduler.nextIndex * scheduler.periodNs);
+  if (windowCount > 0u)
+  {
+    if ((groupSize < 0) ||
+        (aggregatorInit(&aggregator, &publisher, TOPIC_Y_SUMMARY, plant.count,
+                        (uint32_t)groupSize, windowsNs, windowCount,
+                        runStartNs) != 0))
+    {
+      printf("Summary windows must grow, each a multiple of the previous one, "
+             "and groups hold at most %u loops\n", plant.count);
+      return 1;
+    }
+    aggregating = 1u;
+  }
+  statsPeriodNs = (uint64_t)statsPeriod * TIMEBASE_NS_PER_S;
+  nextStatsNs = runStartNs + statsPeriodNs;
+  checkpointPeriodNs = (uint64_t)checkpointPeriod * TIMEBASE_NS_PER_S;
+  nextCheckpointNs = runStartNs + checkpointPeriodNs;
 
-  while (GetMessage(&receivedMessage, NULL, 0, 0)) 
+  while (running) 
   {
-    TranslateMessage(&receivedMessage);
-    DispatchMessage(&receivedMessage);
+    if (schedulerWaitTick(&scheduler, &tick) != 0)
+    {
+      printf("Failed to wait for timer.\n");
+      break;
+    }
+    tickStatsRecordTick(&tickStats, &tick);
+
+    bodyStartNs = timebaseNowNs();
+    timerCallback(&tick);
+    tickStatsRecordBody(&tickStats, bodyStartNs, timebaseNowNs());
+
+    if (lockstep)
+    {
+      waitForResponses();
+    }
+
+    if ((duration > 0) &&
+        ((tick.deadlineNs - runStartNs) >=
+         ((uint64_t)duration * TIMEBASE_NS_PER_S)))
+    {
+      running = 0;
+    }
+
+    counters.tickIndex = tickBase + tick.index;
+    counters.batchSequence = batcher.sequence;
+    if ((checkpoint.file.data != NULL) && (checkpointPeriodNs > 0u) &&
+        (tick.deadlineNs >= nextCheckpointNs))
+    {
+      if (checkpointSave(&checkpoint, &plant, &publisher, &counters) != 0)
+      {
+        printf("Failed to write checkpoint\n");
+      }
+      nextCheckpointNs += checkpointPeriodNs;
+    }
+
+    if ((statsPeriodNs > 0u) && (tick.wakeNs >= nextStatsNs))
+    {
+      publishTickStats();
+      nextStatsNs += statsPeriodNs;
+    }
     
     if (connectionLost == 1u)
     {
@@ -188,10 +1184,85 @@ int main()
     }
   }
 
-  KillTimer(NULL, timerId);
-
+  schedulerClose(&scheduler);
+  tickStatsPrint(&tickStats);
+  if (lockstep)
+  {
+    printf("Regulator response timeouts: %llu, stale corrections dropped: "
+           "%llu\n", (unsigned long long)responseTimeouts,
+           (unsigned long long)atomic_load(&staleCorrections));
+  }
+  actuatorFormatStats(&actuator, statsLine, sizeof(statsLine));
+  printf("%s\n", statsLine);
+  if (deadbandEnabled)
+  {
+    deadbandFormatStats(&deadband, statsLine, sizeof(statsLine));
+    printf("%s\n", statsLine);
+  }
+  if (batchSamples > 0u)
+  {
+    batcherFlush(&batcher, tick.deadlineNs);
+    batcherFormatStats(&batcher, statsLine, sizeof(statsLine));
+    printf("%s\n", statsLine);
+  }
+  if (aggregating)
+  {
+    aggregatorFormatStats(&aggregator, statsLine, sizeof(statsLine));
+    printf("%s\n", statsLine);
+  }
+  if (tracing)
+  {
+    loopLatencyFormatStats(&loopLatency, statsLine, sizeof(statsLine));
+    printf("%s\n", statsLine);
+    loopLatencyFormatSlowLoops(&loopLatency, statsLine, sizeof(statsLine));
+    printf("%s\n", statsLine);
+  }
+  if (checkpoint.file.data != NULL)
+  {
+    counters.batchSequence = batcher.sequence;
+    if (checkpointSave(&checkpoint, &plant, &publisher, &counters) != 0)
+    {
+      printf("Failed to write checkpoint\n");
+    }
+    checkpointFormatStats(&checkpoint, statsLine, sizeof(statsLine));
+    printf("%s\n", statsLine);
+  }
+  publishTickStats();
+  publisherStop(&publisher);
+  /* No callback may touch the inputs once they are freed */
   MQTTClient_disconnect(client, TIMEOUT);
   MQTTClient_destroy(&client);
 
+  checkpointClose(&checkpoint);
+  if (recording)
+  {
+    if (recorderClose(&recorder) != 0)
+    {
+      printf("Failed to complete recording %s\n", recordPath);
+    }
+    else
+    {
+      printf("Recorded %llu events to %s\n",
+             (unsigned long long)recorder.events, recordPath);
+    }
+    actuatorFree(&setpoints);
+    free(setpointValues);
+    free(changedInstances);
+  }
+  plantFree(&plant);
+  actuatorFree(&actuator);
+  if (aggregating)
+  {
+    aggregatorFree(&aggregator);
+  }
+  if (deadbandEnabled)
+  {
+    deadbandFree(&deadband);
+  }
+  if (tracing)
+  {
+    loopLatencyFree(&loopLatency);
+  }
+
   return 0;
 }
\ No newline at end of file
@@ -0,0 +1,345 @@
+/*******************************************************************************
+* Authors:
+*    Uros Cvjetinovic & Uros Popovic
+* @file
+* \brief Batched plant engine, see plant.h.
+*******************************************************************************/
+
+/******* include headers ******************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include "plant.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PLANT_X86_KERNELS       1
+#include <immintrin.h>
+#else
+#define PLANT_X86_KERNELS       0
+#endif
+
+/******* declaration of local functions ***************************************/
+static void stepScalar(PlantEngine *plant, const float *input);
+
+static void stepOrder1(PlantEngine *plant, const float *input);
+
+static void stepOrder2(PlantEngine *plant, const float *input);
+
+static void stepOrderN(PlantEngine *plant, const float *input);
+
+#if (PLANT_X86_KERNELS)
+static void stepSse(PlantEngine *plant, const float *input)
+  __attribute__((target("sse2")));
+
+static void stepAvx2(PlantEngine *plant, const float *input)
+  __attribute__((target("avx2")));
+
+static void stepOrder2Sse(PlantEngine *plant, const float *input)
+  __attribute__((target("sse2")));
+
+static void stepOrder2Avx2(PlantEngine *plant, const float *input)
+  __attribute__((target("avx2")));
+#endif
+
+static void selectKernel(PlantEngine *plant, const LtiModel *model);
+
+/******* definition of local functions ****************************************/
+static void stepScalar(PlantEngine *plant, const float *input)
+{
+  uint32_t index;
+  const float inputGain = plant->inputGain;
+  const float outputGain = plant->outputGain;
+  float *previousInput = plant->previousInput;
+  float *output = plant->output;
+
+  for (index = 0u; index < plant->count; index++)
+  {
+    output[index] = (inputGain * (input[index] + previousInput[index])) +
+                    (outputGain * output[index]);
+    previousInput[index] = input[index];
+  }
+}
+
+static void stepOrder1(PlantEngine *plant, const float *input)
+{
+  uint32_t index;
+
+  for (index = 0u; index < plant->count; index++)
+  {
+    plant->output[index] = ltiStepOrder1(plant->b, plant->a,
+                                         &plant->state[index], input[index]);
+    plant->previousInput[index] = input[index];
+  }
+}
+
+static void stepOrder2(PlantEngine *plant, const float *input)
+{
+  uint32_t index;
+  float *state0 = plant->state;
+  float *state1 = plant->state + plant->stride;
+
+  for (index = 0u; index < plant->count; index++)
+  {
+    plant->output[index] = ltiStepOrder2(plant->b, plant->a, &state0[index],
+                                         &state1[index], input[index]);
+    plant->previousInput[index] = input[index];
+  }
+}
+
+static void stepOrderN(PlantEngine *plant, const float *input)
+{
+  uint32_t index;
+
+  for (index = 0u; index < plant->count; index++)
+  {
+    plant->output[index] = ltiStep(plant->order, plant->b, plant->a,
+                                   &plant->state[index], plant->stride,
+                                   input[index]);
+    plant->previousInput[index] = input[index];
+  }
+}
+
+#if (PLANT_X86_KERNELS)
+static void stepSse(PlantEngine *plant, const float *input)
+{
+  uint32_t index;
+  const __m128 inputGain = _mm_set1_ps(plant->inputGain);
+  const __m128 outputGain = _mm_set1_ps(plant->outputGain);
+  __m128 x;
+  __m128 y;
+
+  for (index = 0u; index < plant->stride; index += 4u)
+  {
+    x = _mm_loadu_ps(&input[index]);
+    y = _mm_add_ps(
+          _mm_mul_ps(inputGain,
+                     _mm_add_ps(x, _mm_loadu_ps(&plant->previousInput[index]))),
+          _mm_mul_ps(outputGain, _mm_loadu_ps(&plant->output[index])));
+    _mm_storeu_ps(&plant->output[index], y);
+    _mm_storeu_ps(&plant->previousInput[index], x);
+  }
+}
+
+static void stepAvx2(PlantEngine *plant, const float *input)
+{
+  uint32_t index;
+  const __m256 inputGain = _mm256_set1_ps(plant->inputGain);
+  const __m256 outputGain = _mm256_set1_ps(plant->outputGain);
+  __m256 x;
+  __m256 y;
+
+  for (index = 0u; index < plant->stride; index += 8u)
+  {
+    x = _mm256_loadu_ps(&input[index]);
+    y = _mm256_add_ps(
+          _mm256_mul_ps(inputGain,
+                        _mm256_add_ps(x,
+                                      _mm256_loadu_ps(&plant->previousInput[index]))),
+          _mm256_mul_ps(outputGain, _mm256_loadu_ps(&plant->output[index])));
+    _mm256_storeu_ps(&plant->output[index], y);
+    _mm256_storeu_ps(&plant->previousInput[index], x);
+  }
+}
+
+static void stepOrder2Sse(PlantEngine *plant, const float *input)
+{
+  uint32_t index;
+  const __m128 b0 = _mm_set1_ps(plant->b[0]);
+  const __m128 b1 = _mm_set1_ps(plant->b[1]);
+  const __m128 b2 = _mm_set1_ps(plant->b[2]);
+  const __m128 a1 = _mm_set1_ps(plant->a[1]);
+  const __m128 a2 = _mm_set1_ps(plant->a[2]);
+  float *state0 = plant->state;
+  float *state1 = plant->state + plant->stride;
+  __m128 x;
+  __m128 y;
+
+  for (index = 0u; index < plant->stride; index += 4u)
+  {
+    x = _mm_loadu_ps(&input[index]);
+    y = _mm_add_ps(_mm_mul_ps(b0, x), _mm_loadu_ps(&state0[index]));
+    _mm_storeu_ps(&state0[index],
+                  _mm_add_ps(_mm_sub_ps(_mm_mul_ps(b1, x), _mm_mul_ps(a1, y)),
+                             _mm_loadu_ps(&state1[index])));
+    _mm_storeu_ps(&state1[index],
+                  _mm_sub_ps(_mm_mul_ps(b2, x), _mm_mul_ps(a2, y)));
+    _mm_storeu_ps(&plant->output[index], y);
+    _mm_storeu_ps(&plant->previousInput[index], x);
+  }
+}
+
+static void stepOrder2Avx2(PlantEngine *plant, const float *input)
+{
+  uint32_t index;
+  const __m256 b0 = _mm256_set1_ps(plant->b[0]);
+  const __m256 b1 = _mm256_set1_ps(plant->b[1]);
+  const __m256 b2 = _mm256_set1_ps(plant->b[2]);
+  const __m256 a1 = _mm256_set1_ps(plant->a[1]);
+  const __m256 a2 = _mm256_set1_ps(plant->a[2]);
+  float *state0 = plant->state;
+  float *state1 = plant->state + plant->stride;
+  __m256 x;
+  __m256 y;
+
+  for (index = 0u; index < plant->stride; index += 8u)
+  {
+    x = _mm256_loadu_ps(&input[index]);
+    y = _mm256_add_ps(_mm256_mul_ps(b0, x), _mm256_loadu_ps(&state0[index]));
+    _mm256_storeu_ps(&state0[index],
+                     _mm256_add_ps(_mm256_sub_ps(_mm256_mul_ps(b1, x),
+                                                 _mm256_mul_ps(a1, y)),
+                                   _mm256_loadu_ps(&state1[index])));
+    _mm256_storeu_ps(&state1[index],
+                     _mm256_sub_ps(_mm256_mul_ps(b2, x), _mm256_mul_ps(a2, y)));
+    _mm256_storeu_ps(&plant->output[index], y);
+    _mm256_storeu_ps(&plant->previousInput[index], x);
+  }
+}
+#endif
+
+static void selectKernel(PlantEngine *plant, const LtiModel *model)
+{
+#if (PLANT_X86_KERNELS)
+  int avx2;
+  int sse2;
+
+  __builtin_cpu_init();
+  avx2 = __builtin_cpu_supports("avx2");
+  sse2 = __builtin_cpu_supports("sse2");
+#endif
+
+  if (ltiIsSymmetricFirstOrder(model))
+  {
+    plant->kernel = stepScalar;
+    plant->kernelName = "scalar";
+#if (PLANT_X86_KERNELS)
+    if (avx2)
+    {
+      plant->kernel = stepAvx2;
+      plant->kernelName = "avx2";
+    }
+    else if (sse2)
+    {
+      plant->kernel = stepSse;
+      plant->kernelName = "sse2";
+    }
+#endif
+  }
+  else if (plant->order == 2u)
+  {
+    plant->kernel = stepOrder2;
+    plant->kernelName = "order 2 scalar";
+#if (PLANT_X86_KERNELS)
+    if (avx2)
+    {
+      plant->kernel = stepOrder2Avx2;
+      plant->kernelName = "order 2 avx2";
+    }
+    else if (sse2)
+    {
+      plant->kernel = stepOrder2Sse;
+      plant->kernelName = "order 2 sse2";
+    }
+#endif
+  }
+  else if (plant->order == 1u)
+  {
+    plant->kernel = stepOrder1;
+    plant->kernelName = "order 1 scalar";
+  }
+  else
+  {
+    plant->kernel = stepOrderN;
+    plant->kernelName = "order n scalar";
+  }
+}
+
+/******* definition of global functions ***************************************/
+int plantInit(PlantEngine *plant, uint32_t count, const LtiModel *model,
+              uint32_t delay, float initialOutput)
+{
+  uint32_t index;
+
+  memset(plant, 0, sizeof(*plant));
+  if ((count == 0u) || (model->order == 0u) ||
+      (model->order > LTI_MAXORDER) || (delay > PLANT_MAXDELAY))
+  {
+    return -1;
+  }
+
+  plant->count = count;
+  plant->stride = ((count + PLANT_LANES - 1u) / PLANT_LANES) * PLANT_LANES;
+  plant->order = model->order;
+  plant->delay = delay;
+  for (index = 0u; index <= model->order; index++)
+  {
+    plant->b[index] = (float)model->b[index];
+    plant->a[index] = (float)model->a[index];
+  }
+  plant->inputGain = (float)model->b[0];
+  plant->outputGain = (float)(-model->a[1]);
+  plant->input = (float *)calloc(plant->stride, sizeof(float));
+  plant->previousInput = (float *)calloc(plant->stride, sizeof(float));
+  plant->output = (float *)calloc(plant->stride, sizeof(float));
+  plant->state = (float *)calloc((size_t)plant->stride * plant->order,
+                                 sizeof(float));
+  if (delay > 0u)
+  {
+    plant->delayLine = (float *)calloc((size_t)plant->stride * delay,
+                                       sizeof(float));
+  }
+  if ((plant->input == NULL) || (plant->previousInput == NULL) ||
+      (plant->output == NULL) || (plant->state == NULL) ||
+      ((delay > 0u) && (plant->delayLine == NULL)))
+  {
+    plantFree(plant);
+    return -1;
+  }
+
+  for (index = 0u; index < count; index++)
+  {
+    plant->output[index] = initialOutput;
+    ltiSteadyState(plant->order, plant->a, initialOutput,
+                   &plant->state[index], plant->stride);
+  }
+
+  selectKernel(plant, model);
+
+  return 0;
+}
+
+void plantStep(PlantEngine *plant)
+{
+  float *delayRow;
+
+  if (plant->delay == 0u)
+  {
+    plant->kernel(plant, plant->input);
+    return;
+  }
+
+  /* The oldest row holds x[n - delay]. Once the model has consumed it, the
+     row is reused for x[n] and becomes the newest one. */
+  delayRow = &plant->delayLine[(size_t)plant->delayIndex * plant->stride];
+  plant->kernel(plant, delayRow);
+  memcpy(delayRow, plant->input, plant->stride * sizeof(float));
+
+  plant->delayIndex++;
+  if (plant->delayIndex == plant->delay)
+  {
+    plant->delayIndex = 0u;
+  }
+}
+
+void plantFree(PlantEngine *plant)
+{
+  free(plant->input);
+  free(plant->previousInput);
+  free(plant->output);
+  free(plant->state);
+  free(plant->delayLine);
+  plant->input = NULL;
+  plant->previousInput = NULL;
+  plant->output = NULL;
+  plant->state = NULL;
+  plant->delayLine = NULL;
+}
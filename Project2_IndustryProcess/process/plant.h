@@ -0,0 +1,65 @@
+/*******************************************************************************
+* Authors:
+*    Uros Cvjetinovic & Uros Popovic
+* @file
+* \brief Batched plant engine. Holds any number of process instances sharing
+*   one LTI model in structure-of-arrays layout and advances all of them in
+*   one pass per tick. The kernel is chosen once from the model:
+*    - a first order model with b0 == b1 (any bilinear first order plant):
+*      y[n] = inputGain * (x[n] + x[n-1]) + outputGain * y[n-1]
+*    - a second order model in transposed direct form II
+*   both vectorized with AVX2 or SSE when the CPU supports it, scalar
+*   otherwise. The vector and scalar variants perform the same operations in
+*   the same order, so the results do not depend on the CPU.
+*    - any other order: the generic step from lti.h
+*   An optional dead time of whole samples delays the input of every
+*   instance. It is a ring of delay rows allocated once at start-up, all
+*   instances share the ring position, so the delay costs one load and one
+*   store per instance and tick.
+*******************************************************************************/
+#ifndef PLANT_H
+#define PLANT_H
+
+/******* include headers ******************************************************/
+#include <stdint.h>
+#include "lti.h"
+
+/******* global macros ********************************************************/
+/* Arrays are padded to a whole number of the widest vector */
+#define PLANT_LANES             ((uint32_t) 8u)
+#define PLANT_MAXDELAY          ((uint32_t) 65536u)
+
+/******* type definitions *****************************************************/
+typedef struct PlantEngine PlantEngine;
+
+typedef void (*PlantKernel)(PlantEngine *plant, const float *input);
+
+struct PlantEngine
+{
+  uint32_t count;
+  uint32_t stride;
+  uint32_t order;
+  float b[LTI_MAXORDER + 1u];
+  float a[LTI_MAXORDER + 1u];
+  float inputGain;
+  float outputGain;
+  float *input;          /* x[n], latest actuator value of each instance */
+  float *previousInput;  /* x[n-1] as seen by the model, after the delay */
+  float *output;         /* y[n-1] before a step, y[n] after it */
+  float *state;          /* order rows of stride values, general kernels */
+  uint32_t delay;        /* dead time in samples */
+  uint32_t delayIndex;   /* oldest row of the delay ring */
+  float *delayLine;      /* delay rows of stride values */
+  PlantKernel kernel;
+  const char *kernelName;
+};
+
+/******* declaration of global functions **************************************/
+int plantInit(PlantEngine *plant, uint32_t count, const LtiModel *model,
+              uint32_t delay, float initialOutput);
+
+void plantStep(PlantEngine *plant);
+
+void plantFree(PlantEngine *plant);
+
+#endif /* PLANT_H */
@@ -0,0 +1,392 @@
+/*******************************************************************************
+* Authors:
+*    Uros Cvjetinovic & Uros Popovic
+* @file
+* \brief Non-blocking publish path of the process, see publisher.h.
+*******************************************************************************/
+
+/******* include headers ******************************************************/
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "payload.h"
+#include "publisher.h"
+#include "timebase.h"
+
+/******* declaration of local functions ***************************************/
+static void *senderThread(void *context);
+
+static int sendSamples(Publisher *publisher);
+
+static int sendMessages(Publisher *publisher);
+
+static void publish(Publisher *publisher, const char *topic, void *payload,
+                    int payloadLength);
+
+static void readSample(PublisherSample *sample, PayloadSample *payloadSample);
+
+/******* definition of local functions ****************************************/
+static void publish(Publisher *publisher, const char *topic, void *payload,
+                    int payloadLength)
+{
+  int result;
+  MQTTClient_deliveryToken token;
+  MQTTClient_message publishMessage = MQTTClient_message_initializer;
+
+  publishMessage.payload = payload;
+  publishMessage.payloadlen = payloadLength;
+  publishMessage.qos = publisher->qos;
+  publishMessage.retained = 0;
+
+  result = MQTTClient_publishMessage(publisher->client, topic, &publishMessage,
+                                     &token);
+  if (result == MQTTCLIENT_SUCCESS)
+  {
+    result = MQTTClient_waitForCompletion(publisher->client, token,
+                                          publisher->timeout);
+  }
+
+  if (result != MQTTCLIENT_SUCCESS)
+  {
+    atomic_fetch_add_explicit(&publisher->publishFailed, 1u,
+                              memory_order_relaxed);
+    printf("Failed to publish message to %s, return code %d\n", topic, result);
+  }
+  else
+  {
+    atomic_fetch_add_explicit(&publisher->published, 1u, memory_order_relaxed);
+  }
+}
+
+static void readSample(PublisherSample *sample, PayloadSample *payloadSample)
+{
+  unsigned int before;
+  unsigned int after;
+
+  do
+  {
+    before = atomic_load_explicit(&sample->sequence, memory_order_acquire);
+    payloadSample->value = sample->value;
+    payloadSample->sequence = sample->sampleNumber;
+    payloadSample->timestampUs = sample->timestampNs / TIMEBASE_NS_PER_US;
+    atomic_thread_fence(memory_order_acquire);
+    after = atomic_load_explicit(&sample->sequence, memory_order_relaxed);
+  } while (((before & 1u) != 0u) || (before != after));
+}
+
+static int sendSamples(Publisher *publisher)
+{
+  unsigned int tail;
+  unsigned int head;
+  uint32_t sampleIndex;
+  PublisherSample *sample;
+  PayloadSample payloadSample;
+  char payload[PAYLOAD_TEXTSIZE];
+  int payloadLength;
+  int sent = 0;
+
+  tail = atomic_load_explicit(&publisher->sampleTail, memory_order_relaxed);
+  head = atomic_load_explicit(&publisher->sampleHead, memory_order_acquire);
+
+  while (tail != head)
+  {
+    sampleIndex = publisher->sampleQueue[tail % publisher->sampleCount];
+    tail++;
+    atomic_store_explicit(&publisher->sampleTail, tail, memory_order_release);
+
+    /* Clear the pending flag before reading the value, a value posted after
+       this point queues the slot again instead of being lost */
+    sample = &publisher->samples[sampleIndex];
+    atomic_store(&sample->pending, 0u);
+    readSample(sample, &payloadSample);
+
+    payloadSample.flags = publisher->payloadFlags;
+    /* Traced as late as possible, the latency starts when the sample is
+       handed to the client */
+    if ((payloadSample.flags & PAYLOAD_TRACE) != 0u)
+    {
+      publisher->correlation++;
+      publisher->correlation += (publisher->correlation == 0u) ? 1u : 0u;
+      payloadSample.correlation = publisher->correlation;
+      payloadSample.sentUs = timebaseNowNs() / TIMEBASE_NS_PER_US;
+    }
+    payloadLength = payloadEncode(&payloadSample, payload, sizeof(payload));
+    if (payloadLength > 0)
+    {
+      publish(publisher, sample->topic, payload, payloadLength);
+    }
+    sent++;
+  }
+
+  return sent;
+}
+
+static int sendMessages(Publisher *publisher)
+{
+  unsigned int tail;
+  unsigned int head;
+  PublisherMessage *message;
+  int sent = 0;
+
+  tail = atomic_load_explicit(&publisher->messageTail, memory_order_relaxed);
+  head = atomic_load_explicit(&publisher->messageHead, memory_order_acquire);
+
+  while (tail != head)
+  {
+    message = &publisher->messages[tail & publisher->messageMask];
+    publish(publisher, message->topic, message->payload,
+            message->payloadLength);
+    tail++;
+    atomic_store_explicit(&publisher->messageTail, tail, memory_order_release);
+    sent++;
+  }
+
+  return sent;
+}
+
+static void *senderThread(void *context)
+{
+  Publisher *publisher = (Publisher *)context;
+  int sent;
+
+  while (1)
+  {
+    while ((sem_wait(&publisher->wakeUp) != 0) && (errno == EINTR))
+    {
+    }
+
+    sent = sendSamples(publisher);
+    sent += sendMessages(publisher);
+
+    if ((sent == 0) && (atomic_load(&publisher->running) == 0))
+    {
+      break;
+    }
+  }
+
+  return NULL;
+}
+
+/******* definition of global functions ***************************************/
+/* The message ring holds at least messageCount messages, never less than
+   PUBLISHER_QUEUESIZE, rounded up to a power of two */
+int publisherStart(Publisher *publisher, MQTTClient client, int qos,
+                   long timeout, uint32_t sampleCount, uint32_t messageCount,
+                   uint32_t payloadFlags)
+{
+  uint32_t capacity = PUBLISHER_QUEUESIZE;
+  int result;
+
+  memset(publisher, 0, sizeof(*publisher));
+  publisher->client = client;
+  publisher->qos = qos;
+  publisher->timeout = timeout;
+  publisher->payloadFlags = payloadFlags;
+  publisher->sampleCount = sampleCount;
+  while ((capacity < messageCount) && (capacity < PUBLISHER_MAXQUEUESIZE))
+  {
+    capacity *= 2u;
+  }
+  publisher->messageMask = capacity - 1u;
+
+  publisher->samples = (PublisherSample *)calloc(sampleCount,
+                                                 sizeof(PublisherSample));
+  publisher->sampleQueue = (uint32_t *)calloc(sampleCount, sizeof(uint32_t));
+  publisher->messages = (PublisherMessage *)calloc(capacity,
+                                                   sizeof(PublisherMessage));
+  if ((publisher->samples == NULL) || (publisher->sampleQueue == NULL) ||
+      (publisher->messages == NULL))
+  {
+    free(publisher->samples);
+    free(publisher->sampleQueue);
+    free(publisher->messages);
+    return -1;
+  }
+
+  atomic_store(&publisher->running, 1);
+  result = sem_init(&publisher->wakeUp, 0, 0);
+  if ((result == 0) &&
+      (pthread_create(&publisher->thread, NULL, senderThread, publisher) != 0))
+  {
+    sem_destroy(&publisher->wakeUp);
+    result = -1;
+  }
+  if (result != 0)
+  {
+    free(publisher->samples);
+    free(publisher->sampleQueue);
+    free(publisher->messages);
+    return -1;
+  }
+
+  return 0;
+}
+
+void publisherSetSampleTopic(Publisher *publisher, uint32_t sampleIndex,
+                             const char *topic)
+{
+  snprintf(publisher->samples[sampleIndex].topic,
+           sizeof(publisher->samples[sampleIndex].topic), "%s", topic);
+}
+
+void publisherPostSample(Publisher *publisher, uint32_t sampleIndex,
+                         float value, uint64_t timestampNs)
+{
+  PublisherSample *sample = &publisher->samples[sampleIndex];
+  unsigned int sequence;
+  unsigned int head;
+
+  sequence = atomic_load_explicit(&sample->sequence, memory_order_relaxed);
+  atomic_store_explicit(&sample->sequence, sequence + 1u,
+                        memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+  sample->value = value;
+  sample->sampleNumber++;
+  sample->timestampNs = timestampNs;
+  atomic_store_explicit(&sample->sequence, sequence + 2u,
+                        memory_order_release);
+
+  atomic_fetch_add_explicit(&publisher->samplesPosted, 1u,
+                            memory_order_relaxed);
+
+  /* A slot that is still pending is already queued, the sender will pick up
+     the value written above. The queue holds each slot at most once, so it
+     can never overflow. */
+  if (atomic_exchange(&sample->pending, 1u) != 0u)
+  {
+    atomic_fetch_add_explicit(&publisher->samplesCoalesced, 1u,
+                              memory_order_relaxed);
+    return;
+  }
+
+  head = atomic_load_explicit(&publisher->sampleHead, memory_order_relaxed);
+  publisher->sampleQueue[head % publisher->sampleCount] = sampleIndex;
+  atomic_store_explicit(&publisher->sampleHead, head + 1u,
+                        memory_order_release);
+  publisher->unflushedSamples++;
+}
+
+void publisherFlush(Publisher *publisher)
+{
+  if (publisher->unflushedSamples != 0u)
+  {
+    publisher->unflushedSamples = 0u;
+    sem_post(&publisher->wakeUp);
+  }
+}
+
+uint32_t publisherGetSampleNumber(const Publisher *publisher,
+                                  uint32_t sampleIndex)
+{
+  return publisher->samples[sampleIndex].sampleNumber;
+}
+
+void publisherSetSampleNumber(Publisher *publisher, uint32_t sampleIndex,
+                              uint32_t sampleNumber)
+{
+  PublisherSample *sample = &publisher->samples[sampleIndex];
+  unsigned int sequence;
+
+  /* Only the posting thread changes the number, the sender may be reading */
+  sequence = atomic_load_explicit(&sample->sequence, memory_order_relaxed);
+  atomic_store_explicit(&sample->sequence, sequence + 1u,
+                        memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+  sample->sampleNumber = sampleNumber;
+  atomic_store_explicit(&sample->sequence, sequence + 2u,
+                        memory_order_release);
+}
+
+int publisherPostMessage(Publisher *publisher, const char *topic,
+                         const void *payload, int payloadLength)
+{
+  PublisherMessage *message;
+  unsigned int head;
+  unsigned int tail;
+  unsigned int depth;
+
+  head = atomic_load_explicit(&publisher->messageHead, memory_order_relaxed);
+  tail = atomic_load_explicit(&publisher->messageTail, memory_order_acquire);
+
+  if (((head - tail) > publisher->messageMask) || (payloadLength < 0) ||
+      ((uint32_t)payloadLength > PUBLISHER_PAYLOADSIZE))
+  {
+    atomic_fetch_add_explicit(&publisher->messagesDropped, 1u,
+                              memory_order_relaxed);
+    return -1;
+  }
+
+  message = &publisher->messages[head & publisher->messageMask];
+  snprintf(message->topic, sizeof(message->topic), "%s", topic);
+  memcpy(message->payload, payload, (size_t)payloadLength);
+  message->payloadLength = payloadLength;
+  atomic_store_explicit(&publisher->messageHead, head + 1u,
+                        memory_order_release);
+
+  depth = head + 1u - tail;
+  if (depth > atomic_load_explicit(&publisher->maxQueueDepth,
+                                   memory_order_relaxed))
+  {
+    atomic_store_explicit(&publisher->maxQueueDepth, depth,
+                          memory_order_relaxed);
+  }
+  atomic_fetch_add_explicit(&publisher->messagesPosted, 1u,
+                            memory_order_relaxed);
+  sem_post(&publisher->wakeUp);
+
+  return 0;
+}
+
+/* Number of messages that can be posted right now without being dropped */
+uint32_t publisherMessageSpace(Publisher *publisher)
+{
+  unsigned int head;
+  unsigned int tail;
+
+  head = atomic_load_explicit(&publisher->messageHead, memory_order_relaxed);
+  tail = atomic_load_explicit(&publisher->messageTail, memory_order_acquire);
+
+  return publisher->messageMask + 1u - (head - tail);
+}
+
+void publisherGetStats(Publisher *publisher, PublisherStats *stats)
+{
+  stats->samplesPosted = atomic_load(&publisher->samplesPosted);
+  stats->samplesCoalesced = atomic_load(&publisher->samplesCoalesced);
+  stats->messagesPosted = atomic_load(&publisher->messagesPosted);
+  stats->messagesDropped = atomic_load(&publisher->messagesDropped);
+  stats->published = atomic_load(&publisher->published);
+  stats->publishFailed = atomic_load(&publisher->publishFailed);
+  stats->maxQueueDepth = atomic_load(&publisher->maxQueueDepth);
+}
+
+int publisherFormatStats(Publisher *publisher, char *buffer, size_t size)
+{
+  PublisherStats stats;
+
+  publisherGetStats(publisher, &stats);
+
+  return snprintf(buffer, size,
+                  "publisher: samples=%llu coalesced=%llu messages=%llu "
+                  "dropped=%llu published=%llu failed=%llu maxdepth=%u",
+                  (unsigned long long)stats.samplesPosted,
+                  (unsigned long long)stats.samplesCoalesced,
+                  (unsigned long long)stats.messagesPosted,
+                  (unsigned long long)stats.messagesDropped,
+                  (unsigned long long)stats.published,
+                  (unsigned long long)stats.publishFailed,
+                  stats.maxQueueDepth);
+}
+
+void publisherStop(Publisher *publisher)
+{
+  atomic_store(&publisher->running, 0);
+  sem_post(&publisher->wakeUp);
+  pthread_join(publisher->thread, NULL);
+  sem_destroy(&publisher->wakeUp);
+
+  free(publisher->samples);
+  free(publisher->sampleQueue);
+  free(publisher->messages);
+}
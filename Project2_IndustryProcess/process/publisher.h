@@ -0,0 +1,128 @@
+/*******************************************************************************
+* Authors:
+*    Uros Cvjetinovic & Uros Popovic
+* @file
+* \brief Non-blocking publish path of the process. The tick thread hands
+*   messages to a dedicated sender thread, which is the only one waiting on
+*   the network. Two lock-free single-producer single-consumer paths exist:
+*    - samples: one latest-value slot per sample topic, a newer value
+*      overwrites one that was not sent yet (latest value wins)
+*    - messages: a bounded ring of preformatted messages, a full ring drops
+*      the new message. Its size is chosen at start, for the bursts of
+*      messages the process posts in one tick (e.g. summaries, aggregator.h)
+*   With PAYLOAD_TRACE every sample gets the next correlation id and its send
+*   time (payload.h) just before it is handed to the client.
+*   Only one thread may post to a publisher. Samples are handed to the sender
+*   in bulk by publisherFlush, so a tick posting many samples wakes it once.
+*******************************************************************************/
+#ifndef PUBLISHER_H
+#define PUBLISHER_H
+
+/******* include headers ******************************************************/
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "MQTTClient.h"
+
+/******* global macros ********************************************************/
+#define PUBLISHER_QUEUESIZE     ((uint32_t) 64u)
+#define PUBLISHER_MAXQUEUESIZE  ((uint32_t) 65536u)
+#define PUBLISHER_TOPICSIZE     ((uint32_t) 64u)
+#define PUBLISHER_PAYLOADSIZE   ((uint32_t) 1024u)
+#define PUBLISHER_CACHELINE     64
+
+/******* type definitions *****************************************************/
+typedef struct
+{
+  char topic[PUBLISHER_TOPICSIZE];
+  int payloadLength;
+  char payload[PUBLISHER_PAYLOADSIZE];
+} PublisherMessage;
+
+typedef struct
+{
+  /* Seqlock: odd while the producer is writing the fields below it */
+  atomic_uint sequence;
+  atomic_uint pending;
+  float value;
+  uint32_t sampleNumber;
+  uint64_t timestampNs;
+  char topic[PUBLISHER_TOPICSIZE];
+} PublisherSample;
+
+typedef struct
+{
+  uint64_t samplesPosted;
+  uint64_t samplesCoalesced;
+  uint64_t messagesPosted;
+  uint64_t messagesDropped;
+  uint64_t published;
+  uint64_t publishFailed;
+  uint32_t maxQueueDepth;
+} PublisherStats;
+
+typedef struct
+{
+  MQTTClient client;
+  int qos;
+  long timeout;
+  uint32_t payloadFlags;
+  uint32_t correlation;         /* last traced sample, sender thread only */
+  pthread_t thread;
+  sem_t wakeUp;
+  atomic_int running;
+
+  uint32_t sampleCount;
+  uint32_t unflushedSamples;
+  PublisherSample *samples;
+  uint32_t *sampleQueue;
+  _Alignas(PUBLISHER_CACHELINE) atomic_uint sampleHead;
+  _Alignas(PUBLISHER_CACHELINE) atomic_uint sampleTail;
+
+  uint32_t messageMask;
+  PublisherMessage *messages;
+  _Alignas(PUBLISHER_CACHELINE) atomic_uint messageHead;
+  _Alignas(PUBLISHER_CACHELINE) atomic_uint messageTail;
+
+  _Alignas(PUBLISHER_CACHELINE) atomic_ullong samplesPosted;
+  atomic_ullong samplesCoalesced;
+  atomic_ullong messagesPosted;
+  atomic_ullong messagesDropped;
+  atomic_ullong published;
+  atomic_ullong publishFailed;
+  atomic_uint maxQueueDepth;
+} Publisher;
+
+/******* declaration of global functions **************************************/
+int publisherStart(Publisher *publisher, MQTTClient client, int qos,
+                   long timeout, uint32_t sampleCount, uint32_t messageCount,
+                   uint32_t payloadFlags);
+
+void publisherSetSampleTopic(Publisher *publisher, uint32_t sampleIndex,
+                             const char *topic);
+
+void publisherPostSample(Publisher *publisher, uint32_t sampleIndex,
+                         float value, uint64_t timestampNs);
+
+void publisherFlush(Publisher *publisher);
+
+uint32_t publisherGetSampleNumber(const Publisher *publisher,
+                                  uint32_t sampleIndex);
+
+void publisherSetSampleNumber(Publisher *publisher, uint32_t sampleIndex,
+                              uint32_t sampleNumber);
+
+int publisherPostMessage(Publisher *publisher, const char *topic,
+                         const void *payload, int payloadLength);
+
+uint32_t publisherMessageSpace(Publisher *publisher);
+
+void publisherGetStats(Publisher *publisher, PublisherStats *stats);
+
+int publisherFormatStats(Publisher *publisher, char *buffer, size_t size);
+
+void publisherStop(Publisher *publisher);
+
+#endif /* PUBLISHER_H */
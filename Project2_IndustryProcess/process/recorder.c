@@ -0,0 +1,110 @@
+/*******************************************************************************
+* Authors:
+*    Uros Cvjetinovic & Uros Popovic
+* @file
+* \brief Binary log of a closed-loop experiment, see recorder.h.
+*******************************************************************************/
+
+/******* include headers ******************************************************/
+#include <string.h>
+#include "recorder.h"
+
+/******* local macros *********************************************************/
+#define RECORDER_MAGIC          ((uint32_t) 0x474C5250u)  /* "PRLG" */
+#define RECORDER_VERSION        ((uint32_t) 2u)
+/* The tick thread only copies into this buffer, the disk sees large writes */
+#define RECORDER_BUFFERSIZE     ((size_t) 1u << 20)
+
+/******* definition of global functions ***************************************/
+int recorderCreate(Recorder *recorder, const char *path,
+                   const RecorderHeader *header)
+{
+  memset(recorder, 0, sizeof(*recorder));
+  recorder->header = *header;
+  recorder->header.magic = RECORDER_MAGIC;
+  recorder->header.version = RECORDER_VERSION;
+
+  recorder->file = fopen(path, "wb");
+  if (recorder->file == NULL)
+  {
+    return -1;
+  }
+  setvbuf(recorder->file, NULL, _IOFBF, RECORDER_BUFFERSIZE);
+
+  if (fwrite(&recorder->header, sizeof(recorder->header), 1u,
+             recorder->file) != 1u)
+  {
+    fclose(recorder->file);
+    recorder->file = NULL;
+    return -1;
+  }
+
+  return 0;
+}
+
+int recorderOpen(Recorder *recorder, const char *path)
+{
+  memset(recorder, 0, sizeof(*recorder));
+
+  recorder->file = fopen(path, "rb");
+  if (recorder->file == NULL)
+  {
+    return -1;
+  }
+  setvbuf(recorder->file, NULL, _IOFBF, RECORDER_BUFFERSIZE);
+
+  if ((fread(&recorder->header, sizeof(recorder->header), 1u,
+             recorder->file) != 1u) ||
+      (recorder->header.magic != RECORDER_MAGIC) ||
+      (recorder->header.version != RECORDER_VERSION))
+  {
+    fclose(recorder->file);
+    recorder->file = NULL;
+    return -1;
+  }
+
+  return 0;
+}
+
+void recorderWrite(Recorder *recorder, uint8_t type, uint32_t instance,
+                   uint64_t timeNs, float value, uint32_t extra)
+{
+  RecorderEvent event;
+
+  memset(&event, 0, sizeof(event));
+  event.type = type;
+  event.instance = instance;
+  event.timeNs = timeNs;
+  event.value = value;
+  event.extra = extra;
+
+  if (fwrite(&event, sizeof(event), 1u, recorder->file) == 1u)
+  {
+    recorder->events++;
+  }
+}
+
+/* Returns 1 for an event, 0 at the end of the log */
+int recorderRead(Recorder *recorder, RecorderEvent *event)
+{
+  if (fread(event, sizeof(*event), 1u, recorder->file) != 1u)
+  {
+    return 0;
+  }
+  recorder->events++;
+
+  return 1;
+}
+
+int recorderClose(Recorder *recorder)
+{
+  int result = 0;
+
+  if (recorder->file != NULL)
+  {
+    result = fclose(recorder->file);
+    recorder->file = NULL;
+  }
+
+  return (result == 0) ? 0 : -1;
+}
@@ -0,0 +1,75 @@
+/*******************************************************************************
+* Authors:
+*    Uros Cvjetinovic & Uros Popovic
+* @file
+* \brief Binary log of everything that drives a closed-loop experiment, so an
+*   experiment can be replayed offline, without broker and timers, and give
+*   exactly the same results. Per tick the log holds:
+*    - the tick itself (index, ideal deadline, missed deadlines)
+*    - set pressures and hysteresis corrections that arrived since the
+*      previous tick, in the order the tick applied them
+*    - the resulting pressure of every instance, to verify a replay
+*   The header describes the plant (instances, model, dead time, period)
+*   and the regulator (control law of all loops, encoding of its answers),
+*   the events are fixed size records in host byte order.
+*******************************************************************************/
+#ifndef RECORDER_H
+#define RECORDER_H
+
+/******* include headers ******************************************************/
+#include <stdint.h>
+#include <stdio.h>
+#include "controllaw.h"
+#include "lti.h"
+
+/******* global macros ********************************************************/
+#define RECORDER_TICK           ((uint8_t) 1u)
+#define RECORDER_SETPOINT       ((uint8_t) 2u)
+#define RECORDER_CORRECTION     ((uint8_t) 3u)
+#define RECORDER_OUTPUT         ((uint8_t) 4u)
+
+/******* type definitions *****************************************************/
+typedef struct
+{
+  uint32_t magic;
+  uint32_t version;
+  uint32_t count;
+  uint32_t delay;
+  uint64_t periodNs;
+  float initialOutput;
+  uint32_t payloadFlags;
+  LtiModel model;
+  ControlLawParameters law;
+} RecorderHeader;
+
+typedef struct
+{
+  uint8_t type;
+  uint8_t reserved[3];
+  uint32_t instance;    /* tick index for a tick */
+  uint64_t timeNs;      /* deadline of the tick the event belongs to */
+  float value;
+  uint32_t extra;       /* missed deadlines for a tick */
+} RecorderEvent;
+
+typedef struct
+{
+  FILE *file;
+  RecorderHeader header;
+  uint64_t events;
+} Recorder;
+
+/******* declaration of global functions **************************************/
+int recorderCreate(Recorder *recorder, const char *path,
+                   const RecorderHeader *header);
+
+int recorderOpen(Recorder *recorder, const char *path);
+
+void recorderWrite(Recorder *recorder, uint8_t type, uint32_t instance,
+                   uint64_t timeNs, float value, uint32_t extra);
+
+int recorderRead(Recorder *recorder, RecorderEvent *event);
+
+int recorderClose(Recorder *recorder);
+
+#endif /* RECORDER_H */
@@ -0,0 +1,76 @@
+/*******************************************************************************
+* Authors:
+*    Uros Cvjetinovic & Uros Popovic
+* @file
+* \brief Sampling quality of the process tick.
+*******************************************************************************/
+
+/******* include headers ******************************************************/
+#include <stdio.h>
+#include "tickstats.h"
+
+/******* local macros *********************************************************/
+#define STATSLINESIZE           ((uint32_t) 160u)
+
+/******* definition of global functions ***************************************/
+void tickStatsInit(TickStats *stats, uint64_t periodNs)
+{
+  stats->periodNs = periodNs;
+  stats->previousWakeNs = 0u;
+  stats->ticks = 0u;
+  stats->missedTicks = 0u;
+  histogramReset(&stats->jitter);
+  histogramReset(&stats->lateness);
+  histogramReset(&stats->body);
+}
+
+void tickStatsRecordTick(TickStats *stats, const SchedulerTick *tick)
+{
+  uint64_t interval;
+
+  /* The interval spanning missed deadlines is several periods long, it is
+     accounted in missedTicks and kept out of the jitter */
+  if ((stats->previousWakeNs != 0u) && (tick->missed == 0u))
+  {
+    interval = tick->wakeNs - stats->previousWakeNs;
+    histogramRecord(&stats->jitter, (interval > stats->periodNs) ?
+                                    (interval - stats->periodNs) :
+                                    (stats->periodNs - interval));
+  }
+  histogramRecord(&stats->lateness, tick->wakeNs - tick->deadlineNs);
+
+  stats->previousWakeNs = tick->wakeNs;
+  stats->ticks++;
+  stats->missedTicks += tick->missed;
+}
+
+void tickStatsRecordBody(TickStats *stats, uint64_t startNs, uint64_t endNs)
+{
+  histogramRecord(&stats->body, endNs - startNs);
+}
+
+int tickStatsFormat(const TickStats *stats, char *buffer, size_t size)
+{
+  char jitter[STATSLINESIZE];
+  char lateness[STATSLINESIZE];
+  char body[STATSLINESIZE];
+
+  histogramFormat(&stats->jitter, "jitter", jitter, sizeof(jitter));
+  histogramFormat(&stats->lateness, "lateness", lateness, sizeof(lateness));
+  histogramFormat(&stats->body, "body", body, sizeof(body));
+
+  return snprintf(buffer, size, "ticks=%llu missed=%llu\n%s\n%s\n%s",
+                  (unsigned long long)stats->ticks,
+                  (unsigned long long)stats->missedTicks,
+                  jitter, lateness, body);
+}
+
+void tickStatsPrint(const TickStats *stats)
+{
+  printf("Ticks: %llu, missed ticks: %llu\n",
+         (unsigned long long)stats->ticks,
+         (unsigned long long)stats->missedTicks);
+  histogramPrint(&stats->jitter, "Tick jitter");
+  histogramPrint(&stats->lateness, "Tick lateness");
+  histogramPrint(&stats->body, "Tick body");
+}
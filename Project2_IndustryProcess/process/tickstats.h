@@ -0,0 +1,42 @@
+/*******************************************************************************
+* Authors:
+*    Uros Cvjetinovic & Uros Popovic
+* @file
+* \brief Sampling quality of the process tick. For every tick it records the
+*   deviation of the tick-to-tick interval from the period (jitter), the delay
+*   of the wake-up after the ideal deadline (lateness) and the time spent in
+*   the tick body, publishing included.
+*******************************************************************************/
+#ifndef TICKSTATS_H
+#define TICKSTATS_H
+
+/******* include headers ******************************************************/
+#include <stddef.h>
+#include <stdint.h>
+#include "histogram.h"
+#include "scheduler.h"
+
+/******* type definitions *****************************************************/
+typedef struct
+{
+  uint64_t periodNs;
+  uint64_t previousWakeNs;
+  uint64_t ticks;
+  uint64_t missedTicks;
+  Histogram jitter;
+  Histogram lateness;
+  Histogram body;
+} TickStats;
+
+/******* declaration of global functions **************************************/
+void tickStatsInit(TickStats *stats, uint64_t periodNs);
+
+void tickStatsRecordTick(TickStats *stats, const SchedulerTick *tick);
+
+void tickStatsRecordBody(TickStats *stats, uint64_t startNs, uint64_t endNs);
+
+int tickStatsFormat(const TickStats *stats, char *buffer, size_t size);
+
+void tickStatsPrint(const TickStats *stats);
+
+#endif /* TICKSTATS_H */
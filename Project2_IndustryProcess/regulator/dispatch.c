@@ -0,0 +1,240 @@
+/*******************************************************************************
+* Authors:
+*    Uros Popovic & Uros Cvjetinovic
+* @file
+* \brief Message handling shared by both regulators, see dispatch.h.
+*******************************************************************************/
+
+/******* include headers ******************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include "controllaw.h"
+#include "dispatch.h"
+#include "timebase.h"
+
+/******* local macros *********************************************************/
+#define LOOPS                   ((uint32_t) 1u)
+#define REFRESHPERIOD           10L
+
+/* Handlers of the routed topics */
+#define ROUTE_Y                 ((uint32_t) 0u)
+#define ROUTE_Y_LOOP            ((uint32_t) 1u)
+#define ROUTE_Y_BATCH           ((uint32_t) 2u)
+#define ROUTE_YZ                ((uint32_t) 3u)
+#define ROUTE_YZ_LOOP           ((uint32_t) 4u)
+
+/******* definition of global functions ***************************************/
+void dispatchOptionsInit(DispatchOptions *options)
+{
+  options->loops = LOOPS;
+  options->transitionsOnly = 0u;
+  options->refreshPeriod = REFRESHPERIOD;
+  options->lawSpec = NULL;
+  options->lawFile = NULL;
+}
+
+/* Returns 1 when the option is one of DISPATCH_OPTIONS */
+int dispatchParseOption(DispatchOptions *options, int option,
+                        const char *argument)
+{
+  switch (option)
+  {
+    case 'n':
+      options->loops = (uint32_t)strtoul(argument, NULL, 10);
+      return 1;
+    case 't':
+      options->transitionsOnly = 1u;
+      return 1;
+    case 'f':
+      options->refreshPeriod = strtol(argument, NULL, 10);
+      return 1;
+    case 'l':
+      options->lawSpec = argument;
+      return 1;
+    case 'L':
+      options->lawFile = argument;
+      return 1;
+    default:
+      return 0;
+  }
+}
+
+/* Creates the loops answering on DISPATCH_TOPIC_X/i with the law of all
+   loops, then the laws of the file, and prints what went wrong */
+int dispatchLoadLoops(LoopTable *table, const DispatchOptions *options)
+{
+  ControlLawParameters law;
+  int result;
+
+  controlLawDefaults(&law, CONTROLLAW_HYSTERESIS);
+  if ((options->lawSpec != NULL) &&
+      (controlLawParse(options->lawSpec, &law) != 0))
+  {
+    printf("Invalid control law \"%s\", expected \"hysteresis|pid|bangbang"
+           " [band=|kp=|ki=|kd=|ts=|min=|max=|dwell=<value> ...]\"\n",
+           options->lawSpec);
+    return -1;
+  }
+  if (options->transitionsOnly && (options->refreshPeriod <= 0))
+  {
+    printf("The refresh period must be at least 1 s\n");
+    return -1;
+  }
+  if (loopTableInit(table, options->loops, &law, DISPATCH_TOPIC_X) != 0)
+  {
+    printf("Failed to allocate %u control loops\n", options->loops);
+    return -1;
+  }
+  if (options->lawFile != NULL)
+  {
+    result = loopTableLoadLaws(table, options->lawFile);
+    if (result != 0)
+    {
+      printf((result < 0) ? "Failed to open %s\n" :
+                            "Invalid control law in %s line %d\n",
+             options->lawFile, result);
+      loopTableFree(table);
+      return -1;
+    }
+  }
+  if (options->transitionsOnly)
+  {
+    loopTableSetTransitionsOnly(table, (uint64_t)options->refreshPeriod *
+                                       TIMEBASE_NS_PER_S);
+  }
+
+  return 0;
+}
+
+int dispatcherInit(Dispatcher *dispatcher, LoopTable *table,
+                   DispatchSendCallback send, void *context)
+{
+  dispatcher->table = table;
+  dispatcher->send = send;
+  dispatcher->context = context;
+  topicRouterInit(&dispatcher->router);
+
+  return topicRouterAdd(&dispatcher->router, DISPATCH_TOPIC_Y, ROUTE_Y) |
+         topicRouterAddFamily(&dispatcher->router, DISPATCH_TOPIC_Y,
+                              ROUTE_Y_LOOP) |
+         topicRouterAdd(&dispatcher->router, DISPATCH_TOPIC_Y_BATCH,
+                        ROUTE_Y_BATCH) |
+         topicRouterAdd(&dispatcher->router, DISPATCH_TOPIC_YZ, ROUTE_YZ) |
+         topicRouterAddFamily(&dispatcher->router, DISPATCH_TOPIC_YZ,
+                              ROUTE_YZ_LOOP);
+}
+
+void dispatcherHandleSample(Dispatcher *dispatcher, uint32_t loop,
+                            const PayloadSample *sample,
+                            const char *replyTopic, uint64_t arrivalNs)
+{
+  LoopTable *table = dispatcher->table;
+  ControlLoop *control = &table->loops[loop];
+  uint64_t decidedNs;
+  int changed;
+
+  if (!loopTableAcceptSample(table, loop, sample))
+  {
+    return;
+  }
+  /* Dwell times of a process in virtual time run on its clock */
+  changed = controlLoopUpdate(control, sample->value,
+                              ((sample->flags & PAYLOAD_TIMESTAMP) != 0u) ?
+                              (sample->timestampUs * TIMEBASE_NS_PER_US) :
+                              arrivalNs);
+  decidedNs = timebaseNowNs();
+  table->decisions++;
+  histogramRecord(&table->decisionLatency, decidedNs - arrivalNs);
+
+  /* Within bounds the output is kept, repeating it only releases a waiting
+     process */
+  if (loopTableShouldPublish(table, loop, sample, changed, arrivalNs))
+  {
+    dispatcher->send(dispatcher->context, control->output, sample,
+                     replyTopic, decidedNs);
+    table->published++;
+    histogramRecord(&table->publishLatency, timebaseNowNs() - decidedNs);
+  }
+}
+
+void dispatcherHandleBatch(Dispatcher *dispatcher, const void *payload,
+                           int payloadLength, uint64_t arrivalNs)
+{
+  LoopTable *table = dispatcher->table;
+  PayloadBatchReader reader;
+  PayloadSample sample;
+  uint32_t instance = 0u;
+
+  if (payloadBatchOpen(&reader, payload, payloadLength) != 0)
+  {
+    table->malformed++;
+    return;
+  }
+
+  while (payloadBatchNext(&reader, &instance, &sample) == 1)
+  {
+    if (instance < table->count)
+    {
+      dispatcherHandleSample(dispatcher, instance, &sample,
+                             table->replyTopics[instance], arrivalNs);
+    }
+    else
+    {
+      table->unknown++;
+    }
+  }
+}
+
+/* Routes one message to its handler and loop, both are found in constant
+   time from the topic; samples are parsed in place, nothing is copied or
+   allocated per message */
+void dispatcherHandleMessage(Dispatcher *dispatcher, const char *topicName,
+                             size_t topicLength, const void *payload,
+                             int payloadLength, uint64_t arrivalNs)
+{
+  LoopTable *table = dispatcher->table;
+  PayloadSample sample;
+  uint32_t loop = 0u;
+  uint32_t route = topicRouterFind(&dispatcher->router, topicName,
+                                   topicLength, &loop);
+
+  if (((route == ROUTE_Y_LOOP) || (route == ROUTE_YZ_LOOP)) &&
+      (loop >= table->count))
+  {
+    table->unknown++;
+    return;
+  }
+  if (route == ROUTE_Y_BATCH)
+  {
+    dispatcherHandleBatch(dispatcher, payload, payloadLength, arrivalNs);
+    return;
+  }
+  if (route == TOPICROUTER_NONE)
+  {
+    return;
+  }
+  if (payloadDecode(payload, payloadLength, &sample) != 0)
+  {
+    table->malformed++;
+    return;
+  }
+
+  switch (route)
+  {
+    case ROUTE_Y:
+    case ROUTE_Y_LOOP:
+      dispatcherHandleSample(dispatcher, loop, &sample,
+                             (route == ROUTE_Y) ?
+                             DISPATCH_TOPIC_X : table->replyTopics[loop],
+                             arrivalNs);
+      break;
+    case ROUTE_YZ:
+      loopTableSetAllSetpoints(table, sample.value);
+      break;
+    case ROUTE_YZ_LOOP:
+      loopTableSetSetpoint(table, loop, sample.value);
+      break;
+    default:
+      break;
+  }
+}
@@ -0,0 +1,81 @@
+/*******************************************************************************
+* Authors:
+*    Uros Popovic & Uros Cvjetinovic
+* @file
+* \brief Message handling shared by the regulator and the asynchronous
+*   regulator: the topics are routed to their handler and loop, pressures
+*   decide the output of their loop (looptable.h), batch frames are unpacked
+*   and set pressures change one or all loops. Only sending an answer
+*   differs, each regulator hands it to its own client through the send
+*   callback.
+*   The options of the loops are parsed and applied here as well, so both
+*   regulators understand "-n", "-t", "-f", "-l" and "-L" alike.
+*******************************************************************************/
+#ifndef DISPATCH_H
+#define DISPATCH_H
+
+/******* include headers ******************************************************/
+#include <stddef.h>
+#include <stdint.h>
+#include "looptable.h"
+#include "payload.h"
+#include "topicrouter.h"
+
+/******* global macros ********************************************************/
+#define DISPATCH_TOPIC_Y        "CurrentPressure"
+#define DISPATCH_TOPIC_Y_BATCH  "CurrentPressureBatch"
+#define DISPATCH_TOPIC_YZ       "SetPressure"
+#define DISPATCH_TOPIC_X        "HysteresisCorrection"
+#define DISPATCH_OPTIONS        "n:tf:l:L:"
+#define DISPATCH_USAGE          "[-n number of loops] [-t answer transitions" \
+                                " only [-f refresh period in s]]"             \
+                                " [-l law of all loops]"                      \
+                                " [-L file of laws per loop]"
+
+/******* type definitions *****************************************************/
+/* Called on the thread that handles the message, decidedNs is the time the
+   output was decided */
+typedef void (*DispatchSendCallback)(void *context, float output,
+                                     const PayloadSample *cause,
+                                     const char *topic, uint64_t decidedNs);
+
+typedef struct
+{
+  uint32_t loops;
+  uint32_t transitionsOnly;
+  long refreshPeriod;
+  const char *lawSpec;
+  const char *lawFile;
+} DispatchOptions;
+
+typedef struct
+{
+  LoopTable *table;
+  TopicRouter router;
+  DispatchSendCallback send;
+  void *context;
+} Dispatcher;
+
+/******* declaration of global functions **************************************/
+void dispatchOptionsInit(DispatchOptions *options);
+
+int dispatchParseOption(DispatchOptions *options, int option,
+                        const char *argument);
+
+int dispatchLoadLoops(LoopTable *table, const DispatchOptions *options);
+
+int dispatcherInit(Dispatcher *dispatcher, LoopTable *table,
+                   DispatchSendCallback send, void *context);
+
+void dispatcherHandleSample(Dispatcher *dispatcher, uint32_t loop,
+                            const PayloadSample *sample,
+                            const char *replyTopic, uint64_t arrivalNs);
+
+void dispatcherHandleBatch(Dispatcher *dispatcher, const void *payload,
+                           int payloadLength, uint64_t arrivalNs);
+
+void dispatcherHandleMessage(Dispatcher *dispatcher, const char *topicName,
+                             size_t topicLength, const void *payload,
+                             int payloadLength, uint64_t arrivalNs);
+
+#endif /* DISPATCH_H */
@@ -0,0 +1,308 @@
+/*******************************************************************************
+* Authors:
+*    Uros Popovic & Uros Cvjetinovic
+* @file
+* \brief State of every control loop hosted by the regulator, see
+*   looptable.h.
+*******************************************************************************/
+
+/******* include headers ******************************************************/
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "looptable.h"
+
+#if defined(_WIN32)
+#include <malloc.h>
+#endif
+
+/******* local macros *********************************************************/
+#define LOOPTABLE_LINESIZE      ((uint32_t) 256u)
+#define LOOPTABLE_LINEBYTES     ((size_t) 64u)
+
+/******* declaration of local functions ***************************************/
+static ControlLoop *allocateLoops(uint32_t count);
+
+static void freeLoops(ControlLoop *loops);
+
+/******* definition of local functions ****************************************/
+/* Zeroed loops starting on a cache line, sizeof(ControlLoop) is one line so
+   none of them straddles two */
+static ControlLoop *allocateLoops(uint32_t count)
+{
+  size_t size = (size_t)count * sizeof(ControlLoop);
+  ControlLoop *loops;
+
+#if defined(_WIN32)
+  loops = (ControlLoop *)_aligned_malloc(size, LOOPTABLE_LINEBYTES);
+#else
+  loops = (ControlLoop *)aligned_alloc(LOOPTABLE_LINEBYTES, size);
+#endif
+  if (loops != NULL)
+  {
+    memset(loops, 0, size);
+  }
+
+  return loops;
+}
+
+static void freeLoops(ControlLoop *loops)
+{
+#if defined(_WIN32)
+  _aligned_free(loops);
+#else
+  free(loops);
+#endif
+}
+
+/******* definition of global functions ***************************************/
+int loopTableInit(LoopTable *table, uint32_t count,
+                  const ControlLawParameters *law, const char *replyPrefix)
+{
+  uint32_t loop;
+
+  memset(table, 0, sizeof(*table));
+  table->count = count;
+  table->loops = (count > 0u) ? allocateLoops(count) : NULL;
+  table->reports = (LoopReport *)calloc(count, sizeof(LoopReport));
+  table->replyTopics = calloc(count, LOOPTABLE_TOPICSIZE);
+  if ((count == 0u) || (table->loops == NULL) || (table->reports == NULL) ||
+      (table->replyTopics == NULL))
+  {
+    loopTableFree(table);
+    return -1;
+  }
+
+  /* Answer topics are formatted once here instead of for every decision */
+  for (loop = 0u; loop < count; loop++)
+  {
+    controlLoopConfigure(&table->loops[loop], law);
+    snprintf(table->replyTopics[loop], LOOPTABLE_TOPICSIZE, "%s/%u",
+             replyPrefix, loop);
+  }
+  histogramReset(&table->decisionLatency);
+  histogramReset(&table->publishLatency);
+
+  return 0;
+}
+
+void loopTableConfigure(LoopTable *table, uint32_t first, uint32_t last,
+                        const ControlLawParameters *law)
+{
+  uint32_t loop;
+
+  for (loop = first; (loop <= last) && (loop < table->count); loop++)
+  {
+    controlLoopConfigure(&table->loops[loop], law);
+  }
+}
+
+/* Returns the number of the first bad line, 0 when all lines were taken */
+int loopTableLoadLaws(LoopTable *table, const char *path)
+{
+  FILE *file = fopen(path, "r");
+  ControlLawParameters law;
+  char line[LOOPTABLE_LINESIZE];
+  char *text;
+  char *end;
+  unsigned long first;
+  unsigned long last;
+  int lineNumber = 0;
+  int invalid = 0;
+
+  if (file == NULL)
+  {
+    return -1;
+  }
+
+  while (fgets(line, sizeof(line), file) != NULL)
+  {
+    lineNumber++;
+    line[strcspn(line, "#\r\n")] = '\0';
+    text = line + strspn(line, " \t");
+    if (*text == '\0')
+    {
+      continue;
+    }
+
+    /* Stays set when the line breaks out of the loop */
+    invalid = lineNumber;
+    if (*text == '*')
+    {
+      first = 0u;
+      last = ULONG_MAX;
+      end = text + 1;
+    }
+    else
+    {
+      first = strtoul(text, &end, 10);
+      last = first;
+      if (end == text)
+      {
+        break;
+      }
+      if (*end == '-')
+      {
+        text = end + 1;
+        last = strtoul(text, &end, 10);
+        if ((end == text) || (last < first))
+        {
+          break;
+        }
+      }
+    }
+    if (((*end != ' ') && (*end != '\t')) ||
+        (controlLawParse(end + strspn(end, " \t"), &law) != 0))
+    {
+      break;
+    }
+    loopTableConfigure(table, (uint32_t)first,
+                       (last > UINT32_MAX) ? UINT32_MAX : (uint32_t)last, &law);
+    invalid = 0;
+  }
+  fclose(file);
+
+  return invalid;
+}
+
+void loopTableSetTransitionsOnly(LoopTable *table, uint64_t refreshNs)
+{
+  table->transitionsOnly = 1u;
+  table->refreshNs = refreshNs;
+}
+
+/* Returns 0 for a sample that arrived after a newer one of its loop, in
+   transition mode only, the plain mode acts on every sample */
+int loopTableAcceptSample(LoopTable *table, uint32_t loop,
+                          const PayloadSample *sample)
+{
+  LoopReport *report = &table->reports[loop];
+  int32_t distance;
+
+  if (!table->transitionsOnly || ((sample->flags & PAYLOAD_SEQUENCE) == 0u))
+  {
+    return 1;
+  }
+
+  distance = (int32_t)(sample->sequence - report->sequence);
+  /* Sample numbers start at 1, 0 means none was seen yet */
+  if ((report->sequence != 0u) && (distance <= 0) &&
+      (distance > -LOOPTABLE_STALEWINDOW))
+  {
+    table->stale++;
+    return 0;
+  }
+  report->sequence = sample->sequence;
+
+  return 1;
+}
+
+/* A process waiting in virtual time is always answered. Otherwise the plain
+   mode answers whenever the pressure is outside the band, the transition
+   mode only when the output differs from the last answer or the refresh
+   period passed. */
+int loopTableShouldPublish(LoopTable *table, uint32_t loop,
+                           const PayloadSample *sample, int changed,
+                           uint64_t nowNs)
+{
+  LoopReport *report = &table->reports[loop];
+  float output = table->loops[loop].output;
+  int publish;
+
+  if ((sample->flags & PAYLOAD_TIMESTAMP) != 0u)
+  {
+    publish = 1;
+  }
+  else if (!table->transitionsOnly)
+  {
+    publish = changed;
+  }
+  else if ((report->publishedNs == 0u) || (output != report->commanded))
+  {
+    publish = 1;
+  }
+  else if ((nowNs - report->publishedNs) >= table->refreshNs)
+  {
+    publish = 1;
+    table->refreshes++;
+  }
+  else
+  {
+    publish = 0;
+    table->suppressed += (changed != 0) ? 1u : 0u;
+  }
+
+  if (publish)
+  {
+    report->commanded = output;
+    report->publishedNs = nowNs;
+  }
+
+  return publish;
+}
+
+void loopTableSetSetpoint(LoopTable *table, uint32_t loop, float setpoint)
+{
+  table->loops[loop].setpoint = setpoint;
+  table->setpoints++;
+}
+
+void loopTableSetAllSetpoints(LoopTable *table, float setpoint)
+{
+  uint32_t loop;
+
+  for (loop = 0u; loop < table->count; loop++)
+  {
+    table->loops[loop].setpoint = setpoint;
+  }
+  table->setpoints++;
+}
+
+int loopTableFormatStats(const LoopTable *table, char *buffer, size_t size)
+{
+  char decisionLine[160];
+  char publishLine[160];
+  uint32_t laws[CONTROLLAW_COUNT] = {0u};
+  uint32_t loop;
+
+  for (loop = 0u; loop < table->count; loop++)
+  {
+    laws[table->loops[loop].law]++;
+  }
+
+  histogramFormat(&table->decisionLatency, "decision", decisionLine,
+                  sizeof(decisionLine));
+  histogramFormat(&table->publishLatency, "publish", publishLine,
+                  sizeof(publishLine));
+
+  return snprintf(buffer, size,
+                  "loops: count=%u decisions=%llu published=%llu "
+                  "setpoints=%llu unknown=%llu malformed=%llu suppressed=%llu "
+                  "refreshes=%llu stale=%llu %s=%u %s=%u %s=%u %s %s",
+                  table->count,
+                  (unsigned long long)table->decisions,
+                  (unsigned long long)table->published,
+                  (unsigned long long)table->setpoints,
+                  (unsigned long long)table->unknown,
+                  (unsigned long long)table->malformed,
+                  (unsigned long long)table->suppressed,
+                  (unsigned long long)table->refreshes,
+                  (unsigned long long)table->stale,
+                  controlLawName(CONTROLLAW_HYSTERESIS),
+                  laws[CONTROLLAW_HYSTERESIS],
+                  controlLawName(CONTROLLAW_PID), laws[CONTROLLAW_PID],
+                  controlLawName(CONTROLLAW_BANGBANG),
+                  laws[CONTROLLAW_BANGBANG],
+                  decisionLine, publishLine);
+}
+
+void loopTableFree(LoopTable *table)
+{
+  freeLoops(table->loops);
+  free(table->reports);
+  free(table->replyTopics);
+  table->loops = NULL;
+  table->reports = NULL;
+  table->replyTopics = NULL;
+}
@@ -0,0 +1,92 @@
+/*******************************************************************************
+* Authors:
+*    Uros Popovic & Uros Cvjetinovic
+* @file
+* \brief State of every control loop hosted by the regulator. Loop i is the
+*   process instance publishing CurrentPressure/i and is answered on
+*   HysteresisCorrection/i. The loops are one contiguous array indexed by the
+*   instance number, so a message reaches its loop without any search, and
+*   the control state of each loop is one cache line of its own.
+*   In transition mode a loop answers only when its output changes, or when
+*   the refresh period passed since its last answer, so a lost answer is
+*   repaired. In this mode samples with a sequence number older than the
+*   newest one seen arrived out of order and are not acted upon.
+*   Every loop runs its own control law, see controllaw.h; a law file assigns
+*   laws to ranges of loops with lines "<first>[-<last>] <law spec>" or
+*   "* <law spec>", later lines override earlier ones and '#' starts a
+*   comment.
+*   Only the MQTT client thread changes the table; the statistics may be read
+*   from another thread and are then approximate.
+*******************************************************************************/
+#ifndef LOOPTABLE_H
+#define LOOPTABLE_H
+
+/******* include headers ******************************************************/
+#include <stddef.h>
+#include <stdint.h>
+#include "histogram.h"
+#include "controllaw.h"
+#include "payload.h"
+
+/******* global macros ********************************************************/
+#define LOOPTABLE_TOPICSIZE     ((uint32_t) 32u)
+/* Samples overtaken by at most this many newer ones are stale, a sequence
+   number further behind is a restarted process, which then loses at most
+   this many samples */
+#define LOOPTABLE_STALEWINDOW   ((int32_t) 8)
+
+/******* type definitions *****************************************************/
+typedef struct
+{
+  float commanded;              /* output of the last answer */
+  uint32_t sequence;            /* newest sample sequence number, 0 none */
+  uint64_t publishedNs;         /* time of the last answer, 0 before it */
+} LoopReport;
+
+typedef struct
+{
+  uint32_t count;
+  ControlLoop *loops;
+  LoopReport *reports;
+  char (*replyTopics)[LOOPTABLE_TOPICSIZE];
+  uint64_t decisions;
+  uint64_t published;
+  uint64_t setpoints;
+  uint64_t unknown;             /* messages for a loop beyond count */
+  uint64_t malformed;
+  uint32_t transitionsOnly;
+  uint64_t refreshNs;
+  uint64_t suppressed;          /* answers the plain mode would have sent */
+  uint64_t refreshes;
+  uint64_t stale;               /* samples older than the newest one */
+  Histogram decisionLatency;    /* message arrival to decision taken */
+  Histogram publishLatency;     /* decision taken to answer handed over */
+} LoopTable;
+
+/******* declaration of global functions **************************************/
+int loopTableInit(LoopTable *table, uint32_t count,
+                  const ControlLawParameters *law, const char *replyPrefix);
+
+void loopTableConfigure(LoopTable *table, uint32_t first, uint32_t last,
+                        const ControlLawParameters *law);
+
+int loopTableLoadLaws(LoopTable *table, const char *path);
+
+void loopTableSetTransitionsOnly(LoopTable *table, uint64_t refreshNs);
+
+int loopTableAcceptSample(LoopTable *table, uint32_t loop,
+                          const PayloadSample *sample);
+
+int loopTableShouldPublish(LoopTable *table, uint32_t loop,
+                           const PayloadSample *sample, int changed,
+                           uint64_t nowNs);
+
+void loopTableSetSetpoint(LoopTable *table, uint32_t loop, float setpoint);
+
+void loopTableSetAllSetpoints(LoopTable *table, float setpoint);
+
+int loopTableFormatStats(const LoopTable *table, char *buffer, size_t size);
+
+void loopTableFree(LoopTable *table);
+
+#endif /* LOOPTABLE_H */
@@ -4,119 +4,165 @@
 * @file
 * \brief This program is used to monitor and publish the hysteresis correction
 *   value
+*   One regulator hosts many control loops (looptable.h): a pressure on
+*   CurrentPressure/i is answered on HysteresisCorrection/i with the set
+*   pressure of SetPressure/i, SetPressure sets all loops at once. The plain
+*   CurrentPressure topic is loop 0 and is answered on HysteresisCorrection.
+*   A pressure sample that carries a simulated timestamp comes from a process
+*   running in virtual time, which waits for an answer to every sample. Such
+*   samples are always answered, with the timestamp echoed back.
+*   Answers use the encoding of the sample they answer, text or binary, and
+*   echo its sequence number, and the correlation id and send time of a traced
+*   sample, when it has them.
+*   Batched pressure frames are unpacked and every sample is handled as if it
+*   had arrived on CurrentPressure/i. The handling of the messages and the
+*   options of the loops are shared with regulator_async (dispatch.h).
+*   Messages are handled on the MQTT client thread. The main thread sleeps in
+*   an event loop (eventloop.h) that is woken only when the connection is lost
+*   or Ctrl+C is pressed, and once a minute to print statistics.
+*   With "-t" an answer is only sent when the output of a loop changes, and
+*   every "-f" seconds as a refresh (looptable.h).
+*   Each loop runs a control law (controllaw.h): "-l" selects the law of all
+*   loops, e.g. -l "pid kp=4 ki=0.2", and "-L <file>" the laws of ranges of
+*   loops (looptable.h).
+*   "-B <messages>" feeds generated samples through the same path without a
+*   broker and reports decisions per second, i.e. loops per core.
 *******************************************************************************/
 
 /******* include headers ******************************************************/
+#include <signal.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 #include "MQTTClient.h"
+#include "controllaw.h"
+#include "dispatch.h"
+#include "eventloop.h"
+#include "looptable.h"
+#include "payload.h"
+#include "timebase.h"
 
 /******* local macros *********************************************************/
 #define ADDRESS         "tcp://broker.hivemq.com:1883"
 #define CLIENTID        "Regulator"
-#define TOPIC_Y         "CurrentPressure"
-#define TOPIC_YZ        "SetPressure"
-#define TOPIC_X	        "HysteresisCorrection"
+#define TOPIC_Y         DISPATCH_TOPIC_Y
+#define TOPIC_Y_BATCH   DISPATCH_TOPIC_Y_BATCH
+#define TOPIC_YZ        DISPATCH_TOPIC_YZ
+#define TOPIC_Y_ALL     TOPIC_Y "/+"
+#define TOPIC_YZ_ALL    TOPIC_YZ "/+"
 #define QOS             0
 #define TIMEOUT         10000L
-#define PAYLOADSIZE     ((uint32_t) 50u)
-#define DELTA_P		      ((uint32_t) 1u)
+#define PAYLOADSIZE     PAYLOAD_TEXTSIZE
+#define STATSPERIOD     ((uint64_t) 60u * TIMEBASE_NS_PER_S)
+#define EVENT_CONNECTIONLOST    ((uint32_t) 1u)
+#define EVENT_STOP              ((uint32_t) 2u)
+#define BENCHMARKPAYLOADS       ((uint32_t) 256u)
 #define DEBUGLOG        0
 
 /******* local data objects ***************************************************/
 MQTTClient client;
 
-uint32_t connectionLost = 0;
-float pressureValueToSet = 0;
-float currentPressureValue = 0;
+EventLoop eventLoop;
+LoopTable loopTable;
+Dispatcher dispatcher;
+atomic_ullong messagesArrived;
+uint32_t benchmarking = 0u;
 
 /******* declaration of local functions ***************************************/
-void updateHysteresisControlValue(float hysteresisControlToSet);
+void updateHysteresisControlValue(void *context,
+                                  float hysteresisControlToSet,
+                                  const PayloadSample *cause,
+                                  const char *topic, uint64_t decidedNs);
 
-int messageArrived(void *context, char *topicName, int topicLen,
-                   MQTTClient_message *message);
+int decodeSampleCopy(const void *payload, int payloadLength,
+                     PayloadSample *sample);
 
-void handleCurrentPressureTopic(float pressureValue);
-
-void handleSetPressureTopic(float pressureValue);
+int messageArrivedHandler(void *context, char *topicName, int topicLen,
+                          MQTTClient_message *message);
 
 void connectionLostHandler(void *context, char *cause);
 
-int main(void);
+void stopHandler(int signalNumber);
+
+void printStats(void *context, uint64_t nowNs);
+
+int runBenchmark(uint32_t messages);
+
+int main(int argc, char* argv[]);
 
 /******* definition of local functions ****************************************/
-void updateHysteresisControlValue(float hysteresisControlToSet) 
+/* Send callback of the dispatcher (dispatch.h) */
+void updateHysteresisControlValue(void *context,
+                                  float hysteresisControlToSet,
+                                  const PayloadSample *cause,
+                                  const char *topic, uint64_t decidedNs)
 {
   char payload_x[PAYLOADSIZE];
+  PayloadSample sample;
   MQTTClient_message publishMessage = MQTTClient_message_initializer;
 #if (DEBUGLOG)
-  printf("Hysteresis control update %f\n", hysteresisControlToSet);
+  printf("Hysteresis control update %f on %s\n", hysteresisControlToSet,
+         topic);
 #endif
 
-  snprintf(payload_x, sizeof(payload_x), "%.2f", hysteresisControlToSet);
+  sample.value = hysteresisControlToSet;
+  sample.flags = cause->flags & (PAYLOAD_TIMESTAMP | PAYLOAD_SEQUENCE |
+                                 PAYLOAD_TRACE | PAYLOAD_BINARY);
+  sample.sequence = cause->sequence;
+  sample.correlation = cause->correlation;
+  sample.timestampUs = cause->timestampUs;
+  sample.sentUs = cause->sentUs;
+
   publishMessage.payload = payload_x;
-  publishMessage.payloadlen = strlen(payload_x);
+  publishMessage.payloadlen = payloadEncode(&sample, payload_x,
+                                            sizeof(payload_x));
   publishMessage.qos = QOS;
   publishMessage.retained = 0;
-  
-  MQTTClient_publishMessage(client, TOPIC_X, &publishMessage, NULL);
-}
 
-void handleCurrentPressureTopic(float pressureValue) 
-{
-  currentPressureValue = pressureValue;
-#if (DEBUGLOG)
-  printf("Current pressure: %f\n", currentPressureValue);
-  printf("Pressure to set: %f\n", pressureValueToSet);
-  printf("Pressure difference: %f\n", currentPressureValue - pressureValueToSet);
-#endif
-  if ((pressureValueToSet > currentPressureValue) && 
-      ((pressureValueToSet - currentPressureValue) > DELTA_P))
+  if (!benchmarking)
   {
-    updateHysteresisControlValue(100u);
-  } 
-  else if ((pressureValueToSet < currentPressureValue) &&
-           ((currentPressureValue - pressureValueToSet) > DELTA_P))
-  {
-    updateHysteresisControlValue(0u);
+    MQTTClient_publishMessage(client, topic, &publishMessage, NULL);
   }
 }
 
-void handleSetPressureTopic(float pressureValue) 
+/* Copy and conversion of every text message before the in place parser, kept
+   only for the benchmark */
+int decodeSampleCopy(const void *payload, int payloadLength,
+                     PayloadSample *sample)
 {
-#if (DEBUGLOG)
-  printf("SetPressure: %f\n", pressureValue);
-#endif
-  pressureValueToSet = pressureValue;
+  char* text = (char*) malloc(payloadLength + 1);
+
+  if (text == NULL)
+  {
+    return -1;
+  }
+  memcpy(text, payload, payloadLength);
+  text[payloadLength] = '\0';
+  sample->value = (float)atof(text);
+  sample->flags = 0u;
+  free(text);
+
+  return 0;
 }
 
 int messageArrivedHandler(void *context, char *topicName, int topicLen,
-                          MQTTClient_message *message) 
+                          MQTTClient_message *message)
 {
-  char* payload = (char*) malloc(message->payloadlen + 1);
-  double messageValue;
+  uint64_t arrivalNs = timebaseNowNs();
 
-  printf("Message arrived on topic: %s\n", topicName);
-
-  memcpy(payload, message->payload, message->payloadlen);
-  payload[message->payloadlen] = '\0';
-  messageValue = atof(payload);
-  
 #if (DEBUGLOG)
-  printf("Received message: %s\n", payload);
-  printf("Converted float: %f\n", messageValue);
+  printf("Message arrived on topic: %s\n", topicName);
 #endif
+  atomic_fetch_add_explicit(&messagesArrived, 1u, memory_order_relaxed);
 
-  if (strcmp(topicName, TOPIC_Y) == 0)
-  {
-    handleCurrentPressureTopic(messageValue);
-  } 
-  else if (strcmp(topicName, TOPIC_YZ) == 0) 
-  {
-    handleSetPressureTopic(messageValue);
-  }
+  /* The client passes 0 unless the topic contains a null character */
+  dispatcherHandleMessage(&dispatcher, topicName,
+                          (topicLen > 0) ? (size_t)topicLen :
+                                           strlen(topicName),
+                          message->payload, message->payloadlen, arrivalNs);
 
   MQTTClient_freeMessage(&message);
   MQTTClient_free(topicName);
@@ -124,24 +170,206 @@ int messageArrivedHandler(void *context, char *topicName, int topicLen,
   return 1;
 }
 
-void connectionLostHandler(void *context, char *cause) 
+void connectionLostHandler(void *context, char *cause)
 {
-  connectionLost = 1u;
 #if (DEBUGLOG)
   printf("\nConnection lost\n");
   printf("-Cause: %s\n", cause);
 #endif
+  eventLoopSignal(&eventLoop, EVENT_CONNECTIONLOST);
 }
 
-int main() 
+void stopHandler(int signalNumber)
+{
+  eventLoopSignal(&eventLoop, EVENT_STOP);
+}
+
+void printStats(void *context, uint64_t nowNs)
+{
+  char statsLine[512];
+  char loopsLine[512];
+
+  eventLoopFormatStats(&eventLoop, statsLine, sizeof(statsLine));
+  loopTableFormatStats(&loopTable, loopsLine, sizeof(loopsLine));
+  printf("messages=%llu %s\n%s\n",
+         (unsigned long long)atomic_load(&messagesArrived), statsLine,
+         loopsLine);
+}
+
+/* Feeds text samples round robin to all loops through the dispatcher, as the
+   client thread would, without publishing the answers */
+int runBenchmark(uint32_t messages)
+{
+  char (*topics)[LOOPTABLE_TOPICSIZE];
+  char payloads[BENCHMARKPAYLOADS][PAYLOADSIZE];
+  int payloadLengths[BENCHMARKPAYLOADS];
+  size_t *topicLengths;
+  uint64_t startNs;
+  uint64_t elapsedNs;
+  uint32_t index;
+  uint32_t loop = 0u;
+  uint32_t step = 0u;
+  char loopsLine[512];
+  PayloadSample sample;
+  uint64_t copyNs;
+  uint64_t inPlaceNs;
+  uint64_t lawNs;
+  float checksum = 0.0f;
+  float pressures[BENCHMARKPAYLOADS];
+
+  topics = calloc(loopTable.count, LOOPTABLE_TOPICSIZE);
+  topicLengths = (size_t *)calloc(loopTable.count, sizeof(size_t));
+  if ((topics == NULL) || (topicLengths == NULL))
+  {
+    free(topics);
+    free(topicLengths);
+    return -1;
+  }
+
+  for (loop = 0u; loop < loopTable.count; loop++)
+  {
+    snprintf(topics[loop], LOOPTABLE_TOPICSIZE, "%s/%u", TOPIC_Y, loop);
+    topicLengths[loop] = strlen(topics[loop]);
+  }
+  /* Every loop sweeps its pressure slowly through the band, one step per
+     round over all loops, so its output switches now and then */
+  for (index = 0u; index < BENCHMARKPAYLOADS; index++)
+  {
+    pressures[index] = 45.0f + (10.0f * index) / BENCHMARKPAYLOADS;
+    payloadLengths[index] = snprintf(payloads[index], PAYLOADSIZE, "%.2f",
+                                     pressures[index]);
+  }
+
+  /* Parsing alone, the former copy and atof against the in place parser */
+  startNs = timebaseNowNs();
+  for (index = 0u; index < messages; index++)
+  {
+    decodeSampleCopy(payloads[index % BENCHMARKPAYLOADS],
+                     payloadLengths[index % BENCHMARKPAYLOADS], &sample);
+    checksum += sample.value;
+  }
+  copyNs = timebaseNowNs() - startNs;
+  startNs = timebaseNowNs();
+  for (index = 0u; index < messages; index++)
+  {
+    payloadDecode(payloads[index % BENCHMARKPAYLOADS],
+                  payloadLengths[index % BENCHMARKPAYLOADS], &sample);
+    checksum -= sample.value;
+  }
+  inPlaceNs = timebaseNowNs() - startNs;
+  printf("parse: copy and atof %.1f ns/message, in place %.1f ns/message "
+         "(checksum %g)\n",
+         (messages > 0u) ? ((double)copyNs / messages) : 0.0,
+         (messages > 0u) ? ((double)inPlaceNs / messages) : 0.0,
+         checksum);
+
+  benchmarking = 1u;
+  loopTableSetAllSetpoints(&loopTable, 50.0f);
+  loop = 0u;
+  startNs = timebaseNowNs();
+  for (index = 0u; index < messages; index++)
+  {
+    dispatcherHandleMessage(&dispatcher, topics[loop], topicLengths[loop],
+                            payloads[(step + loop) % BENCHMARKPAYLOADS],
+                            payloadLengths[(step + loop) % BENCHMARKPAYLOADS],
+                            timebaseNowNs());
+    loop++;
+    if (loop == loopTable.count)
+    {
+      loop = 0u;
+      step++;
+    }
+  }
+  elapsedNs = timebaseNowNs() - startNs;
+
+  loopTableFormatStats(&loopTable, loopsLine, sizeof(loopsLine));
+  printf("%s\n", loopsLine);
+
+  /* The control laws alone, without decoding, routing and bookkeeping */
+  loop = 0u;
+  step = 0u;
+  startNs = timebaseNowNs();
+  for (index = 0u; index < messages; index++)
+  {
+    step += (uint32_t)controlLoopUpdate(&loopTable.loops[loop],
+                                        pressures[index % BENCHMARKPAYLOADS],
+                                        startNs + index);
+    loop = (loop + 1u == loopTable.count) ? 0u : (loop + 1u);
+  }
+  lawNs = timebaseNowNs() - startNs;
+  printf("laws: %.1f ns/decision, %u commanded\n",
+         (messages > 0u) ? ((double)lawNs / messages) : 0.0, step);
+
+  printf("benchmark: messages=%u loops=%u time=%.3f ms %.1f ns/message "
+         "%.0f messages/s per core, i.e. loops per core at 1 sample/s\n",
+         messages, loopTable.count, elapsedNs / 1e6,
+         (messages > 0u) ? ((double)elapsedNs / messages) : 0.0,
+         (elapsedNs > 0u) ? ((double)messages * 1e9 / elapsedNs) : 0.0);
+
+  free(topics);
+  free(topicLengths);
+
+  return 0;
+}
+
+int main(int argc, char* argv[])
 {
   int result = 0;
+  int option;
   int numberOfConnectRetries = 100u;
+  uint32_t events = 0u;
+  long benchmarkMessages = -1;
+  DispatchOptions options;
   MQTTClient_connectOptions connectionOptions = MQTTClient_connectOptions_initializer;
 
+  dispatchOptionsInit(&options);
+  while ((option = getopt(argc, argv, DISPATCH_OPTIONS "B:")) != -1)
+  {
+    switch (option)
+    {
+      case 'B':
+        benchmarkMessages = strtol(optarg, NULL, 10);
+        break;
+      default:
+        if (!dispatchParseOption(&options, option, optarg))
+        {
+          printf("Usage: %s " DISPATCH_USAGE " [-B benchmark messages]\n",
+                 argv[0]);
+          return 1;
+        }
+        break;
+    }
+  }
+
+  if (dispatchLoadLoops(&loopTable, &options) != 0)
+  {
+    return 1;
+  }
+  if (dispatcherInit(&dispatcher, &loopTable, updateHysteresisControlValue,
+                     NULL) != 0)
+  {
+    printf("Failed to route the topics\n");
+    loopTableFree(&loopTable);
+    return -1;
+  }
+  if (benchmarkMessages >= 0)
+  {
+    result = runBenchmark((uint32_t)benchmarkMessages);
+    loopTableFree(&loopTable);
+    return result;
+  }
+
+  if ((eventLoopInit(&eventLoop) != 0) ||
+      (eventLoopAddTimer(&eventLoop, STATSPERIOD, printStats, NULL) != 0))
+  {
+    printf("Failed to create the event loop\n");
+    return -1;
+  }
+  signal(SIGINT, stopHandler);
+
   MQTTClient_create(&client, ADDRESS, CLIENTID, MQTTCLIENT_PERSISTENCE_NONE,
                     NULL);
-                    
+
   connectionOptions.keepAliveInterval = 20;
   connectionOptions.cleansession = 1;
 
@@ -149,34 +377,61 @@ int main()
                           messageArrivedHandler, NULL);
 
   result = MQTTClient_connect(client, &connectionOptions);
-  if (result != MQTTCLIENT_SUCCESS) 
+  if (result != MQTTCLIENT_SUCCESS)
   {
     printf("Failed to connect, return code %d\n", result);
     return -1;
   }
 
-  printf("Subscribing to topics:\n1. %s\n2. %s\nfor client %s using QoS%d\n\n",
-         TOPIC_Y, TOPIC_YZ, CLIENTID, QOS);
+  printf("Subscribing to topics:\n1. %s\n2. %s\n3. %s\n4. %s\n5. %s\n"
+         "for client %s using QoS%d, %u control loops\n\n",
+         TOPIC_Y, TOPIC_Y_ALL, TOPIC_YZ, TOPIC_YZ_ALL, TOPIC_Y_BATCH,
+         CLIENTID, QOS, loopTable.count);
 
   result = MQTTClient_subscribe(client, TOPIC_Y, QOS);
-  if (result != MQTTCLIENT_SUCCESS) 
+  if (result != MQTTCLIENT_SUCCESS)
   {
     printf("Failed to subscribe to topic %s, return code %d\n",
            TOPIC_Y, result);
     return -1;
   }
 
+  result = MQTTClient_subscribe(client, TOPIC_Y_ALL, QOS);
+  if (result != MQTTCLIENT_SUCCESS)
+  {
+    printf("Failed to subscribe to topic %s, return code %d\n",
+           TOPIC_Y_ALL, result);
+    return -1;
+  }
+
   result = MQTTClient_subscribe(client, TOPIC_YZ, QOS);
-  if (result != MQTTCLIENT_SUCCESS) 
+  if (result != MQTTCLIENT_SUCCESS)
   {
-    printf("Failed to subscribe to topic %s, return code %d\n", 
+    printf("Failed to subscribe to topic %s, return code %d\n",
            TOPIC_YZ, result);
     return -1;
   }
 
-  while (1)
+  result = MQTTClient_subscribe(client, TOPIC_YZ_ALL, QOS);
+  if (result != MQTTCLIENT_SUCCESS)
+  {
+    printf("Failed to subscribe to topic %s, return code %d\n",
+           TOPIC_YZ_ALL, result);
+    return -1;
+  }
+
+  result = MQTTClient_subscribe(client, TOPIC_Y_BATCH, QOS);
+  if (result != MQTTCLIENT_SUCCESS)
+  {
+    printf("Failed to subscribe to topic %s, return code %d\n",
+           TOPIC_Y_BATCH, result);
+    return -1;
+  }
+
+  while ((events & EVENT_STOP) == 0u)
   {
-    if (connectionLost == 1u)
+    events = eventLoopWait(&eventLoop);
+    if ((events & EVENT_CONNECTIONLOST) != 0u)
     {
       result = MQTTCLIENT_FAILURE;
       while ((result != MQTTCLIENT_SUCCESS) && (numberOfConnectRetries > 0))
@@ -184,20 +439,19 @@ int main()
         result = MQTTClient_connect(client, &connectionOptions);
         numberOfConnectRetries--;
       }
-      
-      if (result != MQTTCLIENT_SUCCESS) 
+
+      if (result != MQTTCLIENT_SUCCESS)
       {
         printf("Failed to reconnect, return code %d\n", result);
         exit(EXIT_FAILURE);
       }
-      else
-      {
-        connectionLost = 0u;
-      }
     }
   }
 
   MQTTClient_disconnect(client, 10000);
   MQTTClient_destroy(&client);
+  printStats(NULL, timebaseNowNs());
+  eventLoopClose(&eventLoop);
+  loopTableFree(&loopTable);
   return 0;
 }
@@ -0,0 +1,470 @@
+/*******************************************************************************
+* Authors:
+*    Uros Popovic & Uros Cvjetinovic
+* @file
+* \brief Regulator on the asynchronous MQTT client. It takes the same
+*   decisions as the regulator, on the same loop table (looptable.h) and
+*   control laws (controllaw.h), but an answer is only enqueued with
+*   MQTTAsync_sendMessage inside the message callback. The client writes it to
+*   the socket from its own sending thread, so receiving the next samples and
+*   sending the previous answers overlap instead of taking turns on one
+*   thread.
+*   Every answer is followed to the moment the client wrote it to the socket
+*   (sendtracker.h), the statistics print this decision to wire latency next
+*   to the latency from message arrival to decision and from decision to the
+*   answer enqueued, and the number of answers in flight.
+*   The client reconnects on its own and subscribes again once connected.
+*   The main thread sleeps in an event loop (eventloop.h) until Ctrl+C is
+*   pressed and wakes up once a minute to print statistics.
+*   The topics are routed and the messages handled by the same code as in
+*   the regulator (dispatch.h), which parses its options as well: "-n"
+*   loops, "-t" transitions only with "-f" refresh period, "-l" law of all
+*   loops, "-L" file of laws per loop.
+*   "-B <messages>" is a load run: once connected it subscribes to nothing
+*   but feeds generated samples through the same path, so every answer is
+*   really sent, keeps at most half the ring of the send tracker in flight
+*   and reports messages per second with the decision to wire latency.
+*   "-r <messages/s>" paces it, by default it runs as fast as it can, so the
+*   latency is mostly the wait behind the answers in flight.
+*******************************************************************************/
+
+/******* include headers ******************************************************/
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "MQTTAsync.h"
+#include "dispatch.h"
+#include "eventloop.h"
+#include "looptable.h"
+#include "payload.h"
+#include "sendtracker.h"
+#include "timebase.h"
+
+/******* local macros *********************************************************/
+#define ADDRESS         "tcp://broker.hivemq.com:1883"
+#define CLIENTID        "RegulatorAsync"
+#define TOPIC_Y         DISPATCH_TOPIC_Y
+#define TOPIC_Y_BATCH   DISPATCH_TOPIC_Y_BATCH
+#define TOPIC_YZ        DISPATCH_TOPIC_YZ
+#define TOPIC_Y_ALL     TOPIC_Y "/+"
+#define TOPIC_YZ_ALL    TOPIC_YZ "/+"
+#define TOPICCOUNT      5
+#define QOS             0
+#define TIMEOUT         10000L
+#define PAYLOADSIZE     PAYLOAD_TEXTSIZE
+#define STATSPERIOD     ((uint64_t) 60u * TIMEBASE_NS_PER_S)
+#define EVENT_STOP              ((uint32_t) 1u)
+#define EVENT_FAILED            ((uint32_t) 2u)
+#define EVENT_DISCONNECTED      ((uint32_t) 4u)
+#define EVENT_CONNECTED         ((uint32_t) 8u)
+#define BENCHMARKPAYLOADS       ((uint32_t) 256u)
+#define BENCHMARKINFLIGHT       (SENDTRACKER_SLOTS / 2u)
+#define BENCHMARKPOLLNS         ((uint64_t) 20000u)
+#define DEBUGLOG        0
+
+/******* local data objects ***************************************************/
+MQTTAsync client;
+
+EventLoop eventLoop;
+LoopTable loopTable;
+Dispatcher dispatcher;
+SendTracker sendTracker;
+atomic_ullong messagesArrived;
+uint32_t benchmarking = 0u;
+uint64_t benchmarkRate = 0u;
+
+char *const topics[TOPICCOUNT] =
+{
+  TOPIC_Y, TOPIC_Y_ALL, TOPIC_YZ, TOPIC_YZ_ALL, TOPIC_Y_BATCH
+};
+int qualities[TOPICCOUNT] = {QOS, QOS, QOS, QOS, QOS};
+
+/******* declaration of local functions ***************************************/
+void sendCorrection(void *context, float correction,
+                    const PayloadSample *cause, const char *topic,
+                    uint64_t decidedNs);
+
+void sendSucceeded(void *context, MQTTAsync_successData *response);
+
+void sendFailed(void *context, MQTTAsync_failureData *response);
+
+int messageArrivedHandler(void *context, char *topicName, int topicLen,
+                          MQTTAsync_message *message);
+
+void connectedHandler(void *context, char *cause);
+
+void connectionLostHandler(void *context, char *cause);
+
+void subscribeFailed(void *context, MQTTAsync_failureData *response);
+
+void connectFailed(void *context, MQTTAsync_failureData *response);
+
+void disconnectDone(void *context, MQTTAsync_successData *response);
+
+void disconnectFailed(void *context, MQTTAsync_failureData *response);
+
+void stopHandler(int signalNumber);
+
+void printStats(void *context, uint64_t nowNs);
+
+int runBenchmark(uint32_t messages);
+
+int main(int argc, char* argv[]);
+
+/******* definition of local functions ****************************************/
+/* Send callback of the dispatcher (dispatch.h). Only enqueues, the client
+   copies the payload and sends it from its own thread; the ticket of the
+   answer travels as the context of the send */
+void sendCorrection(void *context, float correction,
+                    const PayloadSample *cause, const char *topic,
+                    uint64_t decidedNs)
+{
+  char payload[PAYLOADSIZE];
+  PayloadSample sample;
+  MQTTAsync_message message = MQTTAsync_message_initializer;
+  MQTTAsync_responseOptions options = MQTTAsync_responseOptions_initializer;
+  uint32_t ticket;
+
+  sample.value = correction;
+  sample.flags = cause->flags & (PAYLOAD_TIMESTAMP | PAYLOAD_SEQUENCE |
+                                 PAYLOAD_TRACE | PAYLOAD_BINARY);
+  sample.sequence = cause->sequence;
+  sample.correlation = cause->correlation;
+  sample.timestampUs = cause->timestampUs;
+  sample.sentUs = cause->sentUs;
+
+  message.payload = payload;
+  message.payloadlen = payloadEncode(&sample, payload, sizeof(payload));
+  message.qos = QOS;
+  message.retained = 0;
+
+  ticket = sendTrackerBegin(&sendTracker, decidedNs);
+  options.onSuccess = sendSucceeded;
+  options.onFailure = sendFailed;
+  options.context = (void *)(uintptr_t)ticket;
+
+  if (MQTTAsync_sendMessage(client, topic, &message, &options) !=
+      MQTTASYNC_SUCCESS)
+  {
+    sendTrackerFail(&sendTracker, ticket);
+  }
+}
+
+void sendSucceeded(void *context, MQTTAsync_successData *response)
+{
+  sendTrackerComplete(&sendTracker, (uint32_t)(uintptr_t)context,
+                      timebaseNowNs());
+}
+
+void sendFailed(void *context, MQTTAsync_failureData *response)
+{
+  sendTrackerFail(&sendTracker, (uint32_t)(uintptr_t)context);
+}
+
+int messageArrivedHandler(void *context, char *topicName, int topicLen,
+                          MQTTAsync_message *message)
+{
+  uint64_t arrivalNs = timebaseNowNs();
+
+#if (DEBUGLOG)
+  printf("Message arrived on topic: %s\n", topicName);
+#endif
+  atomic_fetch_add_explicit(&messagesArrived, 1u, memory_order_relaxed);
+
+  /* The client passes 0 unless the topic contains a null character */
+  dispatcherHandleMessage(&dispatcher, topicName,
+                          (topicLen > 0) ? (size_t)topicLen :
+                                           strlen(topicName),
+                          message->payload, message->payloadlen, arrivalNs);
+
+  MQTTAsync_freeMessage(&message);
+  MQTTAsync_free(topicName);
+
+  return 1;
+}
+
+/* Called after the first connect and after every automatic reconnect, a
+   clean session has to subscribe again */
+void connectedHandler(void *context, char *cause)
+{
+  MQTTAsync_responseOptions options = MQTTAsync_responseOptions_initializer;
+  int result;
+
+  /* The load run takes the place of the subscriptions */
+  if (benchmarking)
+  {
+    eventLoopSignal(&eventLoop, EVENT_CONNECTED);
+    return;
+  }
+  options.onFailure = subscribeFailed;
+  result = MQTTAsync_subscribeMany(client, TOPICCOUNT, topics, qualities,
+                                   &options);
+  if (result != MQTTASYNC_SUCCESS)
+  {
+    printf("Failed to subscribe, return code %d\n", result);
+    eventLoopSignal(&eventLoop, EVENT_FAILED);
+  }
+}
+
+void connectionLostHandler(void *context, char *cause)
+{
+#if (DEBUGLOG)
+  printf("\nConnection lost\n");
+  printf("-Cause: %s\n", cause);
+#endif
+}
+
+void subscribeFailed(void *context, MQTTAsync_failureData *response)
+{
+  printf("Failed to subscribe, return code %d\n",
+         (response != NULL) ? response->code : 0);
+  eventLoopSignal(&eventLoop, EVENT_FAILED);
+}
+
+void connectFailed(void *context, MQTTAsync_failureData *response)
+{
+  printf("Failed to connect, return code %d\n",
+         (response != NULL) ? response->code : 0);
+  eventLoopSignal(&eventLoop, EVENT_FAILED);
+}
+
+void disconnectDone(void *context, MQTTAsync_successData *response)
+{
+  eventLoopSignal(&eventLoop, EVENT_DISCONNECTED);
+}
+
+void disconnectFailed(void *context, MQTTAsync_failureData *response)
+{
+  eventLoopSignal(&eventLoop, EVENT_DISCONNECTED);
+}
+
+void stopHandler(int signalNumber)
+{
+  eventLoopSignal(&eventLoop, EVENT_STOP);
+}
+
+void printStats(void *context, uint64_t nowNs)
+{
+  char statsLine[512];
+  char loopsLine[512];
+  char sendsLine[512];
+
+  eventLoopFormatStats(&eventLoop, statsLine, sizeof(statsLine));
+  loopTableFormatStats(&loopTable, loopsLine, sizeof(loopsLine));
+  sendTrackerFormatStats(&sendTracker, sendsLine, sizeof(sendsLine));
+  printf("messages=%llu %s\n%s\n%s\n",
+         (unsigned long long)atomic_load(&messagesArrived), statsLine,
+         loopsLine, sendsLine);
+}
+
+/* Feeds text samples round robin to all loops through the dispatcher, as the
+   benchmark of the regulator, but the answers are sent; the time includes
+   waiting for the client to write the last of them. A paced run catches up
+   after a late wakeup instead of drifting. */
+int runBenchmark(uint32_t messages)
+{
+  char (*topics)[LOOPTABLE_TOPICSIZE];
+  char payloads[BENCHMARKPAYLOADS][PAYLOADSIZE];
+  int payloadLengths[BENCHMARKPAYLOADS];
+  size_t *topicLengths;
+  uint64_t startNs;
+  uint64_t deadlineNs;
+  uint64_t elapsedNs;
+  uint32_t index;
+  uint32_t loop;
+  uint32_t step = 0u;
+
+  topics = calloc(loopTable.count, LOOPTABLE_TOPICSIZE);
+  topicLengths = (size_t *)calloc(loopTable.count, sizeof(size_t));
+  if ((topics == NULL) || (topicLengths == NULL))
+  {
+    free(topics);
+    free(topicLengths);
+    return -1;
+  }
+
+  for (loop = 0u; loop < loopTable.count; loop++)
+  {
+    snprintf(topics[loop], LOOPTABLE_TOPICSIZE, "%s/%u", TOPIC_Y, loop);
+    topicLengths[loop] = strlen(topics[loop]);
+  }
+  for (index = 0u; index < BENCHMARKPAYLOADS; index++)
+  {
+    payloadLengths[index] = snprintf(payloads[index], PAYLOADSIZE, "%.2f",
+                                     45.0f + (10.0f * index) /
+                                     BENCHMARKPAYLOADS);
+  }
+
+  loopTableSetAllSetpoints(&loopTable, 50.0f);
+  loop = 0u;
+  startNs = timebaseNowNs();
+  for (index = 0u; index < messages; index++)
+  {
+    if (benchmarkRate > 0u)
+    {
+      timebaseSleepUntilNs(startNs + (index * TIMEBASE_NS_PER_S) /
+                                     benchmarkRate);
+    }
+    /* A slot reused before its send completed would leave it untimed */
+    while (sendTrackerInFlight(&sendTracker) >= BENCHMARKINFLIGHT)
+    {
+      timebaseSleepUntilNs(timebaseNowNs() + BENCHMARKPOLLNS);
+    }
+    atomic_fetch_add_explicit(&messagesArrived, 1u, memory_order_relaxed);
+    dispatcherHandleMessage(&dispatcher, topics[loop], topicLengths[loop],
+                            payloads[(step + loop) % BENCHMARKPAYLOADS],
+                            payloadLengths[(step + loop) % BENCHMARKPAYLOADS],
+                            timebaseNowNs());
+    loop++;
+    if (loop == loopTable.count)
+    {
+      loop = 0u;
+      step++;
+    }
+  }
+  deadlineNs = timebaseNowNs() + ((uint64_t)TIMEOUT * TIMEBASE_NS_PER_MS);
+  while ((sendTrackerInFlight(&sendTracker) > 0u) &&
+         (timebaseNowNs() < deadlineNs))
+  {
+    timebaseSleepUntilNs(timebaseNowNs() + BENCHMARKPOLLNS);
+  }
+  elapsedNs = timebaseNowNs() - startNs;
+
+  printf("benchmark: messages=%u loops=%u time=%.3f ms %.1f ns/message "
+         "%.0f messages/s with the answers sent\n",
+         messages, loopTable.count, elapsedNs / 1e6,
+         (messages > 0u) ? ((double)elapsedNs / messages) : 0.0,
+         (elapsedNs > 0u) ? ((double)messages * 1e9 / elapsedNs) : 0.0);
+
+  free(topics);
+  free(topicLengths);
+
+  return 0;
+}
+
+int main(int argc, char* argv[])
+{
+  int result = 0;
+  int option;
+  uint32_t events = 0u;
+  long benchmarkMessages = -1;
+  long rate = 0;
+  DispatchOptions options;
+  MQTTAsync_connectOptions connectionOptions =
+    MQTTAsync_connectOptions_initializer;
+  MQTTAsync_disconnectOptions disconnectOptions =
+    MQTTAsync_disconnectOptions_initializer;
+
+  dispatchOptionsInit(&options);
+  while ((option = getopt(argc, argv, DISPATCH_OPTIONS "B:r:")) != -1)
+  {
+    switch (option)
+    {
+      case 'B':
+        benchmarkMessages = strtol(optarg, NULL, 10);
+        break;
+      case 'r':
+        rate = strtol(optarg, NULL, 10);
+        break;
+      default:
+        if (!dispatchParseOption(&options, option, optarg))
+        {
+          printf("Usage: %s " DISPATCH_USAGE " [-B load run messages"
+                 " [-r messages/s]]\n", argv[0]);
+          return 1;
+        }
+        break;
+    }
+  }
+
+  if (dispatchLoadLoops(&loopTable, &options) != 0)
+  {
+    return 1;
+  }
+  if (dispatcherInit(&dispatcher, &loopTable, sendCorrection, NULL) != 0)
+  {
+    printf("Failed to route the topics\n");
+    loopTableFree(&loopTable);
+    return -1;
+  }
+  sendTrackerInit(&sendTracker);
+  benchmarking = (benchmarkMessages >= 0) ? 1u : 0u;
+  benchmarkRate = (rate > 0) ? (uint64_t)rate : 0u;
+
+  if ((eventLoopInit(&eventLoop) != 0) ||
+      (eventLoopAddTimer(&eventLoop, STATSPERIOD, printStats, NULL) != 0))
+  {
+    printf("Failed to create the event loop\n");
+    return -1;
+  }
+  signal(SIGINT, stopHandler);
+
+  result = MQTTAsync_create(&client, ADDRESS, CLIENTID,
+                            MQTTCLIENT_PERSISTENCE_NONE, NULL);
+  if (result != MQTTASYNC_SUCCESS)
+  {
+    printf("Failed to create client, return code %d\n", result);
+    return -1;
+  }
+  MQTTAsync_setCallbacks(client, NULL, connectionLostHandler,
+                         messageArrivedHandler, NULL);
+  MQTTAsync_setConnected(client, NULL, connectedHandler);
+
+  connectionOptions.keepAliveInterval = 20;
+  connectionOptions.cleansession = 1;
+  connectionOptions.automaticReconnect = 1;
+  connectionOptions.onFailure = connectFailed;
+
+  if (benchmarking)
+  {
+    printf("Load run of %ld messages for client %s using QoS%d, "
+           "%u control loops\n\n", benchmarkMessages, CLIENTID, QOS,
+           loopTable.count);
+  }
+  else
+  {
+    printf("Subscribing to topics:\n1. %s\n2. %s\n3. %s\n4. %s\n5. %s\n"
+           "for client %s using QoS%d, %u control loops\n\n",
+           TOPIC_Y, TOPIC_Y_ALL, TOPIC_YZ, TOPIC_YZ_ALL, TOPIC_Y_BATCH,
+           CLIENTID, QOS, loopTable.count);
+  }
+
+  result = MQTTAsync_connect(client, &connectionOptions);
+  if (result != MQTTASYNC_SUCCESS)
+  {
+    printf("Failed to start connect, return code %d\n", result);
+    return -1;
+  }
+
+  while ((events & (EVENT_STOP | EVENT_FAILED)) == 0u)
+  {
+    events = eventLoopWait(&eventLoop);
+    if ((events & EVENT_CONNECTED) != 0u)
+    {
+      events |= (runBenchmark((uint32_t)benchmarkMessages) == 0) ?
+                EVENT_STOP : EVENT_FAILED;
+    }
+  }
+
+  /* Answers still queued get the usual timeout to leave, the disconnect
+     completes on the client threads */
+  disconnectOptions.timeout = TIMEOUT;
+  disconnectOptions.onSuccess = disconnectDone;
+  disconnectOptions.onFailure = disconnectFailed;
+  if (MQTTAsync_disconnect(client, &disconnectOptions) == MQTTASYNC_SUCCESS)
+  {
+    while ((eventLoopWait(&eventLoop) & EVENT_DISCONNECTED) == 0u)
+    {
+    }
+  }
+  MQTTAsync_destroy(&client);
+  printStats(NULL, timebaseNowNs());
+  eventLoopClose(&eventLoop);
+  loopTableFree(&loopTable);
+
+  return ((events & EVENT_FAILED) != 0u) ? -1 : 0;
+}
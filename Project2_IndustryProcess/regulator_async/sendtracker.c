@@ -0,0 +1,118 @@
+/*******************************************************************************
+* Authors:
+*    Uros Popovic & Uros Cvjetinovic
+* @file
+* \brief Decision to wire latency of the asynchronous regulator, see
+*   sendtracker.h.
+*******************************************************************************/
+
+/******* include headers ******************************************************/
+#include <stdio.h>
+#include <string.h>
+#include "sendtracker.h"
+
+/******* local macros *********************************************************/
+#define SLOTMASK                (SENDTRACKER_SLOTS - 1u)
+
+_Static_assert((SENDTRACKER_SLOTS & SLOTMASK) == 0u,
+               "the ring size is a power of two");
+
+/******* definition of global functions ***************************************/
+void sendTrackerInit(SendTracker *tracker)
+{
+  uint32_t slot;
+
+  memset(tracker, 0, sizeof(*tracker));
+  for (slot = 0u; slot < SENDTRACKER_SLOTS; slot++)
+  {
+    atomic_init(&tracker->slots[slot].ticket, 0u);
+    atomic_init(&tracker->slots[slot].decidedNs, 0u);
+  }
+  atomic_init(&tracker->nextTicket, 0u);
+  histogramReset(&tracker->wireLatency);
+}
+
+uint32_t sendTrackerBegin(SendTracker *tracker, uint64_t decidedNs)
+{
+  uint32_t ticket = atomic_fetch_add(&tracker->nextTicket, 1u) + 1u;
+  SendTrackerSlot *slot = &tracker->slots[ticket & SLOTMASK];
+  uint32_t depth;
+
+  /* The old ticket is withdrawn before the time changes, the new ticket
+     then releases the time to the completion */
+  atomic_store_explicit(&slot->ticket, 0u, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+  atomic_store_explicit(&slot->decidedNs, decidedNs, memory_order_relaxed);
+  atomic_store_explicit(&slot->ticket, ticket, memory_order_release);
+
+  depth = sendTrackerInFlight(tracker);
+  if (depth > atomic_load_explicit(&tracker->maxInFlight,
+                                   memory_order_relaxed))
+  {
+    atomic_store_explicit(&tracker->maxInFlight, depth, memory_order_relaxed);
+  }
+
+  return ticket;
+}
+
+void sendTrackerComplete(SendTracker *tracker, uint32_t ticket,
+                         uint64_t nowNs)
+{
+  SendTrackerSlot *slot = &tracker->slots[ticket & SLOTMASK];
+  uint64_t decidedNs = 0u;
+  int timed;
+
+  /* 0 marks a slot being rewritten, a wrapped ticket 0 stays untimed */
+  timed = (ticket != 0u) &&
+          (atomic_load_explicit(&slot->ticket, memory_order_acquire) ==
+           ticket);
+  if (timed)
+  {
+    decidedNs = atomic_load_explicit(&slot->decidedNs, memory_order_relaxed);
+    atomic_thread_fence(memory_order_acquire);
+    timed = (atomic_load_explicit(&slot->ticket, memory_order_relaxed) ==
+             ticket);
+  }
+  if (timed)
+  {
+    histogramRecord(&tracker->wireLatency,
+                    (nowNs > decidedNs) ? (nowNs - decidedNs) : 0u);
+  }
+  else
+  {
+    atomic_fetch_add(&tracker->untimed, 1u);
+  }
+  atomic_fetch_add(&tracker->completed, 1u);
+}
+
+void sendTrackerFail(SendTracker *tracker, uint32_t ticket)
+{
+  (void)ticket;
+  atomic_fetch_add(&tracker->failed, 1u);
+}
+
+uint32_t sendTrackerInFlight(SendTracker *tracker)
+{
+  uint64_t finished = atomic_load(&tracker->completed) +
+                      atomic_load(&tracker->failed);
+
+  return atomic_load(&tracker->nextTicket) - (uint32_t)finished;
+}
+
+int sendTrackerFormatStats(SendTracker *tracker, char *buffer, size_t size)
+{
+  char wireLine[160];
+
+  histogramFormat(&tracker->wireLatency, "wire", wireLine, sizeof(wireLine));
+
+  return snprintf(buffer, size,
+                  "sends: started=%u completed=%llu failed=%llu untimed=%llu "
+                  "inflight=%u max=%u %s",
+                  atomic_load(&tracker->nextTicket),
+                  (unsigned long long)atomic_load(&tracker->completed),
+                  (unsigned long long)atomic_load(&tracker->failed),
+                  (unsigned long long)atomic_load(&tracker->untimed),
+                  sendTrackerInFlight(tracker),
+                  atomic_load(&tracker->maxInFlight),
+                  wireLine);
+}
@@ -0,0 +1,63 @@
+/*******************************************************************************
+* Authors:
+*    Uros Popovic & Uros Cvjetinovic
+* @file
+* \brief Decision to wire latency of the answers of the asynchronous
+*   regulator. Every answer handed to MQTTAsync gets a ticket; the ticket is
+*   the context of the send and indexes a ring of decision times, so the
+*   completion callback finds the time without any allocation or lock. The
+*   client reports a QoS 0 send complete once the message was written to the
+*   socket. A ticket whose slot was reused by a newer send, because more than
+*   SENDTRACKER_SLOTS answers were in flight, is counted as untimed. A slot
+*   is read like a seqlock: ticket, time, then the ticket again, and a newer
+*   send clears the ticket before it writes its time, so a time is only
+*   taken when the ticket did not change around it.
+*   Tickets are taken by the thread delivering messages, completions come
+*   from the sending thread of the client; each histogram has one writer and
+*   the statistics read from another thread are approximate.
+*******************************************************************************/
+#ifndef SENDTRACKER_H
+#define SENDTRACKER_H
+
+/******* include headers ******************************************************/
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "histogram.h"
+
+/******* global macros ********************************************************/
+#define SENDTRACKER_SLOTS       ((uint32_t) 4096u)
+
+/******* type definitions *****************************************************/
+typedef struct
+{
+  atomic_uint ticket;
+  atomic_ullong decidedNs;
+} SendTrackerSlot;
+
+typedef struct
+{
+  SendTrackerSlot slots[SENDTRACKER_SLOTS];
+  atomic_uint nextTicket;
+  atomic_ullong completed;
+  atomic_ullong failed;
+  atomic_ullong untimed;
+  atomic_uint maxInFlight;
+  Histogram wireLatency;        /* decision taken to written to the socket */
+} SendTracker;
+
+/******* declaration of global functions **************************************/
+void sendTrackerInit(SendTracker *tracker);
+
+uint32_t sendTrackerBegin(SendTracker *tracker, uint64_t decidedNs);
+
+void sendTrackerComplete(SendTracker *tracker, uint32_t ticket,
+                         uint64_t nowNs);
+
+void sendTrackerFail(SendTracker *tracker, uint32_t ticket);
+
+uint32_t sendTrackerInFlight(SendTracker *tracker);
+
+int sendTrackerFormatStats(SendTracker *tracker, char *buffer, size_t size);
+
+#endif /* SENDTRACKER_H */